@@ -57,6 +57,8 @@ endmacro()
 macro(cpp_experiments_setup_options)
   option(cpp_experiments_ENABLE_HARDENING "Enable hardening" ON)
   option(cpp_experiments_ENABLE_COVERAGE "Enable coverage reporting" OFF)
+  # threaded_queue::DefaultQueueStats; off so production builds pay nothing for it
+  option(cpp_experiments_ENABLE_QUEUE_STATS "Record queue depth, contention and latency statistics" OFF)
   cmake_dependent_option(
     cpp_experiments_ENABLE_GLOBAL_HARDENING
     "Attempt to push hardening options to built dependencies"
@@ -0,0 +1,201 @@
+#include "messagequeue/message_queue.h"
+#include "objectpool/arena_resource.h"
+#include "objectpool/pool_resource.h"
+#include "objectpool/pooled_ptr.h"
+#include "objectpool/slab_allocator.h"
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <memory_resource>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// MessageQueue push/pop loop: a burst of range(0) messages goes in and comes
+// back out. The messages themselves are recycled so only the queue's own
+// storage is measured.
+static std::vector<memory::pooled_ptr<Message>> MakeMessages(size_t count)
+{
+  std::vector<memory::pooled_ptr<Message>> messages;
+  messages.reserve(count);
+  for (size_t i = 0; i < count; i++) {
+    messages.push_back(std::make_unique<Message>(Message{ i, "topic", { 0x01 } }));
+  }
+  return messages;
+}
+
+static void PushPopLoop(benchmark::State &state, MessageQueue &queue)
+{
+  auto messages = MakeMessages(static_cast<size_t>(state.range(0)));
+  for (auto _ : state) {
+    for (auto &msg : messages) { queue.push(std::move(msg)); }
+    for (auto &msg : messages) { msg = std::move(*queue.try_pop()); }
+    benchmark::DoNotOptimize(messages.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void BM_MessageQueueDefaultAllocator(benchmark::State &state)
+{
+  MessageQueue queue;
+  PushPopLoop(state, queue);
+}
+BENCHMARK(BM_MessageQueueDefaultAllocator)->RangeMultiplier(8)->Range(64, 32 << 10);
+
+static void BM_MessageQueuePoolResource(benchmark::State &state)
+{
+  // libstdc++ deque buffers are 512 bytes; the node map goes upstream.
+  memory::ObjectPoolResource<512> resource(16);
+  MessageQueue queue(&resource);
+  PushPopLoop(state, queue);
+}
+BENCHMARK(BM_MessageQueuePoolResource)->RangeMultiplier(8)->Range(64, 32 << 10);
+
+// Word count kernel from ParallelWordCounter over synthetic text.
+static std::string MakeText(size_t words)
+{
+  static constexpr std::string_view kVocabulary[] = { "the", "quick", "brown", "fox", "jumps", "over", "lazy",
+    "dog", "message", "queue", "thread", "pool", "allocator", "resource", "benchmark", "throughput" };
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<size_t> pick(0, std::size(kVocabulary) - 1);
+  std::uniform_int_distribution<int> suffix(0, 255);
+  std::string text;
+  for (size_t i = 0; i < words; i++) {
+    text += kVocabulary[pick(rng)];
+    text += std::to_string(suffix(rng));
+    text += (i % 12 == 11) ? '\n' : ' ';
+  }
+  return text;
+}
+
+template<typename Map> static void CountWords(std::string_view text, Map &counts)
+{
+  size_t pos = 0;
+  while (pos < text.size()) {
+    while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\n')) { pos++; }
+    size_t start = pos;
+    while (pos < text.size() && text[pos] != ' ' && text[pos] != '\n') { pos++; }
+    if (start < pos) {
+      std::string_view word = text.substr(start, pos - start);
+      auto iter = counts.find(word);
+      if (iter != counts.end()) {
+        iter->second++;
+      } else {
+        counts.emplace(word, 1);
+      }
+    }
+  }
+}
+
+static void BM_WordCountDefaultAllocator(benchmark::State &state)
+{
+  std::string text = MakeText(static_cast<size_t>(state.range(0)));
+  for (auto _ : state) {
+    std::map<std::string, int, std::less<>> counts;
+    CountWords(text, counts);
+    benchmark::DoNotOptimize(counts.size());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_WordCountDefaultAllocator)->RangeMultiplier(8)->Range(1 << 10, 64 << 10);
+
+static void BM_WordCountArenaResource(benchmark::State &state)
+{
+  std::string text = MakeText(static_cast<size_t>(state.range(0)));
+  memory::ArenaResource arena;
+  for (auto _ : state) {
+    {
+      std::pmr::map<std::pmr::string, int, std::less<>> counts(&arena);
+      CountWords(text, counts);
+      benchmark::DoNotOptimize(counts.size());
+    }
+    arena.reset();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_WordCountArenaResource)->RangeMultiplier(8)->Range(1 << 10, 64 << 10);
+
+static void BM_WordCountPoolResource(benchmark::State &state)
+{
+  std::string text = MakeText(static_cast<size_t>(state.range(0)));
+  // Map nodes and short strings both fit in 96 bytes.
+  memory::ObjectPoolResource<96> resource(1024);
+  for (auto _ : state) {
+    std::pmr::map<std::pmr::string, int, std::less<>> counts(&resource);
+    CountWords(text, counts);
+    benchmark::DoNotOptimize(counts.size());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_WordCountPoolResource)->RangeMultiplier(8)->Range(1 << 10, 64 << 10);
+
+// Message payloads with heavily clustered sizes: most are small telemetry
+// records, some are medium and a few are near an MTU.
+static std::vector<size_t> MakePayloadSizes(size_t count)
+{
+  std::mt19937 rng(7);
+  std::discrete_distribution<int> cluster({ 70, 20, 8, 2 });
+  std::uniform_int_distribution<size_t> jitter(0, 8);
+  static constexpr size_t kClusterSizes[] = { 40, 120, 480, 1400 };
+  std::vector<size_t> sizes(count);
+  for (auto &size : sizes) { size = kClusterSizes[cluster(rng)] + jitter(rng); }
+  return sizes;
+}
+
+constexpr size_t kPayloadBatch = 256;
+
+static void BM_PayloadVector(benchmark::State &state)
+{
+  auto sizes = MakePayloadSizes(kPayloadBatch);
+  std::vector<std::vector<uint8_t>> payloads(kPayloadBatch);
+  for (auto _ : state) {
+    for (size_t i = 0; i < kPayloadBatch; i++) { payloads[i] = std::vector<uint8_t>(sizes[i]); }
+    benchmark::DoNotOptimize(payloads.data());
+    for (auto &payload : payloads) { payload = {}; }
+  }
+  state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(kPayloadBatch));
+}
+BENCHMARK(BM_PayloadVector)->Threads(1)->Threads(4)->UseRealTime();
+
+static void SlabPayloads(benchmark::State &state, memory::SlabAllocator &slab)
+{
+  auto sizes = MakePayloadSizes(kPayloadBatch);
+  std::vector<memory::ByteBuffer> payloads(kPayloadBatch);
+  for (auto _ : state) {
+    for (size_t i = 0; i < kPayloadBatch; i++) { payloads[i] = memory::ByteBuffer(slab, sizes[i]); }
+    benchmark::DoNotOptimize(payloads.data());
+    for (auto &payload : payloads) { payload = {}; }
+  }
+  state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(kPayloadBatch));
+
+  if (state.thread_index() == 0) {
+    for (size_t i = 0; i < kPayloadBatch; i++) { payloads[i] = memory::ByteBuffer(slab, sizes[i]); }
+    auto stats = slab.stats();
+    size_t used = 0;
+    size_t requested = 0;
+    for (const auto &c : stats.classes) {
+      used += c.blocks_in_use * c.block_size;
+      requested += c.bytes_requested;
+    }
+    state.counters["utilization"] = used == 0 ? 1.0 : static_cast<double>(requested) / static_cast<double>(used);
+  }
+}
+
+static void BM_PayloadSlabPowerOfTwo(benchmark::State &state)
+{
+  static memory::SlabAllocator slab;
+  SlabPayloads(state, slab);
+}
+BENCHMARK(BM_PayloadSlabPowerOfTwo)->Threads(1)->Threads(4)->UseRealTime();
+
+static void BM_PayloadSlabTuned(benchmark::State &state)
+{
+  // Classes sit just above the clusters above, so little is lost to rounding.
+  static memory::SlabAllocator slab({ 48, 128, 496, 1408, 4096 });
+  SlabPayloads(state, slab);
+}
+BENCHMARK(BM_PayloadSlabTuned)->Threads(1)->Threads(4)->UseRealTime();
+
+BENCHMARK_MAIN();
\ No newline at end of file
@@ -0,0 +1,111 @@
+#include "objectpool/concurrent_objectpool.h"
+#include "objectpool/pool_resource.h"
+#include "objectpool/pooled_ptr.h"
+#include "threadsafequeue/thread_safe_queue.h"
+#include <benchmark/benchmark.h>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <thread>
+
+// Every call to the global operator new in this executable is counted, so the
+// pipeline benchmarks can report heap allocations per message.
+#if defined(__GNUC__) && !defined(__clang__)
+// GCC inlines the replacement operators and then flags the malloc/free pair.
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+static std::atomic<uint64_t> g_allocations{ 0 };
+
+void *operator new(std::size_t size)
+{
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void *ptr = std::malloc(size == 0 ? 1 : size)) { return ptr; }
+  throw std::bad_alloc();
+}
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::size_t /*size*/) noexcept { std::free(ptr); }
+
+// std::pmr::new_delete_resource, the default behind pmr containers, uses the
+// aligned forms.
+void *operator new(std::size_t size, std::align_val_t align)
+{
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  auto alignment = static_cast<std::size_t>(align);
+  size = (size + alignment - 1) / alignment * alignment;
+  if (void *ptr = std::aligned_alloc(alignment, size == 0 ? alignment : size)) { return ptr; }
+  throw std::bad_alloc();
+}
+void operator delete(void *ptr, std::align_val_t /*align*/) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::size_t /*size*/, std::align_val_t /*align*/) noexcept { std::free(ptr); }
+
+// End-to-end message pipeline: the benchmark thread produces messages, a
+// consumer thread pops them with wait_and_pop and drops them. The producer
+// pushes kBatch messages per iteration and keeps at most kInFlight messages
+// between itself and the consumer.
+static constexpr uint64_t kBatch = 64;
+static constexpr uint64_t kInFlight = 4 * kBatch;
+static constexpr size_t kPoolSize = 4096;// in flight plus both threads' magazines, with room to spare
+
+template<typename Queue, typename MakeMessage>
+static void Pipeline(benchmark::State &state, Queue &queue, MakeMessage make_message)
+{
+  std::atomic<uint64_t> consumed{ 0 };
+  std::thread consumer([&] {
+    while (auto msg = queue.wait_and_pop()) {
+      benchmark::DoNotOptimize(msg.value()->timestamp_ns);
+      msg.reset();
+      consumed.fetch_add(1, std::memory_order_release);
+    }
+  });
+
+  uint64_t produced = 0;
+  auto run_batch = [&] {
+    for (uint64_t i = 0; i < kBatch; i++) { queue.push(make_message(produced++)); }
+    while (produced - consumed.load(std::memory_order_acquire) > kInFlight) { std::this_thread::yield(); }
+  };
+  // Warm up so pools, magazines and queue segments reach their working set.
+  for (int i = 0; i < 64; i++) { run_batch(); }
+
+  uint64_t start = produced;
+  uint64_t allocations = g_allocations.load(std::memory_order_relaxed);
+  for (auto _ : state) { run_batch(); }
+  while (consumed.load(std::memory_order_acquire) < produced) { std::this_thread::yield(); }
+  allocations = g_allocations.load(std::memory_order_relaxed) - allocations;
+  uint64_t messages = produced - start;
+
+  queue.shutdown();
+  consumer.join();
+
+  state.SetItemsProcessed(static_cast<int64_t>(messages));
+  state.counters["allocs_per_msg"] = static_cast<double>(allocations) / static_cast<double>(messages);
+}
+
+static void BM_PipelineMakeUnique(benchmark::State &state)
+{
+  threaded_queue::ThreadSafeQueue<Message> queue;
+  Pipeline(state, queue, [](uint64_t i) { return std::make_unique<Message>(Message{ i, "topic", {} }); });
+}
+BENCHMARK(BM_PipelineMakeUnique)->UseRealTime();
+
+static void BM_PipelinePooled(benchmark::State &state)
+{
+  memory::ConcurrentObjectPool<Message> pool(kPoolSize);
+  threaded_queue::ThreadSafeQueue<Message, memory::PoolDeleter<Message>> queue;
+  Pipeline(state, queue, [&pool](uint64_t i) { return memory::make_pooled(pool, Message{ i, "topic", {} }); });
+}
+BENCHMARK(BM_PipelinePooled)->UseRealTime();
+
+// Pooled messages plus queue segments from a pool: nothing left touches the heap.
+static void BM_PipelinePooledWithQueueResource(benchmark::State &state)
+{
+  memory::ConcurrentObjectPool<Message> pool(kPoolSize);
+  // Queue segments are at most 4 KiB; the segment table is small enough to share the pool.
+  memory::ObjectPoolResource<4096> resource(4);
+  threaded_queue::ThreadSafeQueue<Message, memory::PoolDeleter<Message>> queue(&resource);
+  Pipeline(state, queue, [&pool](uint64_t i) { return memory::make_pooled(pool, Message{ i, "topic", {} }); });
+}
+BENCHMARK(BM_PipelinePooledWithQueueResource)->UseRealTime();
+
+BENCHMARK_MAIN();
\ No newline at end of file
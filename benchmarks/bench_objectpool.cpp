@@ -1,11 +1,28 @@
+#include "objectpool/concurrent_objectpool.h"
+#include "objectpool/lockfree_objectpool.h"
 #include "objectpool/objectpool.h"
 #include <benchmark/benchmark.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
 
 struct BenchmarkObject
 {
   long long data[8];
 };
 
+// Runs a benchmark at 1, 2, 4, ... threads up to the hardware concurrency.
+static void ThreadScaling(benchmark::internal::Benchmark *bench)
+{
+  int max_threads = static_cast<int>(std::max(1U, std::thread::hardware_concurrency()));
+  for (int threads = 1; threads < max_threads; threads *= 2) { bench->Threads(threads); }
+  bench->Threads(max_threads);
+  bench->UseRealTime();
+}
+
 
 static void BM_NewDelete(benchmark::State &state)
 {
@@ -30,4 +47,231 @@ static void BM_ObjectPool(benchmark::State &state)
 
 BENCHMARK(BM_ObjectPool)->Range(8, 8 << 10);
 
+static void BM_LockFreeObjectPool(benchmark::State &state)
+{
+  memory::LockFreeObjectPool<BenchmarkObject> pool(static_cast<size_t>(state.range(0)));
+
+  for (auto _ : state) {
+    BenchmarkObject *obj = pool.construct();
+    benchmark::DoNotOptimize(obj);
+    pool.destroy(obj);
+  }
+}
+
+BENCHMARK(BM_LockFreeObjectPool)->Range(8, 8 << 10);
+
+// Burst lifecycle: grow from a small pool to state.range(0) live objects, hold
+// steady while churning half of them, then drain and trim. range(1) selects the
+// GrowthPolicy::Kind; new/delete runs the same pattern as the baseline.
+constexpr size_t kInitialPoolSize = 64;
+constexpr int kSteadyRounds = 4;
+
+static void BM_NewDeleteBurst(benchmark::State &state)
+{
+  auto peak = static_cast<size_t>(state.range(0));
+  std::vector<BenchmarkObject *> live(peak);
+  for (auto _ : state) {
+    for (auto &obj : live) { obj = new BenchmarkObject(); }
+    for (int round = 0; round < kSteadyRounds; round++) {
+      for (size_t i = 0; i < peak; i += 2) {
+        delete live[i];
+        live[i] = new BenchmarkObject();
+      }
+    }
+    benchmark::DoNotOptimize(live.data());
+    for (auto *obj : live) { delete obj; }
+  }
+  state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(peak));
+}
+BENCHMARK(BM_NewDeleteBurst)->RangeMultiplier(8)->Range(512, 32 << 10);
+
+static void BM_GrowingObjectPoolBurst(benchmark::State &state)
+{
+  auto peak = static_cast<size_t>(state.range(0));
+  auto kind = static_cast<memory::GrowthPolicy::Kind>(state.range(1));
+  memory::ObjectPool<BenchmarkObject> pool(kInitialPoolSize, { kind, 0 });
+  std::vector<BenchmarkObject *> live(peak);
+  for (auto _ : state) {
+    for (auto &obj : live) { obj = pool.construct(); }
+    for (int round = 0; round < kSteadyRounds; round++) {
+      for (size_t i = 0; i < peak; i += 2) {
+        pool.destroy(live[i]);
+        live[i] = pool.construct();
+      }
+    }
+    benchmark::DoNotOptimize(live.data());
+    for (auto *obj : live) { pool.destroy(obj); }
+    pool.trim();
+  }
+  state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(peak));
+  state.counters["chunks"] = static_cast<double>(pool.chunk_count());
+}
+BENCHMARK(BM_GrowingObjectPoolBurst)
+  ->ArgsProduct({ benchmark::CreateRange(512, 32 << 10, 8),
+    { static_cast<int64_t>(memory::GrowthPolicy::Kind::linear),
+      static_cast<int64_t>(memory::GrowthPolicy::Kind::geometric) } });
+
+// Steady state once the pool has grown: no trim, so no chunk churn.
+static void BM_GrownObjectPoolSteady(benchmark::State &state)
+{
+  auto peak = static_cast<size_t>(state.range(0));
+  memory::ObjectPool<BenchmarkObject> pool(kInitialPoolSize, { memory::GrowthPolicy::Kind::geometric, 0 });
+  std::vector<BenchmarkObject *> live(peak);
+  for (auto &obj : live) { obj = pool.construct(); }
+  for (auto *obj : live) { pool.destroy(obj); }
+  for (auto _ : state) {
+    for (auto &obj : live) { obj = pool.construct(); }
+    benchmark::DoNotOptimize(live.data());
+    for (auto *obj : live) { pool.destroy(obj); }
+  }
+  state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(peak));
+}
+BENCHMARK(BM_GrownObjectPoolSteady)->RangeMultiplier(8)->Range(512, 32 << 10);
+
+// Page backing: a pointer chase in random order over a pool far larger than
+// the TLB reach of 4K pages. range(0) selects PageOptions::HugePages.
+constexpr size_t kLargePoolSize = size_t{ 1 } << 21;// 128 MiB of BenchmarkObject
+constexpr int kHops = 4096;
+
+static void BM_ObjectPoolRandomAccess(benchmark::State &state)
+{
+  memory::PageOptions pages{ static_cast<memory::PageOptions::HugePages>(state.range(0)), -1, false };
+  memory::ObjectPool<BenchmarkObject> pool(kLargePoolSize, {}, pages);
+  std::vector<BenchmarkObject *> objects(kLargePoolSize);
+  for (auto &obj : objects) { obj = pool.construct(); }
+
+  // Link the objects into a single random cycle through data[0].
+  std::mt19937_64 rng(42);
+  std::shuffle(objects.begin(), objects.end(), rng);
+  for (size_t i = 0; i < objects.size(); i++) {
+    objects[i]->data[0] = reinterpret_cast<long long>(objects[(i + 1) % objects.size()]);
+  }
+
+  BenchmarkObject *current = objects.front();
+  for (auto _ : state) {
+    for (int hop = 0; hop < kHops; hop++) { current = reinterpret_cast<BenchmarkObject *>(current->data[0]); }
+    benchmark::DoNotOptimize(current);
+  }
+  state.SetItemsProcessed(state.iterations() * kHops);
+  state.counters["backing"] = static_cast<double>(pool.backing());
+
+  for (auto *obj : objects) { pool.destroy(obj); }
+}
+BENCHMARK(BM_ObjectPoolRandomAccess)
+  ->Arg(static_cast<int64_t>(memory::PageOptions::HugePages::none))
+  ->Arg(static_cast<int64_t>(memory::PageOptions::HugePages::transparent))
+  ->Arg(static_cast<int64_t>(memory::PageOptions::HugePages::explicit_))
+  ->Unit(benchmark::kMicrosecond);
+
+// First touch: building a pool writes the free-list link of every slot, so
+// this is dominated by page faults; huge pages take 512x fewer of them.
+static void BM_ObjectPoolFirstTouch(benchmark::State &state)
+{
+  constexpr size_t kPoolSize = size_t{ 1 } << 19;// 32 MiB
+  memory::PageOptions pages{ static_cast<memory::PageOptions::HugePages>(state.range(0)), -1, false };
+  for (auto _ : state) {
+    memory::ObjectPool<BenchmarkObject> pool(kPoolSize, {}, pages);
+    benchmark::DoNotOptimize(pool.construct());
+  }
+  state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(kPoolSize * sizeof(BenchmarkObject)));
+}
+BENCHMARK(BM_ObjectPoolFirstTouch)
+  ->Arg(static_cast<int64_t>(memory::PageOptions::HugePages::none))
+  ->Arg(static_cast<int64_t>(memory::PageOptions::HugePages::transparent))
+  ->Unit(benchmark::kMillisecond);
+
+// Multi-threaded scaling: every thread constructs and destroys a small burst of
+// objects per iteration, which is closer to a worker producing messages than a
+// single construct/destroy pair.
+constexpr size_t kBurst = 16;
+constexpr size_t kSharedPoolSize = 1 << 16;
+
+static void BM_NewDeleteThreaded(benchmark::State &state)
+{
+  BenchmarkObject *objs[kBurst];
+  for (auto _ : state) {
+    for (auto &obj : objs) { obj = new BenchmarkObject(); }
+    benchmark::DoNotOptimize(objs);
+    for (auto *obj : objs) { delete obj; }
+  }
+  state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(kBurst));
+}
+BENCHMARK(BM_NewDeleteThreaded)->Apply(ThreadScaling);
+
+static void BM_LockedObjectPoolThreaded(benchmark::State &state)
+{
+  static memory::ObjectPool<BenchmarkObject> pool(kSharedPoolSize);
+  static std::mutex pool_mutex;
+  BenchmarkObject *objs[kBurst];
+  for (auto _ : state) {
+    for (auto &obj : objs) {
+      auto lock = std::lock_guard(pool_mutex);
+      obj = pool.construct();
+    }
+    benchmark::DoNotOptimize(objs);
+    for (auto *obj : objs) {
+      auto lock = std::lock_guard(pool_mutex);
+      pool.destroy(obj);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(kBurst));
+}
+BENCHMARK(BM_LockedObjectPoolThreaded)->Apply(ThreadScaling);
+
+static void BM_ConcurrentObjectPoolThreaded(benchmark::State &state)
+{
+  static memory::ConcurrentObjectPool<BenchmarkObject> pool(kSharedPoolSize);
+  BenchmarkObject *objs[kBurst];
+  for (auto _ : state) {
+    for (auto &obj : objs) { obj = pool.construct(); }
+    benchmark::DoNotOptimize(objs);
+    for (auto *obj : objs) { pool.destroy(obj); }
+  }
+  state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(kBurst));
+}
+BENCHMARK(BM_ConcurrentObjectPoolThreaded)->Apply(ThreadScaling);
+
+static void BM_LockFreeObjectPoolThreaded(benchmark::State &state)
+{
+  static memory::LockFreeObjectPool<BenchmarkObject> pool(kSharedPoolSize);
+  BenchmarkObject *objs[kBurst];
+  for (auto _ : state) {
+    for (auto &obj : objs) { obj = pool.construct(); }
+    benchmark::DoNotOptimize(objs);
+    for (auto *obj : objs) { pool.destroy(obj); }
+  }
+  state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(kBurst));
+}
+BENCHMARK(BM_LockFreeObjectPoolThreaded)->Apply(ThreadScaling);
+
+// Contention with cross-thread frees: each thread hands every object it builds
+// to a neighbour through a mailbox and destroys whatever it receives.
+template<typename Pool> static void CrossThreadFree(benchmark::State &state, Pool &pool)
+{
+  static constexpr size_t kMailboxSize = 64;
+  static std::atomic<BenchmarkObject *> mailbox[kMailboxSize];
+  auto offset = static_cast<size_t>(state.thread_index()) * 7;
+  size_t i = 0;
+  for (auto _ : state) {
+    BenchmarkObject *obj = pool.construct();
+    BenchmarkObject *other = mailbox[(offset + i++) % kMailboxSize].exchange(obj, std::memory_order_acq_rel);
+    if (other != nullptr) { pool.destroy(other); }
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_ConcurrentObjectPoolCrossThread(benchmark::State &state)
+{
+  static memory::ConcurrentObjectPool<BenchmarkObject> pool(kSharedPoolSize);
+  CrossThreadFree(state, pool);
+}
+BENCHMARK(BM_ConcurrentObjectPoolCrossThread)->Apply(ThreadScaling);
+
+static void BM_LockFreeObjectPoolCrossThread(benchmark::State &state)
+{
+  static memory::LockFreeObjectPool<BenchmarkObject> pool(kSharedPoolSize);
+  CrossThreadFree(state, pool);
+}
+BENCHMARK(BM_LockFreeObjectPoolCrossThread)->Apply(ThreadScaling);
+
 BENCHMARK_MAIN();
\ No newline at end of file
@@ -0,0 +1,116 @@
+#include "threadpool/parallel.h"
+#include "threadpool/threadpool.h"
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <future>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+#if defined(CPP_EXPERIMENTS_HAVE_STD_PAR)
+#include <execution>
+#endif
+
+// Data-parallel algorithms on ThreadPool against the alternatives: a serial
+// loop, the chunk-per-worker vector of futures every caller used to write by
+// hand, and std::execution::par when the standard library has a parallel
+// backend (CMake defines CPP_EXPERIMENTS_HAVE_STD_PAR when TBB is found).
+// range(0) is the element count.
+
+static unsigned Workers() { return std::max(2U, std::thread::hardware_concurrency()); }
+
+static std::vector<double> Input(int64_t size)
+{
+  std::vector<double> data(static_cast<size_t>(size));
+  std::iota(data.begin(), data.end(), 1.0);
+  return data;
+}
+
+static void BM_ReduceSerial(benchmark::State &state)
+{
+  auto data = Input(state.range(0));
+  for (auto _ : state) { benchmark::DoNotOptimize(std::accumulate(data.begin(), data.end(), 0.0)); }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ReduceSerial)->Arg(1 << 10)->Arg(1 << 20)->Arg(1 << 24)->UseRealTime();
+
+static void BM_ReduceFutures(benchmark::State &state)
+{
+  ThreadPool pool(Workers());
+  auto data = Input(state.range(0));
+  for (auto _ : state) {
+    size_t chunk = (data.size() + pool.size() - 1) / pool.size();
+    std::vector<std::future<double>> partials;
+    for (size_t begin = 0; begin < data.size(); begin += chunk) {
+      size_t end = std::min(data.size(), begin + chunk);
+      partials.push_back(pool.enqueue([&data, begin, end] {
+        return std::accumulate(data.begin() + static_cast<ptrdiff_t>(begin), data.begin() + static_cast<ptrdiff_t>(end), 0.0);
+      }));
+    }
+    double sum = 0.0;
+    for (auto &partial : partials) { sum += partial.get(); }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ReduceFutures)->Arg(1 << 10)->Arg(1 << 20)->Arg(1 << 24)->UseRealTime();
+
+static void BM_ReducePool(benchmark::State &state)
+{
+  ThreadPool pool(Workers());
+  auto data = Input(state.range(0));
+  for (auto _ : state) { benchmark::DoNotOptimize(threadpool::parallel_reduce(pool, data, 0.0)); }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ReducePool)->Arg(1 << 10)->Arg(1 << 20)->Arg(1 << 24)->UseRealTime();
+
+static void BM_TransformSerial(benchmark::State &state)
+{
+  auto data = Input(state.range(0));
+  std::vector<double> out(data.size());
+  for (auto _ : state) {
+    std::transform(data.begin(), data.end(), out.begin(), [](double v) { return std::sqrt(v); });
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_TransformSerial)->Arg(1 << 10)->Arg(1 << 20)->Arg(1 << 24)->UseRealTime();
+
+static void BM_TransformPool(benchmark::State &state)
+{
+  ThreadPool pool(Workers());
+  auto data = Input(state.range(0));
+  std::vector<double> out(data.size());
+  for (auto _ : state) {
+    threadpool::parallel_transform(pool, data, out.begin(), [](double v) { return std::sqrt(v); });
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_TransformPool)->Arg(1 << 10)->Arg(1 << 20)->Arg(1 << 24)->UseRealTime();
+
+#if defined(CPP_EXPERIMENTS_HAVE_STD_PAR)
+static void BM_ReduceStdPar(benchmark::State &state)
+{
+  auto data = Input(state.range(0));
+  for (auto _ : state) { benchmark::DoNotOptimize(std::reduce(std::execution::par, data.begin(), data.end(), 0.0)); }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ReduceStdPar)->Arg(1 << 10)->Arg(1 << 20)->Arg(1 << 24)->UseRealTime();
+
+static void BM_TransformStdPar(benchmark::State &state)
+{
+  auto data = Input(state.range(0));
+  std::vector<double> out(data.size());
+  for (auto _ : state) {
+    std::transform(std::execution::par, data.begin(), data.end(), out.begin(), [](double v) { return std::sqrt(v); });
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_TransformStdPar)->Arg(1 << 10)->Arg(1 << 20)->Arg(1 << 24)->UseRealTime();
+#endif
+
+BENCHMARK_MAIN();
@@ -0,0 +1,330 @@
+#include "threadsafequeue/mpmc_queue.h"
+#include "threadsafequeue/spsc_queue.h"
+#include "threadsafequeue/thread_safe_queue.h"
+#include "threadsafequeue/timestamp_queue.h"
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <random>
+#include <thread>
+#include <vector>
+
+// Queue throughput with P producers and P consumers. Benchmark threads with an
+// even index produce, odd ones consume; every thread moves kBatch items per
+// iteration, so producers and consumers stay balanced and the queue drains at
+// the end of each run. Items point into a static array and are never deleted,
+// so only the queue itself is measured.
+constexpr int kBatch = 64;
+constexpr size_t kCapacity = 1024;
+
+struct Item
+{
+  int64_t value;
+};
+
+struct NoDelete
+{
+  void operator()(Item * /*unused*/) const noexcept {}
+};
+
+static Item g_items[kBatch];
+
+// Runs 1P1C, 4P4C and NPNC, where N is half the hardware threads.
+static void ProducerConsumerPairs(benchmark::internal::Benchmark *bench)
+{
+  int pairs = static_cast<int>(std::max(1U, std::thread::hardware_concurrency() / 2));
+  bench->Threads(2)->Threads(8);
+  if (pairs != 1 && pairs != 4) { bench->Threads(2 * pairs); }
+  bench->UseRealTime();
+}
+
+template<typename Queue> static void ProducerConsumer(benchmark::State &state, Queue &queue)
+{
+  bool producer = state.thread_index() % 2 == 0;
+  for (auto _ : state) {
+    if (producer) {
+      for (auto &item : g_items) { queue.push(typename Queue::value_type(&item)); }
+    } else {
+      for (int i = 0; i < kBatch; i++) { benchmark::DoNotOptimize(queue.wait_and_pop()); }
+    }
+  }
+  // Every thread counts only its own side, so items/s is the number moved end to end.
+  if (producer) { state.SetItemsProcessed(state.iterations() * kBatch); }
+}
+
+static void BM_ThreadSafeQueue(benchmark::State &state)
+{
+  static threaded_queue::ThreadSafeQueue<Item, NoDelete> queue;
+  ProducerConsumer(state, queue);
+}
+BENCHMARK(BM_ThreadSafeQueue)->Apply(ProducerConsumerPairs);
+
+static void BM_BoundedMPMCQueue(benchmark::State &state)
+{
+  static threaded_queue::BoundedMPMCQueue<Item, NoDelete> queue(kCapacity);
+  ProducerConsumer(state, queue);
+}
+BENCHMARK(BM_BoundedMPMCQueue)->Apply(ProducerConsumerPairs);
+
+// Single producer, single consumer pipelines.
+
+// Round trip latency: the benchmark thread sends an item on one queue and an
+// echo thread sends it straight back on another.
+template<typename Queue> static void PingPong(benchmark::State &state, Queue &ping, Queue &pong)
+{
+  std::thread echo([&] {
+    while (auto item = ping.wait_and_pop()) { pong.push(std::move(*item)); }
+  });
+  for (auto _ : state) {
+    ping.push(typename Queue::value_type(&g_items[0]));
+    benchmark::DoNotOptimize(pong.wait_and_pop());
+  }
+  ping.shutdown();
+  echo.join();
+  state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_PingPongThreadSafeQueue(benchmark::State &state)
+{
+  threaded_queue::ThreadSafeQueue<Item, NoDelete> ping;
+  threaded_queue::ThreadSafeQueue<Item, NoDelete> pong;
+  PingPong(state, ping, pong);
+}
+BENCHMARK(BM_PingPongThreadSafeQueue)->UseRealTime();
+
+static void BM_PingPongSPSCQueue(benchmark::State &state)
+{
+  threaded_queue::SPSCQueue<Item, NoDelete> ping(kCapacity);
+  threaded_queue::SPSCQueue<Item, NoDelete> pong(kCapacity);
+  PingPong(state, ping, pong);
+}
+BENCHMARK(BM_PingPongSPSCQueue)->UseRealTime();
+
+// Wake-up latency of ThreadSafeQueue per consumer WaitPolicy: 0 = block,
+// 1 = spin_then_park with the default budget, 2 = spin_then_park without the
+// pause loop (yields only), which suits oversubscribed machines.
+static threaded_queue::WaitPolicy WaitPolicyArg(int64_t arg)
+{
+  switch (arg) {
+  case 1: return threaded_queue::WaitPolicy::spin_then_park();
+  case 2: return threaded_queue::WaitPolicy::spin_then_park(0);
+  default: return threaded_queue::WaitPolicy::block();
+  }
+}
+
+static void BM_PingPongWaitPolicy(benchmark::State &state)
+{
+  threaded_queue::ThreadSafeQueue<Item, NoDelete> ping(WaitPolicyArg(state.range(0)));
+  threaded_queue::ThreadSafeQueue<Item, NoDelete> pong(WaitPolicyArg(state.range(0)));
+  PingPong(state, ping, pong);
+}
+BENCHMARK(BM_PingPongWaitPolicy)->DenseRange(0, 2)->UseRealTime();
+
+// Throughput: the benchmark thread produces kBatch items per iteration, a
+// consumer thread drains them.
+template<typename Queue, typename Consume> static void Stream(benchmark::State &state, Queue &queue, Consume consume)
+{
+  std::atomic<bool> done{ false };
+  std::thread consumer([&] { consume(queue, done); });
+  for (auto _ : state) {
+    for (auto &item : g_items) { queue.push(typename Queue::value_type(&item)); }
+  }
+  done.store(true);
+  queue.shutdown();
+  consumer.join();
+  state.SetItemsProcessed(state.iterations() * kBatch);
+}
+
+constexpr auto kDrainOneByOne = [](auto &queue, std::atomic<bool> & /*done*/) {
+  while (auto item = queue.wait_and_pop()) { benchmark::DoNotOptimize(item); }
+};
+
+static void BM_StreamThreadSafeQueue(benchmark::State &state)
+{
+  threaded_queue::ThreadSafeQueue<Item, NoDelete> queue;
+  Stream(state, queue, kDrainOneByOne);
+}
+BENCHMARK(BM_StreamThreadSafeQueue)->UseRealTime();
+
+// Same stream with QueueStats recording; the difference is the cost of the
+// counters and the clock reads.
+static void BM_StreamThreadSafeQueueStats(benchmark::State &state)
+{
+  threaded_queue::ThreadSafeQueue<Item, NoDelete, threaded_queue::QueueStats> queue;
+  Stream(state, queue, kDrainOneByOne);
+  state.counters["lock_waits"] = static_cast<double>(queue.stats().lock_waits);
+}
+BENCHMARK(BM_StreamThreadSafeQueueStats)->UseRealTime();
+
+static void BM_StreamBoundedMPMCQueue(benchmark::State &state)
+{
+  threaded_queue::BoundedMPMCQueue<Item, NoDelete> queue(kCapacity);
+  Stream(state, queue, kDrainOneByOne);
+}
+BENCHMARK(BM_StreamBoundedMPMCQueue)->UseRealTime();
+
+static void BM_StreamSPSCQueue(benchmark::State &state)
+{
+  threaded_queue::SPSCQueue<Item, NoDelete> queue(kCapacity);
+  Stream(state, queue, kDrainOneByOne);
+}
+BENCHMARK(BM_StreamSPSCQueue)->UseRealTime();
+
+// Same stream, but the consumer drains whole spans in place.
+static void BM_StreamSPSCQueueSpans(benchmark::State &state)
+{
+  threaded_queue::SPSCQueue<Item, NoDelete> queue(kCapacity);
+  Stream(state, queue, [](auto &q, std::atomic<bool> &done) {
+    while (true) {
+      auto span = q.read_span(kCapacity);
+      if (span.empty()) {
+        if (done.load() && q.empty()) { return; }
+        std::this_thread::yield();
+        continue;
+      }
+      benchmark::DoNotOptimize(span.data());
+      q.commit_read(span.size());
+    }
+  });
+}
+BENCHMARK(BM_StreamSPSCQueueSpans)->UseRealTime();
+
+// Batch size sweep on ThreadSafeQueue: the benchmark thread pushes kStreamItems
+// items per iteration in batches of range(0) with push_bulk and a consumer thread
+// drains with wait_and_pop_bulk. A batch of 1 uses plain push/wait_and_pop, so
+// the first row is the per-item locking and wake-up cost.
+constexpr int kStreamItems = 4096;
+
+static void BM_ThreadSafeQueueBatch(benchmark::State &state)
+{
+  using Queue = threaded_queue::ThreadSafeQueue<Item, NoDelete>;
+  auto batch_size = static_cast<size_t>(state.range(0));
+  Queue queue;
+  std::thread consumer([&] {
+    if (batch_size == 1) {
+      while (auto item = queue.wait_and_pop()) { benchmark::DoNotOptimize(item); }
+      return;
+    }
+    std::vector<Queue::value_type> out;
+    out.reserve(batch_size);
+    while (queue.wait_and_pop_bulk(std::back_inserter(out), batch_size) > 0) {
+      benchmark::DoNotOptimize(out.data());
+      out.clear();
+    }
+  });
+
+  std::vector<Queue::value_type> batch(batch_size);
+  for (auto _ : state) {
+    for (int pushed = 0; pushed < kStreamItems; pushed += static_cast<int>(batch_size)) {
+      if (batch_size == 1) {
+        queue.push(Queue::value_type(&g_items[0]));
+        continue;
+      }
+      for (auto &item : batch) { item = Queue::value_type(&g_items[0]); }
+      queue.push_bulk(batch);
+    }
+  }
+  queue.shutdown();
+  consumer.join();
+  state.SetItemsProcessed(state.iterations() * kStreamItems);
+}
+BENCHMARK(BM_ThreadSafeQueueBatch)->RangeMultiplier(4)->Range(1, 1024)->UseRealTime();
+
+// Value storage against pointer storage: the benchmark thread streams kBatch
+// payloads per iteration to a consumer thread. ThreadSafeQueue<T> pays a
+// make_unique per item and the consumer frees it; ThreadSafeValueQueue<T>
+// moves the payload itself into the ring.
+template<size_t Bytes> struct Payload
+{
+  std::array<std::byte, Bytes> bytes{};
+};
+
+template<typename Queue, typename Make> static void StreamPayloads(benchmark::State &state, Make make)
+{
+  Queue queue;
+  std::thread consumer([&] {
+    while (auto item = queue.wait_and_pop()) { benchmark::DoNotOptimize(item); }
+  });
+  for (auto _ : state) {
+    for (int i = 0; i < kBatch; i++) { queue.push(make()); }
+  }
+  queue.shutdown();
+  consumer.join();
+  state.SetItemsProcessed(state.iterations() * kBatch);
+}
+
+template<typename T> static void BM_PayloadPointerQueue(benchmark::State &state)
+{
+  StreamPayloads<threaded_queue::ThreadSafeQueue<T>>(state, [] { return std::make_unique<T>(); });
+}
+
+template<typename T> static void BM_PayloadValueQueue(benchmark::State &state)
+{
+  StreamPayloads<threaded_queue::ThreadSafeValueQueue<T>>(state, [] { return T{}; });
+}
+
+using SmallPayload = Payload<16>;
+using MediumPayload = Payload<256>;
+using Task = std::function<void()>;
+
+BENCHMARK(BM_PayloadPointerQueue<SmallPayload>)->UseRealTime();
+BENCHMARK(BM_PayloadValueQueue<SmallPayload>)->UseRealTime();
+BENCHMARK(BM_PayloadPointerQueue<MediumPayload>)->UseRealTime();
+BENCHMARK(BM_PayloadValueQueue<MediumPayload>)->UseRealTime();
+BENCHMARK(BM_PayloadPointerQueue<Task>)->UseRealTime();
+BENCHMARK(BM_PayloadValueQueue<Task>)->UseRealTime();
+
+// Timestamp ordering, hold model: range(0) messages stay queued; every
+// iteration pops the earliest and pushes it back a random distance later.
+// Messages are allocated in shuffled order, so following their pointers to
+// compare timestamps, as std::priority_queue has to, misses the cache.
+static std::vector<std::unique_ptr<Message>> ScatteredMessages(size_t n, std::mt19937_64 &rng)
+{
+  std::vector<std::unique_ptr<Message>> messages(n);
+  std::vector<size_t> order(n);
+  for (size_t i = 0; i < n; i++) { order[i] = i; }
+  std::shuffle(order.begin(), order.end(), rng);
+  for (size_t i : order) { messages[i] = std::make_unique<Message>(Message{ rng() % n, "topic", {} }); }
+  return messages;
+}
+
+static void BM_TimestampStdPriorityQueue(benchmark::State &state)
+{
+  auto later = [](const auto &a, const auto &b) { return a->timestamp_ns > b->timestamp_ns; };
+  std::priority_queue<std::unique_ptr<Message>, std::vector<std::unique_ptr<Message>>, decltype(later)> queue(later);
+  std::mt19937_64 rng(42);
+  for (auto &message : ScatteredMessages(static_cast<size_t>(state.range(0)), rng)) { queue.push(std::move(message)); }
+  for (auto _ : state) {
+    // top() is const; the element is popped right after the move.
+    auto message = std::move(const_cast<std::unique_ptr<Message> &>(queue.top()));
+    queue.pop();
+    message->timestamp_ns += rng() % static_cast<uint64_t>(state.range(0));
+    queue.push(std::move(message));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_TimestampStdPriorityQueue)->RangeMultiplier(16)->Range(1 << 10, 1 << 18);
+
+template<size_t Arity> static void BM_TimestampHeap(benchmark::State &state)
+{
+  threaded_queue::TimestampHeap<std::unique_ptr<Message>, threaded_queue::MessageTimestamp, Arity> heap;
+  std::mt19937_64 rng(42);
+  for (auto &message : ScatteredMessages(static_cast<size_t>(state.range(0)), rng)) { heap.push(std::move(message)); }
+  for (auto _ : state) {
+    auto message = heap.pop();
+    message->timestamp_ns += rng() % static_cast<uint64_t>(state.range(0));
+    heap.push(std::move(message));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_TimestampHeap<2>)->RangeMultiplier(16)->Range(1 << 10, 1 << 18);
+BENCHMARK(BM_TimestampHeap<4>)->RangeMultiplier(16)->Range(1 << 10, 1 << 18);
+BENCHMARK(BM_TimestampHeap<8>)->RangeMultiplier(16)->Range(1 << 10, 1 << 18);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,432 @@
+#include "threadpool/coroutine.h"
+#include "threadpool/task_graph.h"
+#include "threadpool/task_group.h"
+#include "threadpool/threadpool.h"
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <future>
+#include <memory>
+#include <new>
+#include <random>
+#include <thread>
+#include <vector>
+
+// Every call to the global operator new in this executable is counted, so the
+// submission benchmarks can report heap allocations per task.
+#if defined(__GNUC__) && !defined(__clang__)
+// GCC inlines the replacement operators and then flags the malloc/free pair.
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+static std::atomic<uint64_t> g_allocations{ 0 };
+
+void *operator new(std::size_t size)
+{
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void *ptr = std::malloc(size == 0 ? 1 : size)) { return ptr; }
+  throw std::bad_alloc();
+}
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::size_t /*size*/) noexcept { std::free(ptr); }
+
+// Submit-to-completion latency of a single no-op task on an otherwise idle
+// pool, so every task has to wake a waiting worker. Arg selects the worker
+// WaitPolicy: 0 = block, 1 = spin_then_park, 2 = spin_then_park without the
+// pause loop.
+static threaded_queue::WaitPolicy WaitPolicyArg(int64_t arg)
+{
+  switch (arg) {
+  case 1: return threaded_queue::WaitPolicy::spin_then_park();
+  case 2: return threaded_queue::WaitPolicy::spin_then_park(0);
+  default: return threaded_queue::WaitPolicy::block();
+  }
+}
+
+static void BM_ThreadPoolWakeLatency(benchmark::State &state)
+{
+  ThreadPool pool(2, WaitPolicyArg(state.range(0)));
+  for (auto _ : state) { pool.enqueue([] { return 1; }).get(); }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ThreadPoolWakeLatency)->DenseRange(0, 2)->UseRealTime();
+
+// Fine-grained recursive work, shared queue (Arg 0) against work stealing
+// (Arg 1). Tasks never block on each other: every task that splits enqueues
+// its halves and returns, and the benchmark thread waits for a counter of
+// outstanding tasks to reach zero.
+static ThreadPool::Scheduling SchedulingArg(int64_t arg)
+{
+  return arg == 0 ? ThreadPool::Scheduling::shared_queue : ThreadPool::Scheduling::work_stealing;
+}
+
+static unsigned Workers() { return std::max(2U, std::thread::hardware_concurrency()); }
+
+static void WaitForZero(std::atomic<int64_t> &pending)
+{
+  for (int64_t left = pending.load(); left != 0; left = pending.load()) { pending.wait(left); }
+}
+
+static void Done(std::atomic<int64_t> &pending, int64_t n = 1)
+{
+  if (pending.fetch_sub(n) == n) { pending.notify_all(); }
+}
+
+// Naive fib(range(1)) with one task per call above a small serial cutoff.
+static uint64_t SerialFib(int n) { return n < 2 ? static_cast<uint64_t>(n) : SerialFib(n - 1) + SerialFib(n - 2); }
+
+static void BM_ThreadPoolFib(benchmark::State &state)
+{
+  constexpr int kCutoff = 12;
+  ThreadPool pool(Workers(), {}, SchedulingArg(state.range(0)));
+  auto n = static_cast<int>(state.range(1));
+  std::atomic<uint64_t> sum{ 0 };
+  std::atomic<int64_t> pending{ 0 };
+  std::atomic<int64_t> tasks{ 0 };
+
+  std::function<void(int)> fib = [&](int k) {
+    tasks.fetch_add(1, std::memory_order_relaxed);
+    if (k <= kCutoff) {
+      sum.fetch_add(SerialFib(k), std::memory_order_relaxed);
+    } else {
+      pending.fetch_add(2);
+      pool.enqueue(fib, k - 1);
+      pool.enqueue(fib, k - 2);
+    }
+    Done(pending);
+  };
+
+  for (auto _ : state) {
+    sum = 0;
+    pending = 1;
+    pool.enqueue(fib, n);
+    WaitForZero(pending);
+    benchmark::DoNotOptimize(sum.load());
+  }
+  state.counters["tasks"] = benchmark::Counter(static_cast<double>(tasks.load()), benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_ThreadPoolFib)->ArgsProduct({ { 0, 1 }, { 25 } })->UseRealTime()->Unit(benchmark::kMillisecond);
+
+// Parallel quicksort of range(1) random ints; ranges below the cutoff are
+// sorted serially.
+static void BM_ThreadPoolQuicksort(benchmark::State &state)
+{
+  constexpr ptrdiff_t kCutoff = 2048;
+  ThreadPool pool(Workers(), {}, SchedulingArg(state.range(0)));
+  auto size = static_cast<size_t>(state.range(1));
+  std::vector<int> input(size);
+  std::mt19937 rng(7);
+  for (auto &value : input) { value = static_cast<int>(rng()); }
+  std::vector<int> data;
+  std::atomic<int64_t> pending{ 0 };
+
+  std::function<void(int *, int *)> sort = [&](int *first, int *last) {
+    if (last - first <= kCutoff) {
+      std::sort(first, last);
+    } else {
+      int pivot = first[(last - first) / 2];
+      int *middle1 = std::partition(first, last, [pivot](int v) { return v < pivot; });
+      int *middle2 = std::partition(middle1, last, [pivot](int v) { return !(pivot < v); });
+      pending.fetch_add(2);
+      pool.enqueue(sort, first, middle1);
+      pool.enqueue(sort, middle2, last);
+    }
+    Done(pending);
+  };
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    data = input;
+    state.ResumeTiming();
+    pending = 1;
+    pool.enqueue(sort, data.data(), data.data() + data.size());
+    WaitForZero(pending);
+  }
+  if (!std::is_sorted(data.begin(), data.end())) { state.SkipWithError("not sorted"); }
+  state.SetItemsProcessed(state.iterations() * state.range(1));
+}
+BENCHMARK(BM_ThreadPoolQuicksort)->ArgsProduct({ { 0, 1 }, { 1 << 20 } })->UseRealTime()->Unit(benchmark::kMillisecond);
+
+// Throughput of empty tasks: the benchmark thread submits kBurst tasks per
+// iteration and waits for all of them. Arg 0 selects the submission path:
+//   0  what enqueue did before Task existed: make_shared<packaged_task>,
+//      std::bind and a std::function wrapper
+//   1  enqueue, returning a std::future
+//   2  async, returning a pooled threadpool::Future
+//   3  submit, no future at all
+// Arg 1 selects the scheduling as above.
+static void BM_ThreadPoolEmptyTasks(benchmark::State &state)
+{
+  constexpr int64_t kBurst = 1024;
+  ThreadPool pool(Workers(), {}, SchedulingArg(state.range(1)));
+  std::atomic<int64_t> pending{ 0 };
+  auto empty = [&pending] { Done(pending); };
+
+  auto submit_burst = [&] {
+    pending = kBurst;
+    for (int64_t i = 0; i < kBurst; i++) {
+      switch (state.range(0)) {
+      case 0: {
+        auto task = std::make_shared<std::packaged_task<void()>>(std::bind(empty));
+        benchmark::DoNotOptimize(task->get_future());
+        pool.submit(std::function<void()>([task] { (*task)(); }));
+        break;
+      }
+      case 1: benchmark::DoNotOptimize(pool.enqueue(empty)); break;
+      case 2: benchmark::DoNotOptimize(pool.async(empty)); break;
+      default: pool.submit(empty); break;
+      }
+    }
+    WaitForZero(pending);
+  };
+
+  submit_burst();// warm up the pools
+  uint64_t allocations = g_allocations.load(std::memory_order_relaxed);
+  for (auto _ : state) { submit_burst(); }
+  allocations = g_allocations.load(std::memory_order_relaxed) - allocations;
+  auto tasks = static_cast<double>(state.iterations() * kBurst);
+  state.SetItemsProcessed(state.iterations() * kBurst);
+  state.counters["allocs_per_task"] = static_cast<double>(allocations) / tasks;
+}
+BENCHMARK(BM_ThreadPoolEmptyTasks)->ArgsProduct({ { 0, 1, 2, 3 }, { 0, 1 } })->UseRealTime();
+
+// Cost of Options::trace: the empty submit tasks above with tracing off
+// (arg 0) and on (arg 1). Arg 1 selects the scheduling.
+static void BM_ThreadPoolTracedTasks(benchmark::State &state)
+{
+  constexpr int64_t kBurst = 1024;
+  ThreadPool pool(ThreadPool::Options{
+    .threads = Workers(), .scheduling = SchedulingArg(state.range(1)), .trace = state.range(0) != 0 });
+  std::atomic<int64_t> pending{ 0 };
+  auto submit_burst = [&] {
+    pending = kBurst;
+    for (int64_t i = 0; i < kBurst; i++) {
+      pool.submit([&pending] { Done(pending); });
+    }
+    WaitForZero(pending);
+  };
+
+  submit_burst();
+  for (auto _ : state) { submit_burst(); }
+  state.SetItemsProcessed(state.iterations() * kBurst);
+  if (state.range(0) != 0) {
+    auto stats = pool.trace_stats();
+    state.counters["wait_p50_us"] = static_cast<double>(stats.queue_wait_percentile_ns(0.5)) / 1e3;
+    state.counters["run_p50_us"] = static_cast<double>(stats.run_percentile_ns(0.5)) / 1e3;
+  }
+}
+BENCHMARK(BM_ThreadPoolTracedTasks)->ArgsProduct({ { 0, 1 }, { 0, 1 } })->UseRealTime();
+
+// Fan-out/fan-in of range(0) small tasks, each returning a value that the
+// benchmark thread sums: a std::future per task, a pooled threadpool::Future
+// per task, a TaskGroup, and coroutines joined by a single when_all.
+static uint64_t Work(uint64_t i) { return i * i; }
+
+static void BM_FanOutFutures(benchmark::State &state)
+{
+  ThreadPool pool(Workers());
+  auto n = static_cast<uint64_t>(state.range(0));
+  std::vector<std::future<uint64_t>> results;
+  for (auto _ : state) {
+    results.clear();
+    for (uint64_t i = 0; i < n; i++) { results.push_back(pool.enqueue(Work, i)); }
+    uint64_t sum = 0;
+    for (auto &result : results) { sum += result.get(); }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_FanOutFutures)->Arg(1024)->UseRealTime();
+
+static void BM_FanOutAsync(benchmark::State &state)
+{
+  ThreadPool pool(Workers());
+  auto n = static_cast<uint64_t>(state.range(0));
+  std::vector<threadpool::Future<uint64_t>> results;
+  for (auto _ : state) {
+    results.clear();
+    for (uint64_t i = 0; i < n; i++) { results.push_back(pool.async(Work, i)); }
+    uint64_t sum = 0;
+    for (auto &result : results) { sum += result.get(); }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_FanOutAsync)->Arg(1024)->UseRealTime();
+
+// The same with one TaskGroup: results go to a preallocated vector, and the
+// benchmark thread helps run the tasks while it waits.
+static void BM_FanOutTaskGroup(benchmark::State &state)
+{
+  ThreadPool pool(Workers());
+  auto n = static_cast<uint64_t>(state.range(0));
+  std::vector<uint64_t> results(n);
+  for (auto _ : state) {
+    threadpool::TaskGroup group(pool);
+    for (uint64_t i = 0; i < n; i++) {
+      group.run([&results, i] { results[i] = Work(i); });
+    }
+    group.wait();
+    uint64_t sum = 0;
+    for (uint64_t result : results) { sum += result; }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_FanOutTaskGroup)->Arg(1024)->UseRealTime();
+
+static threadpool::task<uint64_t> WorkOn(ThreadPool &pool, uint64_t i)
+{
+  co_await pool.schedule();
+  co_return Work(i);
+}
+
+static threadpool::task<uint64_t> FanOut(ThreadPool &pool, uint64_t n)
+{
+  std::vector<threadpool::task<uint64_t>> children;
+  children.reserve(n);
+  for (uint64_t i = 0; i < n; i++) { children.push_back(WorkOn(pool, i)); }
+  uint64_t sum = 0;
+  for (uint64_t value : co_await threadpool::when_all(std::move(children))) { sum += value; }
+  co_return sum;
+}
+
+static void BM_FanOutCoroutines(benchmark::State &state)
+{
+  ThreadPool pool(Workers());
+  auto n = static_cast<uint64_t>(state.range(0));
+  for (auto _ : state) { benchmark::DoNotOptimize(threadpool::sync_wait(FanOut(pool, n))); }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_FanOutCoroutines)->Arg(1024)->UseRealTime();
+
+// BM_ThreadPoolFib written with coroutines: every split awaits both halves
+// with when_all instead of counting outstanding tasks by hand. A future-based
+// version would block a worker per level and deadlock.
+static threadpool::task<uint64_t> CoroutineFib(ThreadPool &pool, int n)
+{
+  constexpr int kCutoff = 12;
+  co_await pool.schedule();
+  if (n <= kCutoff) { co_return SerialFib(n); }
+  auto [a, b] = co_await threadpool::when_all(CoroutineFib(pool, n - 1), CoroutineFib(pool, n - 2));
+  co_return a + b;
+}
+
+static void BM_CoroutineFib(benchmark::State &state)
+{
+  ThreadPool pool(Workers(), {}, SchedulingArg(state.range(0)));
+  auto n = static_cast<int>(state.range(1));
+  for (auto _ : state) { benchmark::DoNotOptimize(threadpool::sync_wait(CoroutineFib(pool, n))); }
+}
+BENCHMARK(BM_CoroutineFib)->ArgsProduct({ { 0, 1 }, { 25 } })->UseRealTime()->Unit(benchmark::kMillisecond);
+
+// Synthetic task graphs of empty nodes, built once and run every iteration.
+// Arg 0 selects the scheduling, Arg 1 the size:
+//   Wide:    one root, range(1) independent nodes, one sink
+//   Deep:    a chain of range(1) nodes
+//   Lattice: range(1) layers of 16 nodes, each node depending on two nodes
+//            of the layer above
+static void RunGraph(benchmark::State &state, threadpool::TaskGraph &graph)
+{
+  ThreadPool pool(Workers(), {}, SchedulingArg(state.range(0)));
+  for (auto _ : state) { graph.run(pool); }
+  state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(graph.size()));
+}
+
+static void BM_TaskGraphWide(benchmark::State &state)
+{
+  threadpool::TaskGraph graph;
+  auto root = graph.add([] {});
+  auto sink = graph.add([] {});
+  for (int64_t i = 0; i < state.range(1); i++) { graph.precede(graph.add([] {}, { root }), sink); }
+  RunGraph(state, graph);
+}
+BENCHMARK(BM_TaskGraphWide)->ArgsProduct({ { 0, 1 }, { 1024 } })->UseRealTime();
+
+static void BM_TaskGraphDeep(benchmark::State &state)
+{
+  threadpool::TaskGraph graph;
+  auto last = graph.add([] {});
+  for (int64_t i = 1; i < state.range(1); i++) { last = graph.add([] {}, { last }); }
+  RunGraph(state, graph);
+}
+BENCHMARK(BM_TaskGraphDeep)->ArgsProduct({ { 0, 1 }, { 1024 } })->UseRealTime();
+
+static void BM_TaskGraphLattice(benchmark::State &state)
+{
+  constexpr size_t kWidth = 16;
+  threadpool::TaskGraph graph;
+  std::vector<threadpool::TaskGraph::NodeId> layer;
+  for (size_t i = 0; i < kWidth; i++) { layer.push_back(graph.add([] {})); }
+  for (int64_t depth = 1; depth < state.range(1); depth++) {
+    std::vector<threadpool::TaskGraph::NodeId> next;
+    for (size_t i = 0; i < kWidth; i++) { next.push_back(graph.add([] {}, { layer[i], layer[(i + 1) % kWidth] })); }
+    layer = std::move(next);
+  }
+  RunGraph(state, graph);
+}
+BENCHMARK(BM_TaskGraphLattice)->ArgsProduct({ { 0, 1 }, { 64 } })->UseRealTime();
+
+// The deep chain the old way: every stage is a future the submitting thread
+// blocks on before it submits the next.
+static void BM_ChainFutures(benchmark::State &state)
+{
+  ThreadPool pool(Workers(), {}, SchedulingArg(state.range(0)));
+  for (auto _ : state) {
+    for (int64_t i = 0; i < state.range(1); i++) { pool.enqueue([] {}).get(); }
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(1));
+}
+BENCHMARK(BM_ChainFutures)->ArgsProduct({ { 0, 1 }, { 1024 } })->UseRealTime();
+
+// Latency of latency-sensitive tasks while the pool is saturated with bulk
+// work: kBacklog tasks of about 10us each, every one resubmitting itself, keep
+// the queues full while the benchmark thread submits one probe task per
+// iteration and waits for it. Reports submit-to-start latency percentiles in
+// microseconds. Arg selects the setup:
+//   0  probes and bulk work share the normal lane, the FIFO baseline
+//   1  probes on the high lane, bulk work on the low lane
+//   2  as 1, with one worker reserved for the high lane
+static void Spin(std::chrono::nanoseconds duration)
+{
+  auto until = std::chrono::steady_clock::now() + duration;
+  while (std::chrono::steady_clock::now() < until) {}
+}
+
+static void BM_ThreadPoolPriorityLatency(benchmark::State &state)
+{
+  using Priority = ThreadPool::Priority;
+  constexpr int kBacklog = 64;
+  bool lanes = state.range(0) != 0;
+  ThreadPool pool(ThreadPool::Options{ .threads = Workers(), .reserved_high = state.range(0) == 2 ? 1U : 0U });
+  Priority bulk_priority = lanes ? Priority::low : Priority::normal;
+  Priority probe_priority = lanes ? Priority::high : Priority::normal;
+
+  std::atomic<bool> stop{ false };
+  std::function<void()> bulk = [&] {
+    Spin(std::chrono::microseconds(10));
+    if (!stop.load(std::memory_order_relaxed)) { pool.submit(bulk_priority, bulk); }
+  };
+  for (int i = 0; i < kBacklog; i++) { pool.submit(bulk_priority, bulk); }
+
+  std::vector<double> latencies;
+  for (auto _ : state) {
+    auto submitted = std::chrono::steady_clock::now();
+    auto started = pool.async(probe_priority, [] { return std::chrono::steady_clock::now(); }).get();
+    latencies.push_back(std::chrono::duration<double, std::micro>(started - submitted).count());
+  }
+  stop = true;
+
+  std::sort(latencies.begin(), latencies.end());
+  auto percentile = [&latencies](double p) {
+    return latencies[static_cast<size_t>(p * static_cast<double>(latencies.size() - 1))];
+  };
+  state.counters["p50_us"] = percentile(0.50);
+  state.counters["p99_us"] = percentile(0.99);
+}
+BENCHMARK(BM_ThreadPoolPriorityLatency)->DenseRange(0, 2)->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -2,13 +2,26 @@
 
 #include <deque>
 #include <memory>
+#include <memory_resource>
 #include <optional>
+#include <span>
+#include <vector>
 #include "message.h"
+#include "objectpool/pooled_ptr.h"
+#include "threadsafequeue/queue_stats.h"
 
 class MessageQueue {
 public:
     MessageQueue() = default;
 
+    /**
+     * @brief Creates a queue whose internal storage is allocated from @p resource.
+     * @note The resource must outlive the queue. Pair it with a
+     * memory::ObjectPoolResource sized for the deque's block buffers to keep
+     * push/pop off the global heap.
+     */
+    explicit MessageQueue(std::pmr::memory_resource* resource);
+
     // We don't want the queue to be copyable, as that could be expensive
     // and lead to confusing semantics.
     MessageQueue(const MessageQueue&) = delete;
@@ -20,20 +33,38 @@ public:
 
     /**
      * @brief Pushes a new message onto the back of the queue.
-     * @param msg A unique_ptr to the message to be enqueued.
-     * @note The queue takes ownership of the message. The caller's unique_ptr
+     * @param msg A pointer to the message to be enqueued. Either a
+     * memory::pooled_ptr from memory::make_pooled, or a std::unique_ptr from
+     * std::make_unique, which converts implicitly.
+     * @note The queue takes ownership of the message. The caller's pointer
      * will be empty after this call. This is enforced by taking the
      * parameter by value and moving from it internally.
      */
-    void push(std::unique_ptr<Message> msg);
+    void push(memory::pooled_ptr<Message> msg);
 
     /**
      * @brief Tries to pop a message from the front of the queue.
-     * @return An std::optional containing a unique_ptr to the message if the
+     * @return An std::optional containing a pointer to the message if the
      * queue was not empty. Otherwise, returns std::nullopt.
-     * @note The caller receives ownership of the returned message.
+     * @note The caller receives ownership of the returned message. Dropping
+     * it returns pooled messages to their pool and deletes heap ones.
+     */
+    std::optional<memory::pooled_ptr<Message>> try_pop();
+
+    /**
+     * @brief Pushes every message in @p msgs onto the back of the queue, in order.
+     * @note The queue takes ownership; the pointers in @p msgs are left empty.
+     */
+    void push_bulk(std::span<memory::pooled_ptr<Message>> msgs);
+
+    /**
+     * @brief Pops up to @p max_n messages from the front of the queue and
+     * appends them to @p out.
+     * @return The number of messages appended, 0 if the queue was empty.
+     * @note MessageQueue is not synchronized, so there is no waiting variant;
+     * use threaded_queue::ThreadSafeQueue::wait_and_pop_bulk across threads.
      */
-    std::optional<std::unique_ptr<Message>> try_pop();
+    size_t pop_bulk(std::vector<memory::pooled_ptr<Message>>& out, size_t max_n);
 
     /**
      * @brief Returns the current number of messages in the queue.
@@ -45,9 +76,28 @@ public:
      */
     bool empty() const;
 
+    /**
+     * @brief Enqueue/dequeue counts, high-water mark and time spent queued.
+     * @note Recorded only in builds with cpp_experiments_ENABLE_QUEUE_STATS;
+     * all zero otherwise. lock_waits is always 0, there is no lock.
+     */
+    threaded_queue::QueueStatsSnapshot stats() const;
+
 private:
+    using Stats = threaded_queue::DefaultQueueStats;
+
+    // A message and the time it was queued; the stamp is empty when stats
+    // are compiled out.
+    struct Entry {
+        memory::pooled_ptr<Message> msg;
+        [[no_unique_address]] Stats::Stamp stamp;
+    };
+
     // Why std::deque? It provides efficient push_back and pop_front,
     // which is exactly what a queue needs. A std::vector would be inefficient
     // for pop_front as it would require shifting all other elements.
-    std::deque<std::unique_ptr<Message>> m_queue;
+    // The pmr flavour lets callers route its block allocations to a pool;
+    // by default it uses the global heap just like std::deque.
+    std::pmr::deque<Entry> m_queue;
+    Stats m_stats;
 };
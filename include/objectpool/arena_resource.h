@@ -0,0 +1,116 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <vector>
+
+namespace memory {
+
+/**
+ * @brief Monotonic arena std::pmr::memory_resource that can be rewound and reused.
+ *
+ * Allocation is a pointer bump inside the current chunk; deallocate() is a no-op
+ * and memory only comes back all at once. Unlike std::pmr::monotonic_buffer_resource,
+ * reset() keeps every chunk obtained from upstream and simply rewinds to the
+ * first one, so a job that is run over and over (one arena per batch, per task,
+ * per request) stops calling malloc after its first run. release() hands the
+ * chunks back to upstream.
+ *
+ * @note Not thread-safe. Use one arena per thread or per task.
+ */
+class ArenaResource : public std::pmr::memory_resource
+{
+  struct Chunk
+  {
+    std::byte *data;
+    size_t size;
+  };
+
+  std::pmr::memory_resource *m_upstream;
+  std::vector<Chunk> m_chunks;
+  size_t m_current = 0;// index into m_chunks
+  size_t m_offset = 0;// bytes used in m_chunks[m_current]
+  size_t m_next_chunk_size;
+  size_t m_bytes_allocated = 0;
+
+  static constexpr size_t kChunkAlignment = alignof(std::max_align_t);
+
+  void *allocate_from(size_t chunk, size_t offset, size_t bytes, size_t alignment) noexcept
+  {
+    void *ptr = m_chunks[chunk].data + offset;
+    size_t space = m_chunks[chunk].size - offset;
+    if (std::align(alignment, bytes, ptr, space) == nullptr) { return nullptr; }
+    m_current = chunk;
+    m_offset = m_chunks[chunk].size - space + bytes;
+    return ptr;
+  }
+
+public:
+  explicit ArenaResource(size_t initial_chunk_size = 64 * 1024,
+    std::pmr::memory_resource *upstream = std::pmr::get_default_resource())
+    : m_upstream(upstream), m_next_chunk_size(std::max<size_t>(initial_chunk_size, 64))
+  {}
+
+  ~ArenaResource() override { release(); }
+
+  ArenaResource(const ArenaResource &) = delete;
+  ArenaResource &operator=(const ArenaResource &) = delete;
+
+  /**
+   * @brief Makes every byte available again without returning chunks upstream.
+   * @note All memory handed out so far becomes invalid.
+   */
+  void reset() noexcept
+  {
+    m_current = 0;
+    m_offset = 0;
+    m_bytes_allocated = 0;
+  }
+
+  /**
+   * @brief Returns every chunk to the upstream resource.
+   */
+  void release() noexcept
+  {
+    for (auto &chunk : m_chunks) { m_upstream->deallocate(chunk.data, chunk.size, kChunkAlignment); }
+    m_chunks.clear();
+    reset();
+  }
+
+  size_t bytes_allocated() const noexcept { return m_bytes_allocated; }
+  size_t bytes_reserved() const noexcept
+  {
+    size_t total = 0;
+    for (const auto &chunk : m_chunks) { total += chunk.size; }
+    return total;
+  }
+  size_t chunk_count() const noexcept { return m_chunks.size(); }
+
+protected:
+  void *do_allocate(size_t bytes, size_t alignment) override
+  {
+    // Try the current chunk, then any chunk kept by a previous reset().
+    for (size_t chunk = m_current, offset = m_offset; chunk < m_chunks.size(); chunk++, offset = 0) {
+      if (void *ptr = allocate_from(chunk, offset, bytes, alignment)) {
+        m_bytes_allocated += bytes;
+        return ptr;
+      }
+    }
+
+    size_t size = std::max(m_next_chunk_size, bytes + alignment);
+    m_chunks.reserve(m_chunks.size() + 1);
+    auto *data = static_cast<std::byte *>(m_upstream->allocate(size, kChunkAlignment));
+    m_chunks.push_back({ data, size });
+    m_next_chunk_size = size * 2;
+    m_bytes_allocated += bytes;
+    return allocate_from(m_chunks.size() - 1, 0, bytes, alignment);
+  }
+
+  void do_deallocate(void * /*ptr*/, size_t /*bytes*/, size_t /*alignment*/) override {}
+
+  bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override { return this == &other; }
+};
+
+}// namespace memory
@@ -0,0 +1,299 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace memory {
+
+namespace detail {
+  inline std::atomic<uint64_t> g_next_pool_id{ 1 };
+}// namespace detail
+
+/**
+ * @brief Thread-safe fixed capacity object pool with per-thread magazine caches.
+ *
+ * Every thread that touches the pool gets a private magazine of free slots.
+ * construct/destroy only touch that magazine, so the common path takes no lock
+ * and performs no atomic read-modify-write. When a magazine runs dry it pulls a
+ * batch of MagazineSize slots from the shared depot; when it overflows it hands
+ * a batch back. The depot is protected by a mutex that is only taken once per
+ * MagazineSize operations.
+ *
+ * Objects may be destroyed on a different thread from the one that constructed
+ * them; the slot simply lands in the destroying thread's magazine.
+ *
+ * @note Slots cached in other threads' magazines are not visible to the calling
+ * thread, so construct() can throw std::bad_alloc before capacity() objects are
+ * live. Caches are flushed back to the depot when their thread exits.
+ * @note The pool must outlive every object constructed from it.
+ */
+template<typename T, size_t MagazineSize = 32> class ConcurrentObjectPool
+{
+  static_assert(MagazineSize > 0, "MagazineSize must be non-zero");
+
+  union Slot {
+    T object;
+    Slot *next;
+
+    Slot() {}// Don't initialize object
+    ~Slot() {}// Don't destroy object
+  };
+
+  // Thread private stack of free slots. Holds up to two batches so that a
+  // thread alternating construct/destroy at a batch boundary does not ping-pong
+  // with the depot.
+  struct Magazine
+  {
+    size_t count = 0;
+    Slot *slots[2 * MagazineSize];
+  };
+
+  // State shared between the pool and every thread cache that refers to it.
+  // Kept alive by shared ownership so a thread exiting after the pool is gone
+  // can still find out it must not touch the slots.
+  struct Depot
+  {
+    std::mutex mutex;
+    bool alive = true;
+    std::vector<Slot *> batches;// each a nullptr terminated chain of exactly MagazineSize slots
+    Slot *loose = nullptr;// odd slots returned outside of whole batches
+  };
+
+  struct ThreadCache
+  {
+    struct Entry
+    {
+      std::shared_ptr<Depot> depot;
+      std::unique_ptr<Magazine> magazine;
+    };
+
+    uint64_t last_pool_id = 0;
+    Magazine *last_magazine = nullptr;
+    std::unordered_map<uint64_t, Entry> entries;
+
+    ~ThreadCache()
+    {
+      for (auto &[id, entry] : entries) { release(*entry.depot, *entry.magazine, entry.magazine->count); }
+      entries.clear();
+      last_pool_id = 0;
+      thread_cache_destroyed() = true;
+    }
+  };
+
+  std::unique_ptr<Slot[]> m_pool;
+  size_t m_capacity = 0;
+  uint64_t m_id = 0;
+  std::shared_ptr<Depot> m_depot;
+
+  static ThreadCache &thread_cache() noexcept
+  {
+    thread_local ThreadCache cache;
+    return cache;
+  }
+
+  // Pools with static storage and thread_local destructors can outlive the
+  // cache; they must fall back to the depot instead of touching it.
+  static bool &thread_cache_destroyed() noexcept
+  {
+    thread_local bool destroyed = false;
+    return destroyed;
+  }
+
+  Magazine *local_magazine() noexcept;
+  Magazine *register_thread() noexcept;
+  void refill(Magazine &magazine);
+  static void release(Depot &depot, Magazine &magazine, size_t n) noexcept;
+
+  T *allocate_slot();
+  void deallocate_slot(T *ptr) noexcept;
+
+public:
+  using value_type = T;
+
+  explicit ConcurrentObjectPool(size_t size);
+  ~ConcurrentObjectPool() noexcept;
+
+  ConcurrentObjectPool(const ConcurrentObjectPool &) = delete;
+  ConcurrentObjectPool &operator=(const ConcurrentObjectPool &) = delete;
+  ConcurrentObjectPool(ConcurrentObjectPool &&) = delete;
+  ConcurrentObjectPool &operator=(ConcurrentObjectPool &&) = delete;
+
+  template<typename... Args> T *construct(Args &&...args);
+  void destroy(T *ptr) noexcept;
+
+  size_t capacity() const noexcept { return m_capacity; }
+};
+
+template<typename T, size_t MagazineSize>
+ConcurrentObjectPool<T, MagazineSize>::ConcurrentObjectPool(size_t size)
+  : m_pool(new Slot[size]), m_capacity(size), m_id(detail::g_next_pool_id.fetch_add(1, std::memory_order_relaxed)),
+    m_depot(std::make_shared<Depot>())
+{
+  // Whole batches can never outnumber this, so releasing to the depot never reallocates.
+  m_depot->batches.reserve(size / MagazineSize);
+  size_t whole = size - size % MagazineSize;
+  for (size_t i = whole; i < size; i++) {
+    m_pool[i].next = m_depot->loose;
+    m_depot->loose = &m_pool[i];
+  }
+  // Push the highest batch first so the first refill hands out the lowest addresses.
+  for (size_t begin = whole; begin > 0;) {
+    begin -= MagazineSize;
+    for (size_t i = begin; i < begin + MagazineSize - 1; i++) { m_pool[i].next = &m_pool[i + 1]; }
+    m_pool[begin + MagazineSize - 1].next = nullptr;
+    m_depot->batches.push_back(&m_pool[begin]);
+  }
+}
+
+template<typename T, size_t MagazineSize> ConcurrentObjectPool<T, MagazineSize>::~ConcurrentObjectPool() noexcept
+{
+  {
+    auto lock = std::lock_guard(m_depot->mutex);
+    m_depot->alive = false;
+  }
+  // Other threads drop their entry lazily; the destroying thread can do it now.
+  if (thread_cache_destroyed()) { return; }
+  auto &cache = thread_cache();
+  if (cache.last_pool_id == m_id) {
+    cache.last_pool_id = 0;
+    cache.last_magazine = nullptr;
+  }
+  cache.entries.erase(m_id);
+}
+
+template<typename T, size_t MagazineSize>
+auto ConcurrentObjectPool<T, MagazineSize>::local_magazine() noexcept -> Magazine *
+{
+  if (thread_cache_destroyed()) { return nullptr; }
+  auto &cache = thread_cache();
+  if (cache.last_pool_id == m_id) { return cache.last_magazine; }
+
+  auto iter = cache.entries.find(m_id);
+  if (iter == cache.entries.end()) { return register_thread(); }
+  cache.last_pool_id = m_id;
+  cache.last_magazine = iter->second.magazine.get();
+  return cache.last_magazine;
+}
+
+template<typename T, size_t MagazineSize>
+auto ConcurrentObjectPool<T, MagazineSize>::register_thread() noexcept -> Magazine *
+{
+  auto &cache = thread_cache();
+  try {
+    // Drop entries of pools that have since been destroyed.
+    std::erase_if(cache.entries, [](auto &kv) {
+      auto lock = std::lock_guard(kv.second.depot->mutex);
+      return !kv.second.depot->alive;
+    });
+    auto [iter, inserted] = cache.entries.emplace(m_id, typename ThreadCache::Entry{ m_depot, std::make_unique<Magazine>() });
+    cache.last_pool_id = m_id;
+    cache.last_magazine = iter->second.magazine.get();
+    return cache.last_magazine;
+  } catch (...) {
+    return nullptr;
+  }
+}
+
+template<typename T, size_t MagazineSize> void ConcurrentObjectPool<T, MagazineSize>::refill(Magazine &magazine)
+{
+  auto lock = std::lock_guard(m_depot->mutex);
+  if (!m_depot->batches.empty()) {
+    Slot *batch = m_depot->batches.back();
+    m_depot->batches.pop_back();
+    while (batch != nullptr) {
+      magazine.slots[magazine.count++] = batch;
+      batch = batch->next;
+    }
+    return;
+  }
+  while (m_depot->loose != nullptr && magazine.count < MagazineSize) {
+    magazine.slots[magazine.count++] = m_depot->loose;
+    m_depot->loose = m_depot->loose->next;
+  }
+  if (magazine.count == 0) { throw std::bad_alloc(); }
+}
+
+template<typename T, size_t MagazineSize>
+void ConcurrentObjectPool<T, MagazineSize>::release(Depot &depot, Magazine &magazine, size_t n) noexcept
+{
+  auto lock = std::lock_guard(depot.mutex);
+  if (!depot.alive) {
+    magazine.count = 0;
+    return;
+  }
+  for (; n >= MagazineSize; n -= MagazineSize) {
+    Slot *head = nullptr;
+    for (size_t i = 0; i < MagazineSize; i++) {
+      Slot *slot = magazine.slots[--magazine.count];
+      slot->next = head;
+      head = slot;
+    }
+    depot.batches.push_back(head);// within the capacity reserved at construction
+  }
+  for (; n > 0; n--) {
+    Slot *slot = magazine.slots[--magazine.count];
+    slot->next = depot.loose;
+    depot.loose = slot;
+  }
+}
+
+template<typename T, size_t MagazineSize> T *ConcurrentObjectPool<T, MagazineSize>::allocate_slot()
+{
+  Magazine *magazine = local_magazine();
+  if (magazine == nullptr) {
+    // No cache for this thread; take a single slot straight from the depot.
+    Magazine single;
+    refill(single);
+    Slot *slot = single.slots[--single.count];
+    release(*m_depot, single, single.count);
+    return &slot->object;
+  }
+  if (magazine->count == 0) { refill(*magazine); }
+  return &magazine->slots[--magazine->count]->object;
+}
+
+template<typename T, size_t MagazineSize>
+void ConcurrentObjectPool<T, MagazineSize>::deallocate_slot(T *ptr) noexcept
+{
+  Slot *used_slot = reinterpret_cast<Slot *>(ptr);
+  Magazine *magazine = local_magazine();
+  if (magazine == nullptr) {
+    // Could not set up a cache for this thread; hand the slot straight to the depot.
+    Magazine single;
+    single.slots[single.count++] = used_slot;
+    release(*m_depot, single, 1);
+    return;
+  }
+  if (magazine->count == 2 * MagazineSize) { release(*m_depot, *magazine, MagazineSize); }
+  magazine->slots[magazine->count++] = used_slot;
+}
+
+template<typename T, size_t MagazineSize>
+template<typename... Args>
+T *ConcurrentObjectPool<T, MagazineSize>::construct(Args &&...args)
+{
+  T *mem = allocate_slot();
+  try {
+    return new (mem) T(std::forward<Args>(args)...);
+  } catch (...) {
+    deallocate_slot(mem);
+    throw;
+  }
+}
+
+template<typename T, size_t MagazineSize> void ConcurrentObjectPool<T, MagazineSize>::destroy(T *obj) noexcept
+{
+  if (obj) {
+    obj->~T();
+    deallocate_slot(obj);
+  }
+}
+
+}// namespace memory
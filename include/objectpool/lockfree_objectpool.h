@@ -0,0 +1,137 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+namespace memory {
+
+/**
+ * @brief Lock-free fixed capacity object pool built on a Treiber stack.
+ *
+ * Any thread may construct or destroy at any time; objects are routinely freed
+ * on a different thread from the one that allocated them. The free-list head is
+ * a single 64-bit word holding a 32-bit slot index and a 32-bit generation tag.
+ * Every successful update bumps the tag, so a pop that raced with a pop/push
+ * pair returning the same slot (the ABA problem) fails its CAS instead of
+ * installing a stale next link. Using indices instead of pointers keeps the
+ * tagged head at 64 bits, so no 128-bit CAS is needed on any platform.
+ *
+ * Next links live in a separate array of atomics rather than inside the slot:
+ * a popping thread may read the link of a slot that another thread has just
+ * taken and is constructing into, which would otherwise be a data race on T.
+ *
+ * @note Capacity is limited to 2^32 - 1 slots.
+ * @note The pool must outlive every object constructed from it.
+ */
+template<typename T> class LockFreeObjectPool
+{
+  union Slot {
+    T object;
+
+    Slot() {}// Don't initialize object
+    ~Slot() {}// Don't destroy object
+  };
+
+  static constexpr uint32_t kNil = std::numeric_limits<uint32_t>::max();
+
+  static constexpr uint64_t pack(uint32_t index, uint32_t tag) noexcept
+  {
+    return (static_cast<uint64_t>(tag) << 32) | index;
+  }
+  static constexpr uint32_t index_of(uint64_t head) noexcept { return static_cast<uint32_t>(head); }
+  static constexpr uint32_t tag_of(uint64_t head) noexcept { return static_cast<uint32_t>(head >> 32); }
+
+  static size_t checked_size(size_t size)
+  {
+    if (size == 0 || size >= kNil) { throw std::invalid_argument("LockFreeObjectPool size out of range"); }
+    return size;
+  }
+
+  std::unique_ptr<Slot[]> m_pool;
+  std::unique_ptr<std::atomic<uint32_t>[]> m_next;
+  size_t m_capacity = 0;
+  alignas(64) std::atomic<uint64_t> m_head;// own cache line, away from the read-mostly members
+
+  static_assert(std::atomic<uint64_t>::is_always_lock_free, "LockFreeObjectPool needs a lock-free 64-bit atomic");
+
+  T *allocate_slot();
+  void deallocate_slot(T *ptr) noexcept;
+
+public:
+  using value_type = T;
+
+  explicit LockFreeObjectPool(size_t size);
+  ~LockFreeObjectPool() noexcept = default;
+
+  LockFreeObjectPool(const LockFreeObjectPool &) = delete;
+  LockFreeObjectPool &operator=(const LockFreeObjectPool &) = delete;
+  LockFreeObjectPool(LockFreeObjectPool &&) = delete;
+  LockFreeObjectPool &operator=(LockFreeObjectPool &&) = delete;
+
+  template<typename... Args> T *construct(Args &&...args);
+  void destroy(T *ptr) noexcept;
+
+  size_t capacity() const noexcept { return m_capacity; }
+};
+
+template<typename T>
+LockFreeObjectPool<T>::LockFreeObjectPool(size_t size)
+  : m_pool(new Slot[checked_size(size)]), m_next(new std::atomic<uint32_t>[size]), m_capacity(size),
+    m_head(pack(kNil, 0))
+{
+  for (size_t i = 0; i < size - 1; i++) { m_next[i].store(static_cast<uint32_t>(i + 1), std::memory_order_relaxed); }
+  m_next[size - 1].store(kNil, std::memory_order_relaxed);
+  m_head.store(pack(0, 0), std::memory_order_release);
+}
+
+template<typename T> T *LockFreeObjectPool<T>::allocate_slot()
+{
+  uint64_t head = m_head.load(std::memory_order_acquire);
+  while (true) {
+    uint32_t index = index_of(head);
+    if (index == kNil) { throw std::bad_alloc(); }
+    // May read a link that is concurrently being rewritten; the tag makes the
+    // CAS below fail in that case, so the value is never used.
+    uint32_t next = m_next[index].load(std::memory_order_relaxed);
+    if (m_head.compare_exchange_weak(
+          head, pack(next, tag_of(head) + 1), std::memory_order_acquire, std::memory_order_acquire)) {
+      return &m_pool[index].object;
+    }
+  }
+}
+
+template<typename T> void LockFreeObjectPool<T>::deallocate_slot(T *ptr) noexcept
+{
+  auto index = static_cast<uint32_t>(reinterpret_cast<Slot *>(ptr) - m_pool.get());
+  uint64_t head = m_head.load(std::memory_order_relaxed);
+  do {
+    m_next[index].store(index_of(head), std::memory_order_relaxed);
+  } while (!m_head.compare_exchange_weak(
+    head, pack(index, tag_of(head) + 1), std::memory_order_release, std::memory_order_relaxed));
+}
+
+template<typename T> template<typename... Args> T *LockFreeObjectPool<T>::construct(Args &&...args)
+{
+  T *mem = allocate_slot();
+  try {
+    return new (mem) T(std::forward<Args>(args)...);
+  } catch (...) {
+    deallocate_slot(mem);
+    throw;
+  }
+}
+
+template<typename T> void LockFreeObjectPool<T>::destroy(T *obj) noexcept
+{
+  if (obj) {
+    obj->~T();
+    deallocate_slot(obj);
+  }
+}
+
+}// namespace memory
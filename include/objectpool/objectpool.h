@@ -1,31 +1,75 @@
 #pragma once
+#include "objectpool/page_memory.h"
+#include <algorithm>
 #include <cstddef>
+#include <memory>
 #include <stdexcept>
 #include <new>
 #include <utility>
+#include <vector>
 
 namespace memory {
+
+/**
+ * @brief Controls what an ObjectPool does once every slot is in use.
+ *
+ * fixed:     throw std::bad_alloc (the original behaviour).
+ * linear:    chain another chunk the size of the initial one.
+ * geometric: chain a chunk as large as the current capacity, doubling it.
+ *
+ * max_capacity caps the total number of slots across all chunks, 0 means
+ * unbounded. Growth stops with std::bad_alloc once the cap is reached; the last
+ * chunk is clamped so the cap is hit exactly.
+ */
+struct GrowthPolicy
+{
+  enum class Kind { fixed, linear, geometric };
+
+  Kind kind = Kind::fixed;
+  size_t max_capacity = 0;
+};
+
 template<typename T> class ObjectPool
 {
   union Slot {
     T object;
     Slot *next;
-    
+
     Slot() {} // Don't initialize object
     ~Slot() {} // Don't destroy object
   };
 
-  Slot *m_pool = nullptr;
+  struct Chunk
+  {
+    PageRegion memory;
+    Slot *slots = nullptr;
+    size_t size = 0;
+  };
+
+  // m_chunks[0] is the initial allocation and is never trimmed.
+  std::vector<Chunk> m_chunks;
   Slot *m_free_list_head = nullptr;
+  GrowthPolicy m_growth;
+  PageOptions m_pages;
+  size_t m_capacity = 0;
+  size_t m_in_use = 0;
 
   T *allocate_slot();
   void deallocate_slot(T *ptr) noexcept;
+  void add_chunk(size_t size);
+  void grow();
 
 public:
-  explicit ObjectPool(size_t size);
-  ~ObjectPool() noexcept;
-  ObjectPool(ObjectPool&&) noexcept = default;
-  ObjectPool& operator=(ObjectPool&&) noexcept = default;
+  using value_type = T;
+
+  /**
+   * @param pages Where chunk memory comes from; see PageOptions. Grown chunks
+   * use the same options as the initial one.
+   */
+  explicit ObjectPool(size_t size, GrowthPolicy growth = {}, PageOptions pages = {});
+  ~ObjectPool() noexcept = default;
+  ObjectPool(ObjectPool &&other) noexcept;
+  ObjectPool &operator=(ObjectPool &&other) noexcept;
 
   ObjectPool(const ObjectPool &) = delete;
   ObjectPool &operator=(const ObjectPool &) = delete;
@@ -33,51 +77,198 @@ public:
   template <typename... Args>
   T* construct(Args&&... args);
   void destroy(T* ptr) noexcept;
+
+  /**
+   * @brief Releases every grown chunk whose slots are all free.
+   *
+   * construct/destroy stay O(1) because they never track which chunk a slot
+   * belongs to; trim() pays for that instead with a walk over the free list.
+   * The initial chunk is always kept.
+   *
+   * @return The number of slots given back to the system.
+   */
+  size_t trim();
+
+  size_t capacity() const noexcept { return m_capacity; }
+  size_t in_use() const noexcept { return m_in_use; }
+  size_t chunk_count() const noexcept { return m_chunks.size(); }
+
+  /**
+   * @brief How the initial chunk is backed, e.g. whether huge pages were obtained.
+   */
+  PageRegion::Backing backing() const noexcept
+  {
+    return m_chunks.empty() ? PageRegion::Backing::heap : m_chunks.front().memory.backing();
+  }
 };
 
-template<typename T> 
-ObjectPool<T>::ObjectPool(size_t size) : m_pool(new Slot[size])
+template<typename T>
+ObjectPool<T>::ObjectPool(size_t size, GrowthPolicy growth, PageOptions pages) : m_growth(growth), m_pages(pages)
+{
+  if (size == 0) { throw std::invalid_argument("ObjectPool size must be non-zero"); }
+  if (m_growth.max_capacity != 0 && m_growth.max_capacity < size) { m_growth.max_capacity = size; }
+  add_chunk(size);
+}
+
+template<typename T>
+ObjectPool<T>::ObjectPool(ObjectPool &&other) noexcept
+  : m_chunks(std::move(other.m_chunks)), m_free_list_head(std::exchange(other.m_free_list_head, nullptr)),
+    m_growth(other.m_growth), m_pages(other.m_pages), m_capacity(std::exchange(other.m_capacity, 0)),
+    m_in_use(std::exchange(other.m_in_use, 0))
+{}
+
+template<typename T>
+ObjectPool<T> &ObjectPool<T>::operator=(ObjectPool &&other) noexcept
 {
-  for (size_t i = 0; i < size - 1; i++) { 
-    m_pool[i].next = &m_pool[i + 1]; 
+  if (this != &other) {
+    m_chunks = std::move(other.m_chunks);
+    m_free_list_head = std::exchange(other.m_free_list_head, nullptr);
+    m_growth = other.m_growth;
+    m_pages = other.m_pages;
+    m_capacity = std::exchange(other.m_capacity, 0);
+    m_in_use = std::exchange(other.m_in_use, 0);
   }
-  m_pool[size - 1].next = nullptr;
-  m_free_list_head = &m_pool[0];
+  return *this;
 }
 
-template<typename T> 
-ObjectPool<T>::~ObjectPool() noexcept { 
-  delete[] m_pool; 
+template<typename T>
+void ObjectPool<T>::add_chunk(size_t size)
+{
+  m_chunks.reserve(m_chunks.size() + 1);
+  Chunk chunk{ PageRegion(sizeof(Slot) * size, alignof(Slot), m_pages), nullptr, size };
+  Slot *slots = static_cast<Slot *>(chunk.memory.data());
+  std::uninitialized_default_construct_n(slots, size);// Slot() is empty, this only starts the slots' lifetimes
+  chunk.slots = slots;
+  for (size_t i = 0; i < size - 1; i++) {
+    slots[i].next = &slots[i + 1];
+  }
+  slots[size - 1].next = m_free_list_head;
+  m_free_list_head = &slots[0];
+  m_chunks.push_back(std::move(chunk));
+  m_capacity += size;
 }
 
-template<typename T> 
+template<typename T>
+void ObjectPool<T>::grow()
+{
+  if (m_chunks.empty()) { throw std::bad_alloc(); }// moved-from pool
+  size_t size = 0;
+  switch (m_growth.kind) {
+  case GrowthPolicy::Kind::fixed:
+    throw std::bad_alloc();
+  case GrowthPolicy::Kind::linear:
+    size = m_chunks.front().size;
+    break;
+  case GrowthPolicy::Kind::geometric:
+    size = m_capacity;
+    break;
+  }
+  if (m_growth.max_capacity != 0) {
+    if (m_capacity >= m_growth.max_capacity) { throw std::bad_alloc(); }
+    size = std::min(size, m_growth.max_capacity - m_capacity);
+  }
+  add_chunk(size);
+}
+
+template<typename T>
 T *ObjectPool<T>::allocate_slot()
 {
-  if (m_free_list_head == nullptr) { 
-    throw std::bad_alloc(); 
+  if (m_free_list_head == nullptr) {
+    grow();
   }
   Slot *head = m_free_list_head;
   m_free_list_head = head->next;
+  ++m_in_use;
   return &head->object;
 }
 
-template<typename T> 
+template<typename T>
 void ObjectPool<T>::deallocate_slot(T *ptr) noexcept
 {
   Slot *used_slot = reinterpret_cast<Slot *>(ptr);
   used_slot->next = m_free_list_head;
   m_free_list_head = used_slot;
+  --m_in_use;
+}
+
+template<typename T>
+size_t ObjectPool<T>::trim()
+{
+  if (m_chunks.size() <= 1) { return 0; }
+
+  // Grown chunks ordered by address, so a free slot can be mapped to its chunk
+  // with a binary search.
+  struct Range
+  {
+    Slot *begin;
+    Slot *end;
+    size_t chunk;
+    size_t free;
+  };
+  std::vector<Range> ranges;
+  ranges.reserve(m_chunks.size() - 1);
+  for (size_t i = 1; i < m_chunks.size(); i++) {
+    Slot *begin = m_chunks[i].slots;
+    ranges.push_back({ begin, begin + m_chunks[i].size, i, 0 });
+  }
+  std::sort(ranges.begin(), ranges.end(), [](const Range &a, const Range &b) { return a.begin < b.begin; });
+
+  auto find_range = [&ranges](Slot *slot) -> Range * {
+    auto iter = std::upper_bound(
+      ranges.begin(), ranges.end(), slot, [](Slot *ptr, const Range &range) { return ptr < range.begin; });
+    if (iter == ranges.begin()) { return nullptr; }
+    --iter;
+    return (slot < iter->end) ? &*iter : nullptr;
+  };
+
+  for (Slot *slot = m_free_list_head; slot != nullptr; slot = slot->next) {
+    if (Range *range = find_range(slot)) { ++range->free; }
+  }
+
+  std::vector<bool> release(m_chunks.size(), false);
+  size_t released = 0;
+  for (auto &range : ranges) {
+    if (range.free == m_chunks[range.chunk].size) {
+      release[range.chunk] = true;
+      released += range.free;
+    }
+  }
+  if (released == 0) { return 0; }
+
+  // Unlink every slot that lives in a chunk about to be released.
+  Slot **link = &m_free_list_head;
+  while (*link != nullptr) {
+    Range *range = find_range(*link);
+    if (range != nullptr && release[range->chunk]) {
+      *link = (*link)->next;
+    } else {
+      link = &(*link)->next;
+    }
+  }
+
+  size_t kept = 0;
+  for (size_t i = 0; i < m_chunks.size(); i++) {
+    if (!release[i]) { m_chunks[kept++] = std::move(m_chunks[i]); }
+  }
+  m_chunks.resize(kept);
+  m_capacity -= released;
+  return released;
 }
 
-template<typename T> 
-template<typename... Args> 
+template<typename T>
+template<typename... Args>
 T *ObjectPool<T>::construct(Args &&...args)
 {
   T *mem = allocate_slot();
-  return new (mem) T(std::forward<Args>(args)...);
+  try {
+    return new (mem) T(std::forward<Args>(args)...);
+  } catch (...) {
+    deallocate_slot(mem);
+    throw;
+  }
 }
 
-template<typename T> 
+template<typename T>
 void ObjectPool<T>::destroy(T *obj) noexcept
 {
   if (obj) {
@@ -86,4 +277,4 @@ void ObjectPool<T>::destroy(T *obj) noexcept
   }
 }
 
-}// namespace memory
\ No newline at end of file
+}// namespace memory
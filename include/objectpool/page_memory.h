@@ -0,0 +1,211 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace memory {
+
+/**
+ * @brief Where an ObjectPool gets the memory for its chunks.
+ *
+ * huge_pages:
+ *   none:        regular pages.
+ *   transparent: 2 MiB aligned anonymous mapping with MADV_HUGEPAGE, so the
+ *                kernel can back it with transparent huge pages.
+ *   explicit_:   MAP_HUGETLB from the reserved huge page pool, falling back to
+ *                transparent when none are reserved.
+ *
+ * numa_node binds the memory to one node (mbind MPOL_BIND), -1 leaves the
+ * placement to the first-touch policy. Binding is best effort: on kernels or
+ * containers that refuse it the memory is used unbound.
+ *
+ * prefault touches every page at construction, after binding, so the cost of
+ * first touch is paid up front instead of on the allocation fast path.
+ * ObjectPool writes every slot while linking its free list, so its chunks are
+ * faulted in at construction either way; the flag is for other PageRegion users.
+ *
+ * With every option at its default the memory comes from operator new, exactly
+ * as before. On platforms without mmap the options are ignored.
+ */
+struct PageOptions
+{
+  enum class HugePages { none, transparent, explicit_ };
+
+  HugePages huge_pages = HugePages::none;
+  int numa_node = -1;
+  bool prefault = false;
+
+  bool is_default() const noexcept { return huge_pages == HugePages::none && numa_node < 0 && !prefault; }
+};
+
+/**
+ * @brief Owning handle to a block of memory obtained according to PageOptions.
+ */
+class PageRegion
+{
+public:
+  enum class Backing { heap, pages, transparent_huge_pages, huge_pages };
+
+  static constexpr size_t kHugePageSize = size_t{ 2 } << 20;
+
+  PageRegion() = default;
+  PageRegion(size_t bytes, size_t alignment, const PageOptions &options);
+  ~PageRegion() noexcept { release(); }
+
+  PageRegion(PageRegion &&other) noexcept
+    : m_data(std::exchange(other.m_data, nullptr)), m_length(std::exchange(other.m_length, 0)),
+      m_alignment(other.m_alignment), m_backing(other.m_backing), m_node(std::exchange(other.m_node, -1))
+  {}
+  PageRegion &operator=(PageRegion &&other) noexcept
+  {
+    if (this != &other) {
+      release();
+      m_data = std::exchange(other.m_data, nullptr);
+      m_length = std::exchange(other.m_length, 0);
+      m_alignment = other.m_alignment;
+      m_backing = other.m_backing;
+      m_node = std::exchange(other.m_node, -1);
+    }
+    return *this;
+  }
+
+  PageRegion(const PageRegion &) = delete;
+  PageRegion &operator=(const PageRegion &) = delete;
+
+  void *data() const noexcept { return m_data; }
+  Backing backing() const noexcept { return m_backing; }
+
+  /**
+   * @brief The node the memory was bound to, -1 when it is not bound.
+   */
+  int numa_node() const noexcept { return m_node; }
+
+private:
+  void *m_data = nullptr;
+  size_t m_length = 0;// bytes mapped, or requested for heap memory
+  size_t m_alignment = 0;
+  Backing m_backing = Backing::heap;
+  int m_node = -1;
+
+  void release() noexcept;
+
+#if defined(__linux__)
+  static size_t round_up(size_t value, size_t to) noexcept { return (value + to - 1) / to * to; }
+  void map(size_t bytes, PageOptions::HugePages huge_pages);
+  void bind(int node) noexcept;
+  void prefault() noexcept;
+#endif
+};
+
+inline PageRegion::PageRegion(size_t bytes, size_t alignment, const PageOptions &options)
+  : m_length(bytes), m_alignment(alignment)
+{
+#if defined(__linux__)
+  if (!options.is_default()) {
+    map(bytes, options.huge_pages);
+    if (options.numa_node >= 0) { bind(options.numa_node); }
+    if (options.prefault) { prefault(); }
+    return;
+  }
+#else
+  (void)options;
+#endif
+  m_data = ::operator new(bytes, std::align_val_t{ alignment });
+}
+
+inline void PageRegion::release() noexcept
+{
+  if (m_data == nullptr) { return; }
+#if defined(__linux__)
+  if (m_backing != Backing::heap) {
+    ::munmap(m_data, m_length);
+    m_data = nullptr;
+    return;
+  }
+#endif
+  ::operator delete(m_data, std::align_val_t{ m_alignment });
+  m_data = nullptr;
+}
+
+#if defined(__linux__)
+inline void PageRegion::map(size_t bytes, PageOptions::HugePages huge_pages)
+{
+  constexpr int kProtection = PROT_READ | PROT_WRITE;
+  constexpr int kFlags = MAP_PRIVATE | MAP_ANONYMOUS;
+
+#if defined(MAP_HUGETLB)
+  if (huge_pages == PageOptions::HugePages::explicit_) {
+    size_t length = round_up(bytes, kHugePageSize);
+    void *ptr = ::mmap(nullptr, length, kProtection, kFlags | MAP_HUGETLB, -1, 0);
+    if (ptr != MAP_FAILED) {
+      m_data = ptr;
+      m_length = length;
+      m_backing = Backing::huge_pages;
+      return;
+    }
+  }
+#endif
+  if (huge_pages == PageOptions::HugePages::explicit_) {
+    huge_pages = PageOptions::HugePages::transparent;// no reserved huge pages
+  }
+
+  if (huge_pages == PageOptions::HugePages::transparent) {
+    // Over-allocate so a 2 MiB aligned range can be cut out; THP only backs
+    // aligned huge-page sized extents.
+    size_t length = round_up(bytes, kHugePageSize);
+    void *ptr = ::mmap(nullptr, length + kHugePageSize, kProtection, kFlags, -1, 0);
+    if (ptr == MAP_FAILED) { throw std::bad_alloc(); }
+    auto base = reinterpret_cast<uintptr_t>(ptr);
+    uintptr_t aligned = round_up(base, kHugePageSize);
+    if (aligned != base) { ::munmap(ptr, aligned - base); }
+    size_t tail = kHugePageSize - (aligned - base);
+    if (tail != 0) { ::munmap(reinterpret_cast<void *>(aligned + length), tail); }
+    m_data = reinterpret_cast<void *>(aligned);
+    m_length = length;
+    m_backing = Backing::transparent_huge_pages;
+#if defined(MADV_HUGEPAGE)
+    ::madvise(m_data, m_length, MADV_HUGEPAGE);// advisory, THP may be disabled
+#endif
+    return;
+  }
+
+  size_t length = round_up(bytes, static_cast<size_t>(::sysconf(_SC_PAGESIZE)));
+  void *ptr = ::mmap(nullptr, length, kProtection, kFlags, -1, 0);
+  if (ptr == MAP_FAILED) { throw std::bad_alloc(); }
+  m_data = ptr;
+  m_length = length;
+  m_backing = Backing::pages;
+}
+
+inline void PageRegion::bind(int node) noexcept
+{
+#if defined(SYS_mbind)
+  constexpr int kMpolBind = 2;// MPOL_BIND from <linux/mempolicy.h>
+  constexpr size_t kBitsPerWord = 8 * sizeof(unsigned long);
+  constexpr size_t kMaxNodes = 1024;
+  if (static_cast<size_t>(node) >= kMaxNodes) { return; }
+  unsigned long mask[kMaxNodes / kBitsPerWord] = {};
+  mask[static_cast<size_t>(node) / kBitsPerWord] = 1UL << (static_cast<size_t>(node) % kBitsPerWord);
+  if (::syscall(SYS_mbind, m_data, m_length, kMpolBind, mask, kMaxNodes, 0) == 0) { m_node = node; }
+#else
+  (void)node;
+#endif
+}
+
+inline void PageRegion::prefault() noexcept
+{
+  // One write per base page; with huge pages only the first write to each faults.
+  auto page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+  auto *bytes = static_cast<volatile unsigned char *>(m_data);
+  for (size_t offset = 0; offset < m_length; offset += page) { bytes[offset] = 0; }
+}
+#endif
+
+}// namespace memory
@@ -0,0 +1,75 @@
+#pragma once
+#include "objectpool/objectpool.h"
+#include <cstddef>
+#include <memory_resource>
+
+namespace memory {
+
+/**
+ * @brief std::pmr::memory_resource that serves fixed-size blocks from an ObjectPool.
+ *
+ * Every request that fits in BlockSize bytes with at most BlockAlign alignment
+ * is carved from a growable ObjectPool, so node based containers (std::pmr::map,
+ * std::pmr::list, the block buffers of std::pmr::deque) stop hitting malloc once
+ * the pool has grown to their working set. Larger or over-aligned requests are
+ * forwarded to the upstream resource.
+ *
+ * @note Not thread-safe, like the ObjectPool underneath it.
+ */
+template<size_t BlockSize, size_t BlockAlign = alignof(std::max_align_t)>
+class ObjectPoolResource : public std::pmr::memory_resource
+{
+  struct alignas(BlockAlign) Block
+  {
+    std::byte bytes[BlockSize];
+
+    Block() {}// Leave the bytes uninitialized
+  };
+
+  ObjectPool<Block> m_pool;
+  std::pmr::memory_resource *m_upstream;
+
+  static constexpr bool fits(size_t bytes, size_t alignment) noexcept
+  {
+    return bytes <= BlockSize && alignment <= BlockAlign;
+  }
+
+public:
+  explicit ObjectPoolResource(size_t initial_blocks,
+    GrowthPolicy growth = { GrowthPolicy::Kind::geometric, 0 },
+    std::pmr::memory_resource *upstream = std::pmr::get_default_resource())
+    : m_pool(initial_blocks, growth), m_upstream(upstream)
+  {}
+
+  ObjectPoolResource(const ObjectPoolResource &) = delete;
+  ObjectPoolResource &operator=(const ObjectPoolResource &) = delete;
+
+  /**
+   * @brief Returns grown chunks that no longer hold any block, see ObjectPool::trim().
+   */
+  size_t trim() { return m_pool.trim(); }
+
+  size_t blocks_in_use() const noexcept { return m_pool.in_use(); }
+  size_t block_capacity() const noexcept { return m_pool.capacity(); }
+  std::pmr::memory_resource *upstream_resource() const noexcept { return m_upstream; }
+
+protected:
+  void *do_allocate(size_t bytes, size_t alignment) override
+  {
+    if (fits(bytes, alignment)) { return m_pool.construct(); }
+    return m_upstream->allocate(bytes, alignment);
+  }
+
+  void do_deallocate(void *ptr, size_t bytes, size_t alignment) override
+  {
+    if (fits(bytes, alignment)) {
+      m_pool.destroy(static_cast<Block *>(ptr));
+      return;
+    }
+    m_upstream->deallocate(ptr, bytes, alignment);
+  }
+
+  bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override { return this == &other; }
+};
+
+}// namespace memory
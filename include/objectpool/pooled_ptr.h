@@ -0,0 +1,67 @@
+#pragma once
+#include <memory>
+#include <utility>
+
+namespace memory {
+
+/**
+ * @brief unique_ptr deleter that hands the object back to the pool it came from.
+ *
+ * The pool type is erased behind a function pointer so that a single
+ * pooled_ptr<T> can carry objects from ObjectPool, ConcurrentObjectPool or
+ * LockFreeObjectPool, and so that non-template code such as MessageQueue can
+ * store them. A default constructed deleter falls back to plain delete, which
+ * lets an ordinary std::unique_ptr<T> convert into a pooled_ptr<T>.
+ *
+ * @note destroy() runs on whichever thread releases the pointer. Objects from
+ * the single threaded ObjectPool must therefore be released on the thread that
+ * owns the pool; use ConcurrentObjectPool or LockFreeObjectPool for objects
+ * that cross threads.
+ */
+template<typename T> class PoolDeleter
+{
+  void *m_pool = nullptr;
+  void (*m_destroy)(void *, T *) noexcept = nullptr;
+
+  template<typename Pool> static void destroy_in(void *pool, T *ptr) noexcept
+  {
+    static_cast<Pool *>(pool)->destroy(ptr);
+  }
+
+public:
+  constexpr PoolDeleter() noexcept = default;
+  // Implicit so that a std::unique_ptr<T> converts into a pooled_ptr<T>.
+  constexpr PoolDeleter(std::default_delete<T> /*unused*/) noexcept {}
+
+  template<typename Pool>
+  explicit PoolDeleter(Pool &pool) noexcept : m_pool(&pool), m_destroy(&destroy_in<Pool>)
+  {}
+
+  void operator()(T *ptr) const noexcept
+  {
+    if (m_destroy != nullptr) {
+      m_destroy(m_pool, ptr);
+    } else {
+      delete ptr;
+    }
+  }
+
+  /**
+   * @brief The pool the object is returned to, nullptr for heap allocated objects.
+   */
+  void *pool() const noexcept { return m_pool; }
+};
+
+template<typename T> using pooled_ptr = std::unique_ptr<T, PoolDeleter<T>>;
+
+/**
+ * @brief Constructs an object in @p pool and wraps it in a pooled_ptr.
+ * @note The pool must outlive the returned pointer.
+ */
+template<typename Pool, typename... Args> auto make_pooled(Pool &pool, Args &&...args)
+{
+  using T = typename Pool::value_type;
+  return pooled_ptr<T>(pool.construct(std::forward<Args>(args)...), PoolDeleter<T>(pool));
+}
+
+}// namespace memory
@@ -0,0 +1,553 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <new>
+#include <span>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace memory {
+
+/**
+ * @brief Size-class slab allocator for variable-length byte payloads.
+ *
+ * Requests are rounded up to the nearest size class. Every class owns a list of
+ * slabs carved into equal blocks and threads its free blocks through an
+ * intrusive free list, exactly like ObjectPool does for a single T. Classes grow
+ * one slab at a time and never shrink; requests larger than the biggest class
+ * go to the global heap and are counted separately.
+ *
+ * Size classes are rounded up to multiples of 16 bytes, so every block is
+ * aligned to at least 16. The default classes are powers of two from 16 bytes
+ * to 4 KiB; callers with clustered payload sizes should pass tuned classes that
+ * sit just above their common sizes.
+ *
+ * Like ConcurrentObjectPool, every thread keeps a private free list per size
+ * class and trades blocks with the shared class in batches, so producer threads
+ * allocate and free without taking a lock. Usage counters are kept per thread
+ * with relaxed single-writer stores and are summed by stats().
+ */
+class SlabAllocator : public std::pmr::memory_resource
+{
+public:
+  struct ClassStats
+  {
+    size_t block_size = 0;
+    size_t slab_count = 0;
+    size_t blocks_total = 0;
+    size_t blocks_in_use = 0;
+    size_t bytes_requested = 0;// by the callers currently holding blocks
+
+    /** Fraction of the handed-out block bytes the callers asked for. */
+    double utilization() const noexcept
+    {
+      return blocks_in_use == 0 ? 1.0
+                                : static_cast<double>(bytes_requested) / static_cast<double>(blocks_in_use * block_size);
+    }
+  };
+
+  struct Stats
+  {
+    std::vector<ClassStats> classes;
+    size_t oversize_in_use = 0;
+    size_t oversize_bytes = 0;
+
+    /** Bytes lost to rounding requests up to their size class. */
+    size_t internal_fragmentation() const noexcept
+    {
+      size_t waste = 0;
+      for (const auto &c : classes) { waste += c.blocks_in_use * c.block_size - c.bytes_requested; }
+      return waste;
+    }
+    /** Bytes sitting in free blocks of slabs that have already been allocated. */
+    size_t free_slab_bytes() const noexcept
+    {
+      size_t free = 0;
+      for (const auto &c : classes) { free += (c.blocks_total - c.blocks_in_use) * c.block_size; }
+      return free;
+    }
+  };
+
+  static std::vector<size_t> power_of_two_classes(size_t smallest = 16, size_t largest = 4096)
+  {
+    std::vector<size_t> classes;
+    for (size_t size = smallest; size <= largest; size *= 2) { classes.push_back(size); }
+    return classes;
+  }
+
+  explicit SlabAllocator(std::vector<size_t> size_classes = power_of_two_classes(), size_t slab_bytes = 64 * 1024);
+  ~SlabAllocator() override;
+
+  SlabAllocator(const SlabAllocator &) = delete;
+  SlabAllocator &operator=(const SlabAllocator &) = delete;
+
+  /**
+   * @brief Usable size of a block handed out for a request of @p bytes.
+   */
+  size_t good_size(size_t bytes) const noexcept
+  {
+    size_t index = class_index(bytes);
+    return index == kOversize ? bytes : m_classes[index]->block_size;
+  }
+
+  size_t max_class_size() const noexcept { return m_classes.back()->block_size; }
+
+  Stats stats() const;
+
+protected:
+  void *do_allocate(size_t bytes, size_t alignment) override;
+  void do_deallocate(void *ptr, size_t bytes, size_t alignment) override;
+  bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override { return this == &other; }
+
+private:
+  static constexpr size_t kGranularity = 16;
+  static constexpr size_t kOversize = static_cast<size_t>(-1);
+
+  struct FreeBlock
+  {
+    FreeBlock *next;
+  };
+
+  struct SizeClass
+  {
+    explicit SizeClass(size_t size)
+      : block_size(size), batch(std::clamp<size_t>(8 * 1024 / size, 4, 64))
+    {}
+
+    std::mutex mutex;
+    size_t block_size;
+    size_t batch;// blocks moved per exchange with a thread cache
+    FreeBlock *free_list = nullptr;
+    std::vector<std::unique_ptr<std::byte[]>> slabs;
+    size_t blocks_total = 0;
+  };
+
+  // Per thread, per class state. The counters are only written by the owning
+  // thread and may go negative when another thread frees its blocks; the sum
+  // over all threads is exact.
+  struct LocalClass
+  {
+    FreeBlock *head = nullptr;
+    size_t count = 0;
+    std::atomic<int64_t> in_use{ 0 };
+    std::atomic<int64_t> bytes{ 0 };
+
+    void add(int64_t blocks, int64_t requested) noexcept
+    {
+      in_use.store(in_use.load(std::memory_order_relaxed) + blocks, std::memory_order_relaxed);
+      bytes.store(bytes.load(std::memory_order_relaxed) + requested, std::memory_order_relaxed);
+    }
+  };
+
+  struct LocalCache
+  {
+    explicit LocalCache(size_t classes) : per_class(std::make_unique<LocalClass[]>(classes)) {}
+    std::unique_ptr<LocalClass[]> per_class;
+  };
+
+  // Outlives the allocator while any thread still holds a cache for it, so
+  // a thread that exits after the allocator never touches the allocator.
+  struct Registry
+  {
+    std::mutex mutex;
+    bool alive = true;
+    std::vector<SizeClass *> classes;// the allocator's, valid while alive
+    std::vector<LocalCache *> caches;
+    std::vector<int64_t> retired_in_use;// folded in from threads that exited
+    std::vector<int64_t> retired_bytes;
+  };
+
+  struct ThreadCache
+  {
+    struct Entry
+    {
+      std::shared_ptr<Registry> registry;
+      std::unique_ptr<LocalCache> cache;
+    };
+
+    std::unordered_map<uint64_t, Entry> entries;
+
+    ~ThreadCache()
+    {
+      for (auto &[id, entry] : entries) { retire(*entry.registry, *entry.cache); }
+      entries.clear();
+      tl_last_id = 0;
+      thread_cache_destroyed() = true;
+    }
+  };
+
+  // Fast path lookup of the last used cache. Kept outside ThreadCache because
+  // trivially destructible thread_locals need no initialization guard.
+  static inline thread_local uint64_t tl_last_id = 0;
+  static inline thread_local LocalCache *tl_last_cache = nullptr;
+
+  std::vector<std::unique_ptr<SizeClass>> m_classes;
+  std::vector<uint8_t> m_lookup;// class index by (bytes - 1) / kGranularity
+  size_t m_slab_bytes;
+  uint64_t m_id;
+  std::shared_ptr<Registry> m_registry;
+  std::atomic<int64_t> m_oversize_in_use{ 0 };
+  std::atomic<int64_t> m_oversize_bytes{ 0 };
+
+  static ThreadCache &thread_cache() noexcept
+  {
+    thread_local ThreadCache cache;
+    return cache;
+  }
+
+  static bool &thread_cache_destroyed() noexcept
+  {
+    thread_local bool destroyed = false;
+    return destroyed;
+  }
+
+  static uint64_t next_id() noexcept
+  {
+    static std::atomic<uint64_t> id{ 1 };
+    return id.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  size_t class_index(size_t bytes) const noexcept
+  {
+    if (bytes == 0) { bytes = 1; }
+    size_t index = (bytes - 1) / kGranularity;
+    return index < m_lookup.size() ? m_lookup[index] : kOversize;
+  }
+
+  LocalCache *local_cache() noexcept;
+  LocalCache *register_thread() noexcept;
+  void add_slab(SizeClass &size_class);
+  void refill(SizeClass &size_class, LocalClass &local);
+  static void flush(SizeClass &size_class, LocalClass &local, size_t n) noexcept;
+  static void retire(Registry &registry, LocalCache &cache) noexcept;
+};
+
+inline SlabAllocator::SlabAllocator(std::vector<size_t> size_classes, size_t slab_bytes)
+  : m_slab_bytes(slab_bytes), m_id(next_id()), m_registry(std::make_shared<Registry>())
+{
+  if (size_classes.empty()) { throw std::invalid_argument("SlabAllocator needs at least one size class"); }
+  for (auto &size : size_classes) { size = std::max(kGranularity, (size + kGranularity - 1) / kGranularity * kGranularity); }
+  std::sort(size_classes.begin(), size_classes.end());
+  size_classes.erase(std::unique(size_classes.begin(), size_classes.end()), size_classes.end());
+  if (size_classes.size() > 255) { throw std::invalid_argument("SlabAllocator supports at most 255 size classes"); }
+
+  for (size_t size : size_classes) {
+    m_classes.push_back(std::make_unique<SizeClass>(size));
+    m_registry->classes.push_back(m_classes.back().get());
+  }
+  m_registry->retired_in_use.resize(m_classes.size());
+  m_registry->retired_bytes.resize(m_classes.size());
+
+  // One lookup entry per 16 bytes makes picking a class a single load.
+  m_lookup.resize(size_classes.back() / kGranularity);
+  uint8_t current = 0;
+  for (size_t i = 0; i < m_lookup.size(); i++) {
+    while (m_classes[current]->block_size < (i + 1) * kGranularity) { current++; }
+    m_lookup[i] = current;
+  }
+}
+
+inline SlabAllocator::~SlabAllocator()
+{
+  {
+    auto lock = std::lock_guard(m_registry->mutex);
+    m_registry->alive = false;
+  }
+  if (tl_last_id == m_id) {
+    tl_last_id = 0;
+    tl_last_cache = nullptr;
+  }
+  if (thread_cache_destroyed()) { return; }
+  thread_cache().entries.erase(m_id);
+}
+
+inline auto SlabAllocator::local_cache() noexcept -> LocalCache *
+{
+  if (tl_last_id == m_id) { return tl_last_cache; }
+  if (thread_cache_destroyed()) { return nullptr; }
+
+  auto &cache = thread_cache();
+  auto iter = cache.entries.find(m_id);
+  if (iter == cache.entries.end()) { return register_thread(); }
+  tl_last_id = m_id;
+  tl_last_cache = iter->second.cache.get();
+  return tl_last_cache;
+}
+
+inline auto SlabAllocator::register_thread() noexcept -> LocalCache *
+{
+  auto &cache = thread_cache();
+  try {
+    // Drop entries of allocators that have since been destroyed.
+    std::erase_if(cache.entries, [](auto &kv) {
+      auto lock = std::lock_guard(kv.second.registry->mutex);
+      return !kv.second.registry->alive;
+    });
+    auto local = std::make_unique<LocalCache>(m_classes.size());
+    {
+      auto lock = std::lock_guard(m_registry->mutex);
+      m_registry->caches.push_back(local.get());
+    }
+    auto [iter, inserted] = cache.entries.emplace(m_id, ThreadCache::Entry{ m_registry, std::move(local) });
+    tl_last_id = m_id;
+    tl_last_cache = iter->second.cache.get();
+    return tl_last_cache;
+  } catch (...) {
+    return nullptr;
+  }
+}
+
+inline void SlabAllocator::retire(Registry &registry, LocalCache &cache) noexcept
+{
+  auto lock = std::lock_guard(registry.mutex);
+  if (!registry.alive) { return; }
+  for (size_t i = 0; i < registry.classes.size(); i++) {
+    LocalClass &local = cache.per_class[i];
+    flush(*registry.classes[i], local, local.count);
+    registry.retired_in_use[i] += local.in_use.load(std::memory_order_relaxed);
+    registry.retired_bytes[i] += local.bytes.load(std::memory_order_relaxed);
+  }
+  std::erase(registry.caches, &cache);
+}
+
+inline void SlabAllocator::add_slab(SizeClass &size_class)
+{
+  size_t blocks = std::max<size_t>(size_class.batch, m_slab_bytes / size_class.block_size);
+  size_class.slabs.reserve(size_class.slabs.size() + 1);
+  auto slab = std::make_unique_for_overwrite<std::byte[]>(blocks * size_class.block_size);
+  std::byte *base = slab.get();
+  for (size_t i = blocks; i > 0; i--) {
+    auto *block = ::new (base + (i - 1) * size_class.block_size) FreeBlock{ size_class.free_list };
+    size_class.free_list = block;
+  }
+  size_class.slabs.push_back(std::move(slab));
+  size_class.blocks_total += blocks;
+}
+
+inline void SlabAllocator::refill(SizeClass &size_class, LocalClass &local)
+{
+  auto lock = std::lock_guard(size_class.mutex);
+  if (size_class.free_list == nullptr) { add_slab(size_class); }
+  while (size_class.free_list != nullptr && local.count < size_class.batch) {
+    FreeBlock *block = size_class.free_list;
+    size_class.free_list = block->next;
+    block->next = local.head;
+    local.head = block;
+    local.count++;
+  }
+}
+
+inline void SlabAllocator::flush(SizeClass &size_class, LocalClass &local, size_t n) noexcept
+{
+  auto lock = std::lock_guard(size_class.mutex);
+  for (; n > 0; n--) {
+    FreeBlock *block = local.head;
+    local.head = block->next;
+    local.count--;
+    block->next = size_class.free_list;
+    size_class.free_list = block;
+  }
+}
+
+inline void *SlabAllocator::do_allocate(size_t bytes, size_t alignment)
+{
+  size_t index = class_index(bytes);
+  if (index == kOversize || alignment > kGranularity) {
+    void *ptr = ::operator new(bytes, std::align_val_t(alignment));
+    m_oversize_in_use.fetch_add(1, std::memory_order_relaxed);
+    m_oversize_bytes.fetch_add(static_cast<int64_t>(bytes), std::memory_order_relaxed);
+    return ptr;
+  }
+
+  SizeClass &size_class = *m_classes[index];
+  LocalCache *cache = local_cache();
+  if (cache == nullptr) {
+    // No cache for this thread (it is exiting); go through a throwaway one.
+    LocalClass local;
+    refill(size_class, local);
+    FreeBlock *block = local.head;
+    if (block == nullptr) { throw std::bad_alloc(); }
+    local.head = block->next;
+    local.count--;
+    flush(size_class, local, local.count);
+    auto lock = std::lock_guard(m_registry->mutex);
+    m_registry->retired_in_use[index] += 1;
+    m_registry->retired_bytes[index] += static_cast<int64_t>(bytes);
+    return block;
+  }
+
+  LocalClass &local = cache->per_class[index];
+  if (local.head == nullptr) { refill(size_class, local); }
+  FreeBlock *block = local.head;
+  local.head = block->next;
+  local.count--;
+  local.add(1, static_cast<int64_t>(bytes));
+  return block;
+}
+
+inline void SlabAllocator::do_deallocate(void *ptr, size_t bytes, size_t alignment)
+{
+  size_t index = class_index(bytes);
+  if (index == kOversize || alignment > kGranularity) {
+    ::operator delete(ptr, std::align_val_t(alignment));
+    m_oversize_in_use.fetch_sub(1, std::memory_order_relaxed);
+    m_oversize_bytes.fetch_sub(static_cast<int64_t>(bytes), std::memory_order_relaxed);
+    return;
+  }
+
+  SizeClass &size_class = *m_classes[index];
+  auto *block = ::new (ptr) FreeBlock{ nullptr };
+  LocalCache *cache = local_cache();
+  if (cache == nullptr) {
+    LocalClass local;
+    local.head = block;
+    local.count = 1;
+    flush(size_class, local, 1);
+    auto lock = std::lock_guard(m_registry->mutex);
+    m_registry->retired_in_use[index] -= 1;
+    m_registry->retired_bytes[index] -= static_cast<int64_t>(bytes);
+    return;
+  }
+
+  LocalClass &local = cache->per_class[index];
+  block->next = local.head;
+  local.head = block;
+  local.count++;
+  local.add(-1, -static_cast<int64_t>(bytes));
+  if (local.count >= 2 * size_class.batch) { flush(size_class, local, size_class.batch); }
+}
+
+inline SlabAllocator::Stats SlabAllocator::stats() const
+{
+  Stats result;
+  result.classes.reserve(m_classes.size());
+  auto registry_lock = std::lock_guard(m_registry->mutex);
+  for (size_t i = 0; i < m_classes.size(); i++) {
+    int64_t in_use = m_registry->retired_in_use[i];
+    int64_t bytes = m_registry->retired_bytes[i];
+    for (const LocalCache *cache : m_registry->caches) {
+      in_use += cache->per_class[i].in_use.load(std::memory_order_relaxed);
+      bytes += cache->per_class[i].bytes.load(std::memory_order_relaxed);
+    }
+    SizeClass &size_class = *m_classes[i];
+    auto lock = std::lock_guard(size_class.mutex);
+    result.classes.push_back({ size_class.block_size,
+      size_class.slabs.size(),
+      size_class.blocks_total,
+      static_cast<size_t>(std::max<int64_t>(in_use, 0)),
+      static_cast<size_t>(std::max<int64_t>(bytes, 0)) });
+  }
+  result.oversize_in_use = static_cast<size_t>(m_oversize_in_use.load(std::memory_order_relaxed));
+  result.oversize_bytes = static_cast<size_t>(m_oversize_bytes.load(std::memory_order_relaxed));
+  return result;
+}
+
+/**
+ * @brief Move-only byte buffer whose storage comes from a SlabAllocator.
+ *
+ * The payload counterpart of std::vector<uint8_t>: resizing within the block's
+ * size class is free, growing past it moves the bytes to a block of a larger
+ * class. A default constructed buffer is empty and owns nothing.
+ */
+class ByteBuffer
+{
+  SlabAllocator *m_allocator = nullptr;
+  uint8_t *m_data = nullptr;
+  size_t m_size = 0;
+  size_t m_capacity = 0;
+  size_t m_allocated = 0;// bytes requested from the allocator, needed to give them back
+
+  void release() noexcept
+  {
+    if (m_data != nullptr) { m_allocator->deallocate(m_data, m_allocated, alignof(std::max_align_t)); }
+    m_data = nullptr;
+    m_size = m_capacity = m_allocated = 0;
+  }
+
+public:
+  ByteBuffer() = default;
+
+  ByteBuffer(SlabAllocator &allocator, size_t size) : m_allocator(&allocator) { resize(size); }
+
+  ByteBuffer(SlabAllocator &allocator, std::span<const uint8_t> bytes) : ByteBuffer(allocator, bytes.size())
+  {
+    if (!bytes.empty()) { std::memcpy(m_data, bytes.data(), bytes.size()); }
+  }
+
+  ~ByteBuffer() { release(); }
+
+  ByteBuffer(ByteBuffer &&other) noexcept
+    : m_allocator(other.m_allocator), m_data(std::exchange(other.m_data, nullptr)),
+      m_size(std::exchange(other.m_size, 0)), m_capacity(std::exchange(other.m_capacity, 0)),
+      m_allocated(std::exchange(other.m_allocated, 0))
+  {}
+
+  ByteBuffer &operator=(ByteBuffer &&other) noexcept
+  {
+    if (this != &other) {
+      release();
+      m_allocator = other.m_allocator;
+      m_data = std::exchange(other.m_data, nullptr);
+      m_size = std::exchange(other.m_size, 0);
+      m_capacity = std::exchange(other.m_capacity, 0);
+      m_allocated = std::exchange(other.m_allocated, 0);
+    }
+    return *this;
+  }
+
+  ByteBuffer(const ByteBuffer &) = delete;
+  ByteBuffer &operator=(const ByteBuffer &) = delete;
+
+  /**
+   * @brief Changes the size, keeping existing bytes. New bytes are uninitialized.
+   */
+  void resize(size_t size)
+  {
+    if (size <= m_capacity) {
+      m_size = size;
+      return;
+    }
+    if (m_allocator == nullptr) { throw std::logic_error("ByteBuffer has no allocator"); }
+    auto *data = static_cast<uint8_t *>(m_allocator->allocate(size, alignof(std::max_align_t)));
+    if (m_size != 0) { std::memcpy(data, m_data, m_size); }
+    release();
+    m_data = data;
+    m_size = size;
+    m_allocated = size;
+    m_capacity = m_allocator->good_size(size);
+  }
+
+  void assign(std::span<const uint8_t> bytes)
+  {
+    m_size = 0;
+    resize(bytes.size());
+    if (!bytes.empty()) { std::memcpy(m_data, bytes.data(), bytes.size()); }
+  }
+
+  uint8_t *data() noexcept { return m_data; }
+  const uint8_t *data() const noexcept { return m_data; }
+  size_t size() const noexcept { return m_size; }
+  size_t capacity() const noexcept { return m_capacity; }
+  bool empty() const noexcept { return m_size == 0; }
+
+  uint8_t &operator[](size_t index) noexcept { return m_data[index]; }
+  const uint8_t &operator[](size_t index) const noexcept { return m_data[index]; }
+
+  uint8_t *begin() noexcept { return m_data; }
+  uint8_t *end() noexcept { return m_data + m_size; }
+  const uint8_t *begin() const noexcept { return m_data; }
+  const uint8_t *end() const noexcept { return m_data + m_size; }
+
+  std::span<uint8_t> span() noexcept { return { m_data, m_size }; }
+  std::span<const uint8_t> span() const noexcept { return { m_data, m_size }; }
+};
+
+}// namespace memory
@@ -0,0 +1,513 @@
+#pragma once
+
+#include "threadpool/task.h"
+#include "threadpool/threadpool.h"
+#include <atomic>
+#include <concepts>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace threadpool {
+
+template<typename T = void> class task;
+
+namespace detail {
+
+  // Coroutine frames come from task_resource(), like the rest of the task state.
+  struct PooledFrame
+  {
+    static void *operator new(size_t size) { return task_resource()->allocate(size, alignof(std::max_align_t)); }
+    static void operator delete(void *ptr, size_t size) noexcept
+    {
+      task_resource()->deallocate(ptr, size, alignof(std::max_align_t));
+    }
+  };
+
+  class TaskPromiseBase : public PooledFrame
+  {
+  public:
+    // Hands control straight to whoever awaited the task, without growing the stack.
+    struct FinalAwaiter
+    {
+      bool await_ready() const noexcept { return false; }
+      template<typename Promise> std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+      {
+        std::coroutine_handle<> continuation = handle.promise().m_continuation;
+        return continuation ? continuation : std::noop_coroutine();
+      }
+      void await_resume() const noexcept {}
+    };
+
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+    FinalAwaiter final_suspend() const noexcept { return {}; }
+    void set_continuation(std::coroutine_handle<> continuation) noexcept { m_continuation = continuation; }
+
+  private:
+    std::coroutine_handle<> m_continuation;
+  };
+
+  template<typename T> class TaskPromise : public TaskPromiseBase
+  {
+  public:
+    task<T> get_return_object() noexcept;
+    void unhandled_exception() noexcept { m_result.template emplace<2>(std::current_exception()); }
+
+    template<typename U>
+      requires std::convertible_to<U &&, T>
+    void return_value(U &&value)
+    {
+      m_result.template emplace<1>(std::forward<U>(value));
+    }
+
+    T result()
+    {
+      if (m_result.index() == 2) { std::rethrow_exception(std::get<2>(m_result)); }
+      return std::move(std::get<1>(m_result));
+    }
+
+  private:
+    std::variant<std::monostate, T, std::exception_ptr> m_result;
+  };
+
+  template<> class TaskPromise<void> : public TaskPromiseBase
+  {
+  public:
+    task<void> get_return_object() noexcept;
+    void unhandled_exception() noexcept { m_error = std::current_exception(); }
+    void return_void() const noexcept {}
+
+    void result() const
+    {
+      if (m_error) { std::rethrow_exception(m_error); }
+    }
+
+  private:
+    std::exception_ptr m_error;
+  };
+
+  // Lets the combinators below read a finished task's result.
+  struct TaskAccess
+  {
+    template<typename T> static T result(task<T> &t) { return t.m_handle.promise().result(); }
+  };
+
+  template<typename T> using NonVoid = std::conditional_t<std::is_void_v<T>, std::monostate, T>;
+
+  template<typename T> NonVoid<T> non_void_result(task<T> &t)
+  {
+    if constexpr (std::is_void_v<T>) {
+      TaskAccess::result(t);
+      return {};
+    } else {
+      return TaskAccess::result(t);
+    }
+  }
+
+}// namespace detail
+
+/**
+ * @brief Lazily started coroutine producing a T.
+ *
+ * Nothing runs until the task is awaited; then it runs on the awaiting thread
+ * until it suspends, typically on `co_await pool.schedule()`, and resumes its
+ * awaiter directly when it finishes. Exceptions are rethrown to the awaiter.
+ * Frames are allocated from task_resource().
+ *
+ * @note Not to be confused with threadpool::Task, the type-erased callable
+ * the pool queues.
+ */
+template<typename T> class [[nodiscard]] task
+{
+  static_assert(!std::is_reference_v<T>, "task does not hold references; use std::reference_wrapper");
+
+public:
+  using promise_type = detail::TaskPromise<T>;
+
+  task() noexcept = default;
+  task(task &&other) noexcept : m_handle(std::exchange(other.m_handle, nullptr)) {}
+  task &operator=(task &&other) noexcept
+  {
+    if (this != &other) {
+      if (m_handle) { m_handle.destroy(); }
+      m_handle = std::exchange(other.m_handle, nullptr);
+    }
+    return *this;
+  }
+  task(const task &) = delete;
+  task &operator=(const task &) = delete;
+  ~task()
+  {
+    if (m_handle) { m_handle.destroy(); }
+  }
+
+  bool valid() const noexcept { return static_cast<bool>(m_handle); }
+
+  /**
+   * @brief Runs the task and returns its result; await at most once.
+   */
+  auto operator co_await() noexcept
+  {
+    struct Awaiter : AwaiterBase
+    {
+      T await_resume() { return this->handle.promise().result(); }
+    };
+    return Awaiter{ { m_handle } };
+  }
+
+  /**
+   * @brief Runs the task to completion without taking its result or exception.
+   */
+  auto when_ready() noexcept
+  {
+    struct Awaiter : AwaiterBase
+    {
+      void await_resume() const noexcept {}
+    };
+    return Awaiter{ { m_handle } };
+  }
+
+private:
+  friend promise_type;
+  friend detail::TaskAccess;
+
+  struct AwaiterBase
+  {
+    std::coroutine_handle<promise_type> handle;
+
+    bool await_ready() const noexcept { return handle.done(); }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+    {
+      handle.promise().set_continuation(awaiting);
+      return handle;
+    }
+  };
+
+  explicit task(std::coroutine_handle<promise_type> handle) noexcept : m_handle(handle) {}
+
+  std::coroutine_handle<promise_type> m_handle;
+};
+
+namespace detail {
+
+  template<typename T> task<T> TaskPromise<T>::get_return_object() noexcept
+  {
+    return task<T>(std::coroutine_handle<TaskPromise>::from_promise(*this));
+  }
+
+  inline task<void> TaskPromise<void>::get_return_object() noexcept
+  {
+    return task<void>(std::coroutine_handle<TaskPromise>::from_promise(*this));
+  }
+
+  /**
+   * @brief Resumes an awaiting coroutine once @p children others have
+   * finished. The awaiter holds one count itself until it has started them
+   * all, so a child finishing early cannot resume it too soon.
+   */
+  class CompletionCounter
+  {
+  public:
+    explicit CompletionCounter(size_t children) noexcept : m_count(children + 1) {}
+
+    void set_awaiting(std::coroutine_handle<> awaiting) noexcept { m_awaiting = awaiting; }
+
+    // The coroutine to continue with once a child is done.
+    std::coroutine_handle<> child_done() noexcept
+    {
+      return m_count.fetch_sub(1, std::memory_order_acq_rel) == 1 ? m_awaiting : std::noop_coroutine();
+    }
+
+    // True while children are still running, so the awaiter has to suspend.
+    bool awaiter_arrived() noexcept { return m_count.fetch_sub(1, std::memory_order_acq_rel) > 1; }
+
+  private:
+    std::atomic<size_t> m_count;
+    std::coroutine_handle<> m_awaiting;
+  };
+
+  // Awaits one child of a when_all and reports to the counter.
+  class WhenAllChild
+  {
+  public:
+    struct promise_type : PooledFrame
+    {
+      CompletionCounter *counter = nullptr;
+
+      WhenAllChild get_return_object() noexcept
+      {
+        return WhenAllChild(std::coroutine_handle<promise_type>::from_promise(*this));
+      }
+      std::suspend_always initial_suspend() const noexcept { return {}; }
+      auto final_suspend() const noexcept
+      {
+        struct Notify
+        {
+          bool await_ready() const noexcept { return false; }
+          std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept
+          {
+            return handle.promise().counter->child_done();
+          }
+          void await_resume() const noexcept {}
+        };
+        return Notify{};
+      }
+      void return_void() const noexcept {}
+      void unhandled_exception() const noexcept { std::terminate(); }// only awaits when_ready(), which cannot throw
+    };
+
+    WhenAllChild(WhenAllChild &&other) noexcept : m_handle(std::exchange(other.m_handle, nullptr)) {}
+    WhenAllChild &operator=(WhenAllChild &&) = delete;
+    ~WhenAllChild()
+    {
+      if (m_handle) { m_handle.destroy(); }
+    }
+
+    void start(CompletionCounter &counter) noexcept
+    {
+      m_handle.promise().counter = &counter;
+      m_handle.resume();
+    }
+
+  private:
+    explicit WhenAllChild(std::coroutine_handle<promise_type> handle) noexcept : m_handle(handle) {}
+
+    std::coroutine_handle<promise_type> m_handle;
+  };
+
+  template<typename T> WhenAllChild make_when_all_child(task<T> &t) { co_await t.when_ready(); }
+
+  class WhenAllAwaitable
+  {
+  public:
+    explicit WhenAllAwaitable(std::vector<WhenAllChild> children) noexcept
+      : m_children(std::move(children)), m_counter(m_children.size())
+    {}
+
+    bool await_ready() const noexcept { return m_children.empty(); }
+    bool await_suspend(std::coroutine_handle<> awaiting) noexcept
+    {
+      m_counter.set_awaiting(awaiting);
+      for (auto &child : m_children) { child.start(m_counter); }
+      return m_counter.awaiter_arrived();
+    }
+    void await_resume() const noexcept {}
+
+  private:
+    std::vector<WhenAllChild> m_children;
+    CompletionCounter m_counter;
+  };
+
+  // Self-destroying coroutine for the when_any children that may outlive the awaiter.
+  class DetachedTask
+  {
+  public:
+    struct promise_type : PooledFrame
+    {
+      DetachedTask get_return_object() noexcept
+      {
+        return DetachedTask(std::coroutine_handle<promise_type>::from_promise(*this));
+      }
+      std::suspend_always initial_suspend() const noexcept { return {}; }
+      std::suspend_never final_suspend() const noexcept { return {}; }
+      void return_void() const noexcept {}
+      void unhandled_exception() const noexcept { std::terminate(); }
+    };
+
+    void start() noexcept { m_handle.resume(); }
+
+  private:
+    explicit DetachedTask(std::coroutine_handle<promise_type> handle) noexcept : m_handle(handle) {}
+
+    std::coroutine_handle<promise_type> m_handle;
+  };
+
+  template<typename T> struct WhenAnyState
+  {
+    explicit WhenAnyState(std::vector<task<T>> awaited) noexcept : tasks(std::move(awaited)) {}
+
+    std::vector<task<T>> tasks;
+    std::atomic<bool> decided{ false };
+    size_t winner = 0;
+    CompletionCounter counter{ 1 };// the winner and the awaiter
+  };
+
+  template<typename T> DetachedTask make_when_any_child(std::shared_ptr<WhenAnyState<T>> state, size_t index)
+  {
+    co_await state->tasks[index].when_ready();
+    if (!state->decided.exchange(true, std::memory_order_acq_rel)) {
+      state->winner = index;
+      state->counter.child_done().resume();
+    }
+  }
+
+  template<typename T> class WhenAnyAwaitable
+  {
+  public:
+    explicit WhenAnyAwaitable(std::shared_ptr<WhenAnyState<T>> state) noexcept : m_state(std::move(state)) {}
+
+    bool await_ready() const noexcept { return false; }
+    bool await_suspend(std::coroutine_handle<> awaiting) noexcept
+    {
+      m_state->counter.set_awaiting(awaiting);
+      for (size_t i = 0; i < m_state->tasks.size(); i++) { make_when_any_child(m_state, i).start(); }
+      return m_state->counter.awaiter_arrived();
+    }
+    void await_resume() const noexcept {}
+
+  private:
+    std::shared_ptr<WhenAnyState<T>> m_state;
+  };
+
+  template<typename T> using WhenAllVector = std::conditional_t<std::is_void_v<T>, void, std::vector<NonVoid<T>>>;
+  template<typename T>
+  using WhenAnyResult = std::conditional_t<std::is_void_v<T>, size_t, std::pair<size_t, NonVoid<T>>>;
+
+  // Signalled under its mutex, so the signalling thread is done with it by the
+  // time the waiter can return and destroy it.
+  class SyncWaitEvent
+  {
+  public:
+    void set()
+    {
+      auto lock = std::lock_guard(m_mutex);
+      m_set = true;
+      m_cond_variable.notify_one();
+    }
+    void wait()
+    {
+      auto lock = std::unique_lock(m_mutex);
+      m_cond_variable.wait(lock, [this] { return m_set; });
+    }
+
+  private:
+    std::mutex m_mutex;
+    std::condition_variable m_cond_variable;
+    bool m_set = false;
+  };
+
+  class SyncWaitTask
+  {
+  public:
+    struct promise_type : PooledFrame
+    {
+      SyncWaitEvent *event = nullptr;
+
+      SyncWaitTask get_return_object() noexcept
+      {
+        return SyncWaitTask(std::coroutine_handle<promise_type>::from_promise(*this));
+      }
+      std::suspend_always initial_suspend() const noexcept { return {}; }
+      auto final_suspend() const noexcept
+      {
+        struct Signal
+        {
+          bool await_ready() const noexcept { return false; }
+          void await_suspend(std::coroutine_handle<promise_type> handle) noexcept { handle.promise().event->set(); }
+          void await_resume() const noexcept {}
+        };
+        return Signal{};
+      }
+      void return_void() const noexcept {}
+      void unhandled_exception() const noexcept { std::terminate(); }// only awaits when_ready()
+    };
+
+    SyncWaitTask(SyncWaitTask &&) = delete;
+    ~SyncWaitTask() { m_handle.destroy(); }
+
+    void run_and_wait()
+    {
+      SyncWaitEvent event;
+      m_handle.promise().event = &event;
+      m_handle.resume();
+      event.wait();
+    }
+
+  private:
+    explicit SyncWaitTask(std::coroutine_handle<promise_type> handle) noexcept : m_handle(handle) {}
+
+    std::coroutine_handle<promise_type> m_handle;
+  };
+
+  template<typename T> SyncWaitTask make_sync_wait_task(task<T> &t) { co_await t.when_ready(); }
+
+}// namespace detail
+
+/**
+ * @brief Runs @p t and blocks the calling thread until it finishes; the bridge
+ * from ordinary code such as main() into coroutines.
+ * @note Must not be called on a pool worker whose pool the task needs.
+ */
+template<typename T> T sync_wait(task<T> t)
+{
+  detail::make_sync_wait_task(t).run_and_wait();
+  return detail::TaskAccess::result(t);
+}
+
+/**
+ * @brief Starts every task and completes once all of them have.
+ * @return The results in order, or the first exception in order once all are done.
+ */
+template<typename T> task<detail::WhenAllVector<T>> when_all(std::vector<task<T>> tasks)
+{
+  std::vector<detail::WhenAllChild> children;
+  children.reserve(tasks.size());
+  for (auto &t : tasks) { children.push_back(detail::make_when_all_child(t)); }
+  co_await detail::WhenAllAwaitable(std::move(children));
+
+  if constexpr (std::is_void_v<T>) {
+    for (auto &t : tasks) { detail::TaskAccess::result(t); }
+  } else {
+    std::vector<T> results;
+    results.reserve(tasks.size());
+    for (auto &t : tasks) { results.push_back(detail::TaskAccess::result(t)); }
+    co_return results;
+  }
+}
+
+/**
+ * @brief when_all for tasks of different types; void results become std::monostate.
+ */
+template<typename... Ts> task<std::tuple<detail::NonVoid<Ts>...>> when_all(task<Ts>... tasks)
+{
+  std::vector<detail::WhenAllChild> children;
+  children.reserve(sizeof...(Ts));
+  (children.push_back(detail::make_when_all_child(tasks)), ...);
+  co_await detail::WhenAllAwaitable(std::move(children));
+  co_return std::tuple<detail::NonVoid<Ts>...>{ detail::non_void_result(tasks)... };
+}
+
+/**
+ * @brief Starts every task and completes as soon as the first one does.
+ * @return The index of the first task to finish with its result, just the
+ * index for void tasks; rethrows its exception if it failed.
+ * @note The other tasks keep running to completion in the background, so
+ * whatever they use, the pool included, must outlive them.
+ */
+template<typename T> task<detail::WhenAnyResult<T>> when_any(std::vector<task<T>> tasks)
+{
+  if (tasks.empty()) { throw std::invalid_argument("when_any needs at least one task"); }
+  auto state = std::allocate_shared<detail::WhenAnyState<T>>(
+    std::pmr::polymorphic_allocator<detail::WhenAnyState<T>>(task_resource()), std::move(tasks));
+  co_await detail::WhenAnyAwaitable<T>(state);
+
+  size_t winner = state->winner;
+  if constexpr (std::is_void_v<T>) {
+    detail::TaskAccess::result(state->tasks[winner]);
+    co_return winner;
+  } else {
+    co_return std::pair<size_t, T>(winner, detail::TaskAccess::result(state->tasks[winner]));
+  }
+}
+
+}// namespace threadpool
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <string_view>
+#include <vector>
+
+namespace threadpool {
+
+/**
+ * @brief How a ThreadPool spreads its workers over the CPUs it may use.
+ *
+ * none:           workers are not pinned; the OS scheduler places them.
+ * compact:        fill every hardware thread of a core, then the next core of
+ *                 the same package, then the next package. Workers that share
+ *                 data share caches.
+ * scatter:        one worker per package in turn, then per core, and only
+ *                 then on hyperthread siblings. Spreads memory bandwidth and
+ *                 cache capacity.
+ * physical_cores: like compact, but only the first hardware thread of every
+ *                 core, so no two workers compete for one core.
+ *
+ * With more workers than CPUs in the layout, worker i takes CPU i modulo the
+ * layout size.
+ */
+enum class CpuLayout { none, compact, scatter, physical_cores };
+
+/**
+ * @brief One logical CPU, with the core, package and NUMA node it belongs to.
+ * node is -1 when the kernel does not report NUMA nodes.
+ */
+struct CpuInfo
+{
+  int cpu = 0;
+  int core = 0;
+  int package = 0;
+  int node = -1;
+};
+
+/**
+ * @brief The logical CPUs this process may run on and how they are grouped.
+ */
+class CpuTopology
+{
+public:
+  /**
+   * @brief Reads the CPUs in this process's affinity mask from sysfs. CPUs
+   * without topology information count as a core and package of their own;
+   * on platforms other than Linux the topology is empty.
+   */
+  static CpuTopology detect();
+
+  CpuTopology() = default;
+  explicit CpuTopology(std::vector<CpuInfo> cpus);
+
+  const std::vector<CpuInfo> &cpus() const noexcept { return m_cpus; }
+  bool empty() const noexcept { return m_cpus.empty(); }
+
+  /**
+   * @brief The entry for @p cpu, or nullptr when it is not in the topology.
+   */
+  const CpuInfo *find(int cpu) const noexcept;
+
+  /**
+   * @brief The CPUs of NUMA node @p node.
+   */
+  CpuTopology on_node(int node) const;
+
+  /**
+   * @brief CPU ids in the order @p layout assigns them to workers; empty for
+   * CpuLayout::none.
+   */
+  std::vector<int> order(CpuLayout layout) const;
+
+private:
+  std::vector<CpuInfo> m_cpus;// sorted by cpu id
+};
+
+/**
+ * @brief Restricts the calling thread to @p cpus. Best effort: returns false
+ * when the OS refuses, or does not support, the request.
+ */
+bool pin_current_thread(const std::vector<int> &cpus) noexcept;
+
+/**
+ * @brief Names the calling thread for debuggers, perf and top. Linux keeps
+ * the first 15 characters. Best effort, like pin_current_thread.
+ */
+bool name_current_thread(std::string_view name) noexcept;
+
+/**
+ * @brief Names the calling thread "<name>-<index>", shortening @p name rather
+ * than the index so that numbered threads stay distinguishable.
+ */
+bool name_current_thread(std::string_view name, size_t index) noexcept;
+
+}// namespace threadpool
@@ -0,0 +1,199 @@
+#pragma once
+
+#include "threadpool/task.h"
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <future>
+#include <memory_resource>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace threadpool {
+
+template<typename T> class Future;
+
+namespace detail {
+
+  /**
+   * @brief Result slot shared by one Promise and one Future.
+   *
+   * Allocated from task_resource() and reference counted by its two owners;
+   * the last one to let go destroys it. Readiness is a std::atomic wait, so a
+   * Future that is already ready never touches a mutex or a condition variable.
+   */
+  template<typename T> class SharedState
+  {
+    using Stored = std::conditional_t<std::is_void_v<T>, std::byte, T>;
+
+  public:
+    enum class Status : uint32_t { pending, value, error };
+
+    static SharedState *create()
+    {
+      return std::pmr::polymorphic_allocator<>(task_resource()).new_object<SharedState>();
+    }
+
+    void add_ref() noexcept { m_refs.fetch_add(1, std::memory_order_relaxed); }
+    void release() noexcept
+    {
+      if (m_refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        std::pmr::polymorphic_allocator<>(task_resource()).delete_object(this);
+      }
+    }
+
+    template<typename... Args> void set_value(Args &&...args)
+    {
+      ::new (static_cast<void *>(&m_value)) Stored(std::forward<Args>(args)...);
+      publish(Status::value);
+    }
+    void set_exception(std::exception_ptr exception) noexcept
+    {
+      m_error = std::move(exception);
+      publish(Status::error);
+    }
+
+    bool ready() const noexcept { return m_status.load(std::memory_order_acquire) != Status::pending; }
+    void wait() const noexcept { m_status.wait(Status::pending, std::memory_order_acquire); }
+
+    T take()
+    {
+      wait();
+      if (m_status.load(std::memory_order_acquire) == Status::error) { std::rethrow_exception(m_error); }
+      if constexpr (!std::is_void_v<T>) { return std::move(m_value); }
+    }
+
+    SharedState() noexcept {}// m_value stays unconstructed until set_value
+    ~SharedState()
+    {
+      if (m_status.load(std::memory_order_relaxed) == Status::value) { m_value.~Stored(); }
+    }
+
+    SharedState(const SharedState &) = delete;
+    SharedState &operator=(const SharedState &) = delete;
+
+  private:
+    void publish(Status status) noexcept
+    {
+      m_status.store(status, std::memory_order_release);
+      m_status.notify_all();
+    }
+
+    std::atomic<Status> m_status{ Status::pending };
+    std::atomic<uint32_t> m_refs{ 1 };
+    std::exception_ptr m_error;
+    union {
+      Stored m_value;
+    };
+  };
+
+}// namespace detail
+
+/**
+ * @brief Write side of a Future, the lightweight counterpart of std::promise.
+ *
+ * The shared state comes from task_resource() rather than from the heap. A
+ * Promise destroyed without a result stores std::future_errc::broken_promise.
+ */
+template<typename T> class Promise
+{
+public:
+  Promise() : m_state(detail::SharedState<T>::create()) {}
+  Promise(Promise &&other) noexcept : m_state(std::exchange(other.m_state, nullptr)) {}
+  Promise &operator=(Promise &&other) noexcept
+  {
+    if (this != &other) {
+      abandon();
+      m_state = std::exchange(other.m_state, nullptr);
+    }
+    return *this;
+  }
+  Promise(const Promise &) = delete;
+  Promise &operator=(const Promise &) = delete;
+  ~Promise() { abandon(); }
+
+  /**
+   * @brief The Future for this promise; call at most once.
+   */
+  Future<T> get_future()
+  {
+    m_state->add_ref();
+    return Future<T>(m_state);
+  }
+
+  /**
+   * @brief Stores the result; at most one of set_value and set_exception.
+   */
+  template<typename... Args> void set_value(Args &&...args)
+  {
+    m_state->set_value(std::forward<Args>(args)...);
+    std::exchange(m_state, nullptr)->release();
+  }
+  void set_exception(std::exception_ptr error)
+  {
+    m_state->set_exception(std::move(error));
+    std::exchange(m_state, nullptr)->release();
+  }
+
+private:
+  detail::SharedState<T> *m_state;
+
+  void abandon() noexcept
+  {
+    if (m_state == nullptr) { return; }
+    m_state->set_exception(std::make_exception_ptr(std::future_error(std::future_errc::broken_promise)));
+    std::exchange(m_state, nullptr)->release();
+  }
+};
+
+/**
+ * @brief Read side of a Promise, the lightweight counterpart of std::future.
+ *
+ * get() waits for the result and moves it out, rethrowing a stored exception;
+ * like std::future it may be called once.
+ */
+template<typename T> class Future
+{
+  static_assert(!std::is_reference_v<T>, "Future does not hold references; use std::reference_wrapper");
+
+public:
+  Future() noexcept = default;
+  Future(Future &&other) noexcept : m_state(std::exchange(other.m_state, nullptr)) {}
+  Future &operator=(Future &&other) noexcept
+  {
+    if (this != &other) {
+      if (m_state != nullptr) { m_state->release(); }
+      m_state = std::exchange(other.m_state, nullptr);
+    }
+    return *this;
+  }
+  Future(const Future &) = delete;
+  Future &operator=(const Future &) = delete;
+  ~Future()
+  {
+    if (m_state != nullptr) { m_state->release(); }
+  }
+
+  bool valid() const noexcept { return m_state != nullptr; }
+  bool ready() const noexcept { return m_state->ready(); }
+  void wait() const noexcept { m_state->wait(); }
+
+  T get()
+  {
+    struct Release
+    {
+      Future *future;
+      ~Release() { std::exchange(future->m_state, nullptr)->release(); }
+    } release{ this };
+    return m_state->take();
+  }
+
+private:
+  template<typename> friend class Promise;
+  explicit Future(detail::SharedState<T> *state) noexcept : m_state(state) {}
+
+  detail::SharedState<T> *m_state = nullptr;
+};
+
+}// namespace threadpool
@@ -0,0 +1,253 @@
+#pragma once
+
+#include "threadpool/task.h"
+#include "threadpool/threadpool.h"
+#include <algorithm>
+#include <atomic>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <memory_resource>
+#include <optional>
+#include <ranges>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace threadpool {
+
+namespace detail {
+
+  /**
+   * @brief How a parallel algorithm cuts [0, count) into chunks of grain
+   * elements; the last chunk may be shorter.
+   *
+   * A grain of 0 picks one so that every participant, the workers plus the
+   * calling thread, gets about kChunksPerParticipant chunks: enough for the
+   * fast ones to pick up the slack of the slow ones, few enough that the
+   * per-chunk claim and the reduction stay cheap.
+   */
+  struct Chunking
+  {
+    static constexpr size_t kChunksPerParticipant = 8;
+
+    size_t count;
+    size_t grain;
+    size_t chunks;
+
+    Chunking(size_t element_count, size_t requested_grain, size_t participants) noexcept
+      : count(element_count), grain(requested_grain)
+    {
+      if (grain == 0) { grain = std::max<size_t>(1, count / (kChunksPerParticipant * participants)); }
+      chunks = (count + grain - 1) / grain;
+    }
+  };
+
+  /**
+   * @brief State shared by the caller of a parallel algorithm and the helper
+   * tasks it submits.
+   *
+   * Participants claim chunks with one fetch_add each. The caller claims chunks
+   * as well, so the algorithm completes even when every worker is busy, which
+   * makes it safe to call from inside a task. A single counter of finished
+   * chunks is the completion latch the caller waits on.
+   *
+   * Helpers hold a reference because one may only start after the caller has
+   * returned; it then finds no chunk left and never touches the body, which
+   * lives on the caller's stack.
+   */
+  class ParallelLoop
+  {
+  public:
+    using Run = void (*)(const void *body, size_t chunk, size_t begin, size_t end);
+
+    ParallelLoop(const Chunking &chunking, const void *body, Run run, uint32_t refs) noexcept
+      : m_chunking(chunking), m_body(body), m_run(run), m_refs(refs)
+    {}
+
+    static ParallelLoop *create(const Chunking &chunking, const void *body, Run run, uint32_t refs)
+    {
+      return std::pmr::polymorphic_allocator<>(task_resource()).new_object<ParallelLoop>(chunking, body, run, refs);
+    }
+
+    void release() noexcept
+    {
+      if (m_refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        std::pmr::polymorphic_allocator<>(task_resource()).delete_object(this);
+      }
+    }
+
+    // Claims and runs chunks until none are left. After a chunk has thrown the
+    // rest are only counted, not run.
+    void work() noexcept
+    {
+      while (true) {
+        size_t chunk = m_next.fetch_add(1, std::memory_order_relaxed);
+        if (chunk >= m_chunking.chunks) { return; }
+        if (!m_failed.load(std::memory_order_relaxed)) {
+          size_t begin = chunk * m_chunking.grain;
+          size_t end = std::min(m_chunking.count, begin + m_chunking.grain);
+          try {
+            m_run(m_body, chunk, begin, end);
+          } catch (...) {
+            if (!m_failed.exchange(true, std::memory_order_relaxed)) { m_error = std::current_exception(); }
+          }
+        }
+        if (m_done.fetch_add(1, std::memory_order_acq_rel) + 1 == m_chunking.chunks) { m_done.notify_all(); }
+      }
+    }
+
+    // Returns once every chunk has finished; their effects are visible then.
+    void wait() const noexcept
+    {
+      for (size_t done = m_done.load(std::memory_order_acquire); done != m_chunking.chunks;
+           done = m_done.load(std::memory_order_acquire)) {
+        m_done.wait(done, std::memory_order_acquire);
+      }
+    }
+
+    std::exception_ptr error() const noexcept { return m_error; }
+
+  private:
+    Chunking m_chunking;
+    const void *m_body;
+    Run m_run;
+    std::atomic<uint32_t> m_refs;
+    std::atomic<size_t> m_next{ 0 };
+    std::atomic<size_t> m_done{ 0 };
+    std::atomic<bool> m_failed{ false };
+    std::exception_ptr m_error;
+  };
+
+  /**
+   * @brief Runs body(chunk, begin, end) for every chunk on @p pool and the
+   * calling thread; rethrows the first exception a chunk threw.
+   */
+  template<typename Body> void run_chunks(ThreadPool &pool, const Chunking &chunking, const Body &body)
+  {
+    if (chunking.chunks == 0) { return; }
+    if (chunking.chunks == 1) {
+      body(size_t{ 0 }, size_t{ 0 }, chunking.count);
+      return;
+    }
+
+    size_t helpers = std::min(chunking.chunks - 1, pool.size());
+    auto run = [](const void *erased, size_t chunk, size_t begin, size_t end) {
+      (*static_cast<const Body *>(erased))(chunk, begin, end);
+    };
+    auto *loop = ParallelLoop::create(chunking, &body, run, static_cast<uint32_t>(helpers + 1));
+    size_t submitted = 0;
+    try {
+      for (; submitted < helpers; submitted++) {
+        pool.submit([loop] {
+          loop->work();
+          loop->release();
+        });
+      }
+    } catch (...) {
+      // Could not hand out every helper; the ones we have, and this thread, cover the rest.
+      for (; submitted < helpers; submitted++) { loop->release(); }
+    }
+    loop->work();
+    loop->wait();
+    std::exception_ptr error = loop->error();
+    loop->release();
+    if (error) { std::rethrow_exception(error); }
+  }
+
+  template<typename R> auto element(std::ranges::iterator_t<R> first, size_t index) -> decltype(auto)
+  {
+    return first[static_cast<std::ranges::range_difference_t<R>>(index)];
+  }
+
+}// namespace detail
+
+/**
+ * @brief Calls fn(i) for every i in [first, last) on @p pool and the calling
+ * thread, and returns once all calls have finished.
+ *
+ * @p grain is the number of indices per chunk; 0 picks one from the range
+ * size and the pool size. May be called from inside a task: the caller runs
+ * chunks itself rather than waiting for a free worker. The first exception
+ * thrown by fn is rethrown here; chunks not yet started are skipped.
+ */
+template<std::integral Index, typename Fn>
+  requires std::invocable<Fn &, Index>
+void parallel_for(ThreadPool &pool, Index first, std::type_identity_t<Index> last, Fn &&fn, size_t grain = 0)
+{
+  size_t count = last > first ? static_cast<size_t>(last - first) : 0;
+  detail::Chunking chunking(count, grain, pool.size() + 1);
+  detail::run_chunks(pool, chunking, [&fn, first](size_t /*chunk*/, size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) { fn(static_cast<Index>(first + static_cast<Index>(i))); }
+  });
+}
+
+/**
+ * @brief Calls fn(element) for every element of @p range, see the index
+ * overload.
+ */
+template<std::ranges::random_access_range R, typename Fn>
+  requires std::ranges::sized_range<R> && std::invocable<Fn &, std::ranges::range_reference_t<R>>
+void parallel_for(ThreadPool &pool, R &&range, Fn &&fn, size_t grain = 0)
+{
+  auto first = std::ranges::begin(range);
+  detail::Chunking chunking(std::ranges::size(range), grain, pool.size() + 1);
+  detail::run_chunks(pool, chunking, [&fn, first](size_t /*chunk*/, size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) { fn(detail::element<R>(first, i)); }
+  });
+}
+
+/**
+ * @brief Writes fn(element) for every element of @p range to @p out, in order.
+ * @return The end of the output range.
+ */
+template<std::ranges::random_access_range R, std::random_access_iterator Out, typename Fn>
+  requires std::ranges::sized_range<R> && std::invocable<Fn &, std::ranges::range_reference_t<R>>
+Out parallel_transform(ThreadPool &pool, R &&range, Out out, Fn &&fn, size_t grain = 0)
+{
+  auto first = std::ranges::begin(range);
+  detail::Chunking chunking(std::ranges::size(range), grain, pool.size() + 1);
+  detail::run_chunks(pool, chunking, [&fn, first, out](size_t /*chunk*/, size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      out[static_cast<std::iter_difference_t<Out>>(i)] = fn(detail::element<R>(first, i));
+    }
+  });
+  return out + static_cast<std::iter_difference_t<Out>>(chunking.count);
+}
+
+/**
+ * @brief Folds @p range with @p reduce, which must be associative; like
+ * std::reduce, it need not be commutative and @p init is used exactly once.
+ *
+ * Every chunk is folded left to right into a partial result, starting from
+ * its first element. The partials are then combined pairwise in a balanced
+ * tree, in chunk order, so the result does not depend on which thread ran
+ * which chunk, and floating point sums lose less precision than a serial fold.
+ */
+template<std::ranges::random_access_range R, typename T, typename Reduce = std::plus<>>
+  requires std::ranges::sized_range<R>
+T parallel_reduce(ThreadPool &pool, R &&range, T init, Reduce reduce = {}, size_t grain = 0)
+{
+  auto first = std::ranges::begin(range);
+  detail::Chunking chunking(std::ranges::size(range), grain, pool.size() + 1);
+  if (chunking.count == 0) { return init; }
+
+  std::vector<std::optional<T>> partials(chunking.chunks);
+  detail::run_chunks(pool, chunking, [&reduce, &partials, first](size_t chunk, size_t begin, size_t end) {
+    T partial(detail::element<R>(first, begin));
+    for (size_t i = begin + 1; i < end; i++) { partial = reduce(std::move(partial), detail::element<R>(first, i)); }
+    partials[chunk].emplace(std::move(partial));
+  });
+
+  for (size_t stride = 1; stride < partials.size(); stride *= 2) {
+    for (size_t i = 0; i + stride < partials.size(); i += 2 * stride) {
+      partials[i] = reduce(std::move(*partials[i]), std::move(*partials[i + stride]));
+    }
+  }
+  return reduce(std::move(init), std::move(*partials.front()));
+}
+
+}// namespace threadpool
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <memory_resource>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace threadpool {
+
+/**
+ * @brief Process-wide pooled memory for task storage: future shared states,
+ * closures too large for Task's inline buffer and work-stealing task nodes.
+ *
+ * A thread-safe SlabAllocator with per-thread caches, so steady-state task
+ * submission never reaches malloc. It is never destroyed; memory handed out
+ * stays valid however late the last task finishes.
+ */
+std::pmr::memory_resource *task_resource() noexcept;
+
+/**
+ * @brief Move-only void() callable with a small inline buffer.
+ *
+ * Callables of up to kInlineSize bytes that are nothrow move constructible
+ * are stored inline, so wrapping a typical closure does not allocate; larger
+ * ones are placed in task_resource(). Unlike std::function the callable does
+ * not need to be copyable, so it can own a Promise or a unique_ptr.
+ *
+ * Trivially copyable callables are relocated with a memcpy of the buffer.
+ * A Task is 64 bytes, one cache line.
+ */
+class Task
+{
+public:
+  static constexpr size_t kInlineSize = 48;
+
+  template<typename F>
+  static constexpr bool stores_inline = sizeof(F) <= kInlineSize && alignof(F) <= alignof(std::max_align_t)
+                                        && std::is_nothrow_move_constructible_v<F>;
+
+  Task() noexcept = default;
+
+  template<typename F>
+    requires(!std::is_same_v<std::remove_cvref_t<F>, Task> && std::is_invocable_v<std::decay_t<F> &>)
+  Task(F &&fn)// implicit, like std::function
+  {
+    using Fn = std::decay_t<F>;
+    if constexpr (stores_inline<Fn>) {
+      ::new (static_cast<void *>(m_storage)) Fn(std::forward<F>(fn));
+    } else {
+      std::pmr::polymorphic_allocator<Fn> alloc(task_resource());
+      Fn *heap = alloc.allocate(1);
+      try {
+        ::new (static_cast<void *>(heap)) Fn(std::forward<F>(fn));
+      } catch (...) {
+        alloc.deallocate(heap, 1);
+        throw;
+      }
+      ::new (static_cast<void *>(m_storage)) Fn *(heap);
+    }
+    m_ops = &kOps<Fn>;
+  }
+
+  Task(Task &&other) noexcept : m_ops(other.m_ops)
+  {
+    if (m_ops != nullptr) {
+      relocate(other.m_storage, m_storage);
+      other.m_ops = nullptr;
+    }
+  }
+
+  Task &operator=(Task &&other) noexcept
+  {
+    if (this != &other) {
+      reset();
+      m_ops = other.m_ops;
+      if (m_ops != nullptr) {
+        relocate(other.m_storage, m_storage);
+        other.m_ops = nullptr;
+      }
+    }
+    return *this;
+  }
+
+  Task(const Task &) = delete;
+  Task &operator=(const Task &) = delete;
+
+  ~Task() { reset(); }
+
+  explicit operator bool() const noexcept { return m_ops != nullptr; }
+
+  /**
+   * @brief Runs the callable.
+   * @note The Task must not be empty.
+   */
+  void operator()() { m_ops->invoke(m_storage); }
+
+  void reset() noexcept
+  {
+    if (m_ops != nullptr) {
+      if (m_ops->destroy != nullptr) { m_ops->destroy(m_storage); }
+      m_ops = nullptr;
+    }
+  }
+
+private:
+  // relocate and destroy are null when a memcpy, respectively nothing, will do.
+  struct Ops
+  {
+    void (*invoke)(void *storage);
+    void (*relocate)(void *from, void *to) noexcept;
+    void (*destroy)(void *storage) noexcept;
+  };
+
+  template<typename Fn> static constexpr Ops make_ops() noexcept
+  {
+    if constexpr (stores_inline<Fn>) {
+      constexpr bool trivial = std::is_trivially_copyable_v<Fn>;
+      return { [](void *storage) { std::invoke(*std::launder(static_cast<Fn *>(storage))); },
+        trivial ? nullptr
+                : +[](void *from, void *to) noexcept {
+                    Fn *source = std::launder(static_cast<Fn *>(from));
+                    ::new (to) Fn(std::move(*source));
+                    source->~Fn();
+                  },
+        std::is_trivially_destructible_v<Fn>
+          ? nullptr
+          : +[](void *storage) noexcept { std::launder(static_cast<Fn *>(storage))->~Fn(); } };
+    } else {
+      return { [](void *storage) { std::invoke(**std::launder(static_cast<Fn **>(storage))); },
+        nullptr,
+        [](void *storage) noexcept {
+          Fn *heap = *std::launder(static_cast<Fn **>(storage));
+          heap->~Fn();
+          std::pmr::polymorphic_allocator<Fn>(task_resource()).deallocate(heap, 1);
+        } };
+    }
+  }
+
+  template<typename Fn> static constexpr Ops kOps = make_ops<Fn>();
+
+  void relocate(void *from, void *to) noexcept
+  {
+    if (m_ops->relocate != nullptr) {
+      m_ops->relocate(from, to);
+    } else {
+      std::memcpy(to, from, kInlineSize);
+    }
+  }
+
+  alignas(std::max_align_t) std::byte m_storage[kInlineSize];
+  const Ops *m_ops = nullptr;
+};
+
+}// namespace threadpool
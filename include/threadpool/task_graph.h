@@ -0,0 +1,130 @@
+#pragma once
+
+#include "threadpool/task.h"
+#include "threadpool/threadpool.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <initializer_list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace threadpool {
+
+/**
+ * @brief Dependency graph of tasks, built once and run on a ThreadPool any
+ * number of times.
+ *
+ * Every node counts its unfinished predecessors in an atomic. A finishing node
+ * decrements its successors' counters and releases the ones that reach zero
+ * straight onto the pool; the last one released it runs itself, so a chain
+ * of nodes runs on one worker without a trip through the queue. Nothing ever
+ * blocks on another node.
+ *
+ * A node resets its own counter when it starts, so running the graph again
+ * costs nothing beyond scheduling the roots. Each run records when every
+ * node started and finished.
+ *
+ * @note The graph must not be modified or run again while a run is in progress.
+ */
+class TaskGraph
+{
+public:
+  using NodeId = size_t;
+
+  /**
+   * @brief When a node ran during the last run, relative to the start of run().
+   */
+  struct NodeTiming
+  {
+    std::chrono::nanoseconds start{ 0 };
+    std::chrono::nanoseconds end{ 0 };
+
+    std::chrono::nanoseconds duration() const noexcept { return end - start; }
+  };
+
+  TaskGraph() = default;
+  TaskGraph(const TaskGraph &) = delete;
+  TaskGraph &operator=(const TaskGraph &) = delete;
+
+  /**
+   * @brief Adds a node that runs @p work once all of @p predecessors have finished.
+   * @throws std::invalid_argument if a predecessor does not exist.
+   */
+  NodeId add(Task work, std::initializer_list<NodeId> predecessors = {}, std::string name = {});
+
+  /**
+   * @brief Makes @p after wait for @p before.
+   * @throws std::invalid_argument if either node does not exist.
+   */
+  void precede(NodeId before, NodeId after);
+
+  /**
+   * @brief Runs every node on @p pool and returns once all have finished.
+   *
+   * The calling thread runs one of the roots itself, then queued tasks of the
+   * pool until the graph is done, so a task may run a graph on its own pool.
+   * After a node throws, or a node cannot be queued, the nodes that have not
+   * started yet are skipped, and the first exception is rethrown here once
+   * the nodes already running have finished.
+   *
+   * @throws std::invalid_argument if the graph has a cycle.
+   */
+  void run(ThreadPool &pool);
+
+  size_t size() const noexcept { return m_nodes.size(); }
+  std::string_view name(NodeId node) const { return m_nodes.at(node).name; }
+  NodeTiming timing(NodeId node) const { return m_nodes.at(node).timing; }
+
+  /**
+   * @brief Wall time of the last run.
+   */
+  std::chrono::nanoseconds elapsed() const noexcept { return m_elapsed; }
+
+private:
+  struct Node
+  {
+    Task work;
+    std::string name;
+    std::vector<NodeId> successors;
+    uint32_t predecessor_count = 0;
+    std::atomic<uint32_t> pending{ 0 };// predecessors still running in this run
+    NodeTiming timing;
+  };
+
+  static constexpr NodeId kNone = static_cast<NodeId>(-1);
+
+  std::deque<Node> m_nodes;// node addresses stay put as the graph grows
+  std::vector<NodeId> m_roots;
+  bool m_validated = false;
+
+  // State of the run in progress.
+  ThreadPool *m_pool = nullptr;
+  std::chrono::steady_clock::time_point m_started;
+  std::chrono::nanoseconds m_elapsed{ 0 };
+  std::atomic<size_t> m_remaining{ 0 };
+  std::mutex m_done_mutex;
+  std::condition_variable m_done;
+  bool m_finished = false;// guarded by m_done_mutex
+  std::atomic<bool> m_failed{ false };
+  std::exception_ptr m_error;
+  // Nodes that will not run because a release failed; guarded by m_done_mutex.
+  std::vector<char> m_abandoned;
+  std::vector<NodeId> m_unreached;
+  bool m_any_abandoned = false;
+
+  void validate();
+  void execute(NodeId node);
+  void release(NodeId node) noexcept;
+  void abandon(NodeId node) noexcept;
+  void fail(std::exception_ptr error) noexcept;
+  std::chrono::nanoseconds since_start() const noexcept { return std::chrono::steady_clock::now() - m_started; }
+};
+
+}// namespace threadpool
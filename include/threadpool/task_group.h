@@ -0,0 +1,87 @@
+#pragma once
+
+#include "threadpool/threadpool.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace threadpool {
+
+/**
+ * @brief A batch of tasks on a ThreadPool that is waited for as a whole.
+ *
+ * The group counts its unfinished tasks in one atomic instead of keeping a
+ * future per task; run() does not allocate when the closure fits a Task.
+ * wait() runs queued tasks of the pool while the group is unfinished, so a
+ * task can start a group of its own and wait for it without tying up its
+ * worker. Exceptions thrown by the tasks are collected, not lost.
+ *
+ * The destructor waits as well, so a group on the stack is a scope that
+ * cannot leave tasks behind.
+ */
+class TaskGroup
+{
+public:
+  explicit TaskGroup(ThreadPool &pool) noexcept : m_pool(&pool) {}
+  TaskGroup(const TaskGroup &) = delete;
+  TaskGroup &operator=(const TaskGroup &) = delete;
+
+  /**
+   * @brief Waits for the tasks, dropping their exceptions.
+   */
+  ~TaskGroup() { join(); }
+
+  /**
+   * @brief Queues @p fn on the pool as part of the group. Tasks of the group
+   * may add more tasks to it. If queueing throws, the group does not count
+   * the task and the exception propagates.
+   */
+  template<typename F> void run(F &&fn, ThreadPool::Priority priority = ThreadPool::Priority::normal)
+  {
+    m_pending.fetch_add(1, std::memory_order_relaxed);
+    try {
+      m_pool->submit(priority, [this, fn = std::forward<F>(fn)]() mutable {
+        try {
+          fn();
+        } catch (...) {
+          add_exception(std::current_exception());
+        }
+        finish();
+      });
+    } catch (...) {
+      finish();// the task was never queued; wake join() if it was the last
+      throw;
+    }
+  }
+
+  /**
+   * @brief Waits until every task run so far has finished and returns the
+   * exceptions they threw, in the order they were caught. The group can be
+   * used again afterwards.
+   */
+  std::vector<std::exception_ptr> join();
+
+  /**
+   * @brief Like join(), but rethrows the first exception, if any.
+   */
+  void wait();
+
+  size_t pending() const noexcept { return m_pending.load(std::memory_order_relaxed); }
+
+private:
+  ThreadPool *m_pool;
+  std::atomic<size_t> m_pending{ 0 };
+  std::mutex m_mutex;// guards m_exceptions and the decrement that ends the group
+  std::condition_variable m_done;
+  std::vector<std::exception_ptr> m_exceptions;
+
+  void add_exception(std::exception_ptr error);
+  void finish();
+};
+
+}// namespace threadpool
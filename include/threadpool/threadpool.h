@@ -1,42 +1,306 @@
 #pragma once
 
+#include "threadpool/cpu_topology.h"
+#include "threadpool/future.h"
+#include "threadpool/task.h"
+#include "threadpool/trace.h"
+#include "threadsafequeue/wait_policy.h"
+#include <chrono>
+#include <coroutine>
+#include <exception>
 #include <future>
 #include <functional>
 #include <memory>
+#include <optional>
+#include <string>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 // Forward declared implementation (PIMPL)
 class ThreadPool {
 public:
-  explicit ThreadPool(size_t num_threads);
+  /**
+   * @brief How tasks reach the workers.
+   *
+   * shared_queue:  every worker pops from one shared FIFO queue.
+   * work_stealing: every worker owns a Chase-Lev deque. Tasks enqueued from
+   *                inside a task go to the calling worker's deque and are run
+   *                LIFO by that worker; idle workers steal the oldest tasks
+   *                from random victims. Tasks from other threads, and tasks
+   *                with a priority other than normal, go through the shared
+   *                lane queues.
+   */
+  enum class Scheduling { shared_queue, work_stealing };
+
+  /**
+   * @brief Which lane a task is queued on.
+   *
+   * Each lane is a FIFO queue of its own. Workers serve them by weighted round
+   * robin: out of every 16 picks, 12 try high first, 3 normal and 1 low, and
+   * fall back to the other lanes in priority order when that one is empty. A
+   * high priority task therefore skips everything queued on the other lanes,
+   * while a stream of high priority work still leaves the lower lanes a share.
+   * Tasks a work-stealing worker enqueues at normal priority stay on its deque.
+   */
+  enum class Priority { high, normal, low };
+
+private:
+  // Keeps the overloads without a priority from matching the ones with one.
+  template <typename F>
+  static constexpr bool NotPriority = !std::is_same_v<std::decay_t<F>, Priority>;
+
+public:
+  struct Options {
+    size_t threads = 0;
+    /// Elastic pool when greater than threads: starts threads workers and adds
+    /// more, up to max_threads, while tasks wait; threads is then the minimum.
+    size_t max_threads = 0;
+    /// Add a worker once a queued task, in a priority lane or a worker's
+    /// deque, has waited this long. Also how often an elastic pool samples
+    /// its queues.
+    std::chrono::milliseconds grow_after{ 5 };
+    /// Also add a worker while more than this many tasks are queued; 0 for no limit.
+    size_t grow_depth = 0;
+    /// Retire a worker above the minimum once it has been idle this long.
+    /// Workers retire from the highest index down, so an idle worker stays
+    /// while a busy one above it does.
+    std::chrono::milliseconds idle_timeout{ 10000 };
+    threaded_queue::WaitPolicy wait{};
+    Scheduling scheduling = Scheduling::shared_queue;
+    /// Workers that only run high priority tasks, so those never wait behind
+    /// long running tasks of the other lanes. Must be less than threads.
+    size_t reserved_high = 0;
+    /// Pins worker i to cpus[i % cpus.size()]; overrides layout and numa_node.
+    std::vector<int> cpus{};
+    /// Pins workers to the CPUs this process may use, in this order.
+    threadpool::CpuLayout layout = threadpool::CpuLayout::none;
+    /// Keeps workers on this node's CPUs (laid out per layout), -1 for any node.
+    int numa_node = -1;
+    /// Workers are named "<name>-<index>", as far as 15 characters allow.
+    std::string name = "pool";
+    /// Records every task's enqueue, start and end time, worker and
+    /// threadpool::TraceLabel; see dump_trace() and trace_stats().
+    bool trace = false;
+    /// Most recent tasks kept per worker for dump_trace().
+    size_t trace_capacity = 4096;
+  };
+
+  /**
+   * @brief Where the calling worker thread runs. cpu is -1 when the worker is
+   * not pinned to a single CPU, numa_node when it is not kept on one node.
+   */
+  struct WorkerInfo {
+    size_t index;
+    int cpu;
+    int numa_node;
+  };
+
+  /**
+   * @brief Starts @p num_threads workers; idle workers wait for tasks per @p wait.
+   */
+  explicit ThreadPool(size_t num_threads,
+    threaded_queue::WaitPolicy wait = {},
+    Scheduling scheduling = Scheduling::shared_queue);
+  /**
+   * @brief Starts options.threads workers, placed and named per @p options.
+   *
+   * Pinning and naming are best effort: where the OS refuses them the workers
+   * run unpinned or unnamed.
+   *
+   * With max_threads above threads, a supervisor thread samples the queues
+   * every grow_after and starts or retires workers.
+   *
+   * @throws std::invalid_argument if every worker would be reserved, if one of
+   * cpus is not available to this process, or if numa_node has none.
+   */
+  explicit ThreadPool(const Options& options);
   ~ThreadPool();
   ThreadPool(ThreadPool&&) = default;
   ThreadPool& operator=(ThreadPool&&) = default;
 
+  /**
+   * @brief Number of worker threads. A retired worker may still be finishing
+   * its last task.
+   */
+  size_t size() const noexcept;
+
+  /**
+   * @brief Keeps between @p min_threads and @p max_threads workers, starting
+   * or retiring workers right away to get within bounds. A retiring worker
+   * finishes the task it is running; queued tasks go to the others.
+   *
+   * Growth and idle retirement follow the Options the pool was made with.
+   * The pool has room for max(threads, max_threads) workers at most.
+   *
+   * @throws std::invalid_argument if min_threads > max_threads, if
+   * max_threads exceeds the room the pool has, or if every worker could be
+   * reserved.
+   */
+  void resize(size_t min_threads, size_t max_threads);
+  void resize(size_t threads) { resize(threads, threads); }
+
+  /**
+   * @brief Index and placement of the calling thread when it is a worker of
+   * some ThreadPool, so a task can pick per-worker or node-local data.
+   */
+  static std::optional<WorkerInfo> this_worker() noexcept;
+
+  /**
+   * @brief Returns once no task is queued or running, counting the tasks
+   * that running tasks queue meanwhile. The calling thread runs queued tasks
+   * while it waits instead of sleeping.
+   *
+   * @throws std::logic_error if called from a task of this pool, which could
+   * only wait for itself.
+   */
+  void wait_idle();
+
+  /**
+   * @brief Runs one queued task on the calling thread, if there is one; false
+   * when there is none. Lets threads that wait for pool work, such as
+   * threadpool::TaskGroup::wait, help instead of blocking a worker. As on a
+   * worker, a submitted task that throws terminates the program.
+   */
+  bool run_pending_task();
+
+  /**
+   * @brief Writes the most recent trace_capacity tasks of every worker as
+   * Chrome trace-event JSON, which Perfetto and chrome://tracing load. Tasks
+   * run by threads other than the workers go to a "<name>-external" track.
+   * Without Options::trace the trace is empty.
+   *
+   * Tracing wraps every task, so a traced task takes one pooled allocation
+   * and three clock reads on top of an untraced one.
+   *
+   * @throws std::runtime_error if @p path cannot be written.
+   */
+  void dump_trace(const std::string& path) const;
+
+  /**
+   * @brief Per-worker utilization, and queue wait and run time histograms,
+   * over every task traced since the pool started. Empty without Options::trace.
+   */
+  threadpool::TraceStats trace_stats() const;
+
+  /**
+   * @brief Runs f(args...) on a worker and returns a std::future for the result.
+   *
+   * f and args are decay-copied into a threadpool::Task together with the
+   * promise, so the only allocations left are the ones std::promise makes for
+   * its shared state. Like async and submit, it queues at Priority::normal
+   * unless given a priority first.
+   */
+  template <typename F, typename... Args>
+    requires NotPriority<F>
+  auto enqueue(F&& f, Args&&... args) -> std::future<std::invoke_result_t<F, Args...>> {
+    return enqueue(Priority::normal, std::forward<F>(f), std::forward<Args>(args)...);
+  }
+  template <typename F, typename... Args>
+  auto enqueue(Priority priority, F&& f, Args&&... args) -> std::future<std::invoke_result_t<F, Args...>>;
+
+  /**
+   * @brief Like enqueue, but returns a threadpool::Future whose shared state is
+   * pooled; submission does not allocate once the pools have warmed up.
+   */
+  template <typename F, typename... Args>
+    requires NotPriority<F>
+  auto async(F&& f, Args&&... args) -> threadpool::Future<std::invoke_result_t<F, Args...>> {
+    return async(Priority::normal, std::forward<F>(f), std::forward<Args>(args)...);
+  }
+  template <typename F, typename... Args>
+  auto async(Priority priority, F&& f, Args&&... args) -> threadpool::Future<std::invoke_result_t<F, Args...>>;
+
+  /**
+   * @brief Fire-and-forget: runs f(args...) on a worker without any future.
+   * @note An exception escaping f terminates the program, as on a std::thread.
+   */
   template <typename F, typename... Args>
-  auto enqueue(F&& f, Args&&... args) -> std::future<std::invoke_result_t<F, Args...>>;
+    requires NotPriority<F>
+  void submit(F&& f, Args&&... args) {
+    submit(Priority::normal, std::forward<F>(f), std::forward<Args>(args)...);
+  }
+  template <typename F, typename... Args>
+  void submit(Priority priority, F&& f, Args&&... args);
+
+  /**
+   * @brief Awaitable returned by schedule(); resumes the awaiting coroutine on a worker.
+   */
+  class ScheduleAwaiter {
+  public:
+    explicit ScheduleAwaiter(ThreadPool* pool) noexcept : m_pool(pool) {}
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> handle) { m_pool->submit([handle] { handle.resume(); }); }
+    void await_resume() const noexcept {}
+
+  private:
+    ThreadPool* m_pool;
+  };
+
+  /**
+   * @brief `co_await pool.schedule();` moves the rest of a coroutine onto a
+   * worker. See threadpool/coroutine.h for task<T>, when_all and sync_wait.
+   */
+  ScheduleAwaiter schedule() noexcept { return ScheduleAwaiter(this); }
 
 private:
   class Impl;                 // hidden implementation
   std::unique_ptr<Impl> m_pimpl; // owning pointer
-  void enqueue_wrapper(std::function<void()> fn);
+  void enqueue_wrapper(threadpool::Task task, Priority priority);
+
+  // Decay-copies f and args into a closure that invokes them once. Like
+  // std::bind, it passes the stored copies as lvalues, so f may take T&.
+  template <typename F, typename... Args>
+  static auto bind_call(F&& f, Args&&... args) {
+    return [fn = std::forward<F>(f), ... bound = std::forward<Args>(args)]() mutable -> decltype(auto) {
+      return std::invoke(fn, bound...);
+    };
+  }
+
+  // Works for std::promise and threadpool::Promise alike.
+  template <typename Promise, typename Call>
+  static void fulfil(Promise& promise, Call& call) {
+    try {
+      if constexpr (std::is_void_v<decltype(call())>) {
+        call();
+        promise.set_value();
+      } else {
+        promise.set_value(call());
+      }
+    } catch (...) {
+      promise.set_exception(std::current_exception());
+    }
+  }
 };
 
-// Inline template definition must live in the header for visibility
+// Inline template definitions must live in the header for visibility
 template <typename F, typename... Args>
-auto ThreadPool::enqueue(F&& f, Args&&... args) -> std::future<std::invoke_result_t<F, Args...>> {
-  using return_type = std::invoke_result_t<F, Args...>;
-  // Wrap the callable + bound arguments into a packaged_task producing return_type
-  auto task = std::make_shared<std::packaged_task<return_type()>>(
-      std::bind(std::forward<F>(f), std::forward<Args>(args)...));
-
-  auto fut = task->get_future();
-  // Delegate queuing to the implementation; it will schedule the void() wrapper.
-  // We capture the shared_ptr so the packaged_task lifetime extends until execution.
-  // Friend-like accessor: implemented in the .cpp after Impl is complete.
-  enqueue_wrapper([task]{ (*task)(); });
+auto ThreadPool::enqueue(Priority priority, F&& f, Args&&... args) -> std::future<std::invoke_result_t<F, Args...>> {
+  std::promise<std::invoke_result_t<F, Args...>> promise;
+  auto fut = promise.get_future();
+  enqueue_wrapper([promise = std::move(promise),
+                   call = bind_call(std::forward<F>(f), std::forward<Args>(args)...)]() mutable {
+    fulfil(promise, call);
+  }, priority);
   return fut;
 }
 
+template <typename F, typename... Args>
+auto ThreadPool::async(Priority priority, F&& f, Args&&... args) -> threadpool::Future<std::invoke_result_t<F, Args...>> {
+  threadpool::Promise<std::invoke_result_t<F, Args...>> promise;
+  auto fut = promise.get_future();
+  enqueue_wrapper([promise = std::move(promise),
+                   call = bind_call(std::forward<F>(f), std::forward<Args>(args)...)]() mutable {
+    fulfil(promise, call);
+  }, priority);
+  return fut;
+}
 
+template <typename F, typename... Args>
+void ThreadPool::submit(Priority priority, F&& f, Args&&... args) {
+  if constexpr (sizeof...(Args) == 0) {
+    enqueue_wrapper(std::forward<F>(f), priority);
+  } else {
+    enqueue_wrapper(bind_call(std::forward<F>(f), std::forward<Args>(args)...), priority);
+  }
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+#include "threadsafequeue/queue_stats.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace threadpool {
+
+/**
+ * @brief One task run, as recorded by a TraceRecorder. Times are nanoseconds
+ * since the recorder was created; worker is the index of the ring it went to.
+ */
+struct TraceEvent
+{
+  int64_t enqueued = 0;
+  int64_t start = 0;
+  int64_t end = 0;
+  size_t worker = 0;
+  const char *label = nullptr;
+};
+
+/**
+ * @brief Totals over every event a TraceRecorder has recorded, including the
+ * ones its rings have since overwritten. Histograms use the log buckets of
+ * threaded_queue::QueueStatsSnapshot.
+ */
+struct TraceStats
+{
+  using Histogram = std::array<uint64_t, threaded_queue::QueueStatsSnapshot::kLatencyBuckets>;
+
+  struct Worker
+  {
+    uint64_t tasks = 0;
+    std::chrono::nanoseconds busy{ 0 };
+    double utilization = 0;// busy / elapsed
+  };
+
+  std::chrono::nanoseconds elapsed{ 0 };// since the recorder was created
+  std::vector<Worker> workers;// one per ring
+  Histogram queue_wait_ns{};// enqueue to start
+  Histogram run_ns{};// start to end
+
+  uint64_t queue_wait_percentile_ns(double fraction) const noexcept
+  {
+    return threaded_queue::QueueStatsSnapshot::percentile(queue_wait_ns, fraction);
+  }
+  uint64_t run_percentile_ns(double fraction) const noexcept
+  {
+    return threaded_queue::QueueStatsSnapshot::percentile(run_ns, fraction);
+  }
+};
+
+/**
+ * @brief Labels the tasks the calling thread enqueues on a tracing ThreadPool
+ * for as long as it lives. Labels nest; the innermost one applies.
+ *
+ * Only the pointer is stored, so @p label must outlive every trace the tasks
+ * end up in; a string literal is the usual choice.
+ */
+class TraceLabel
+{
+public:
+  explicit TraceLabel(const char *label) noexcept;
+  ~TraceLabel();
+  TraceLabel(const TraceLabel &) = delete;
+  TraceLabel &operator=(const TraceLabel &) = delete;
+
+  /**
+   * @brief The calling thread's innermost label, or nullptr.
+   */
+  static const char *current() noexcept;
+
+private:
+  const char *m_previous;
+};
+
+/**
+ * @brief Fixed-size rings of the most recent TraceEvents, one ring per
+ * worker, plus running totals for TraceStats.
+ *
+ * record() is lock-free: it claims a slot with one fetch_add on the ring's
+ * head and guards it with a sequence number, so events() can copy the rings
+ * while workers keep recording and skips slots that are being overwritten.
+ * A ring is normally written by one thread; several writers are safe, they
+ * just share the head's cache line.
+ */
+class TraceRecorder
+{
+public:
+  /**
+   * @brief @p capacity events per ring, rounded up to a power of two.
+   */
+  TraceRecorder(size_t rings, size_t capacity);
+
+  size_t rings() const noexcept { return m_rings.size(); }
+
+  /**
+   * @brief Nanoseconds since the recorder was created, for TraceEvent times.
+   */
+  int64_t now() const noexcept
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_epoch).count();
+  }
+
+  /**
+   * @brief Records @p event in ring event.worker, which must be below rings().
+   */
+  void record(const TraceEvent &event) noexcept;
+
+  /**
+   * @brief The events still in the rings, ordered by start time.
+   */
+  std::vector<TraceEvent> events() const;
+
+  TraceStats stats() const;
+
+  /**
+   * @brief Writes events() as Chrome trace-event JSON, one complete ("X")
+   * event per task on the track of its worker, for Perfetto or
+   * chrome://tracing. @p thread_names names the tracks, one per ring.
+   */
+  void write_chrome_json(std::ostream &out, const std::vector<std::string> &thread_names) const;
+
+private:
+  struct Slot
+  {
+    std::atomic<uint64_t> sequence{ 0 };// odd while written, 2 * (index + 1) once complete
+    std::atomic<int64_t> enqueued{ 0 };
+    std::atomic<int64_t> start{ 0 };
+    std::atomic<int64_t> end{ 0 };
+    std::atomic<const char *> label{ nullptr };
+  };
+
+  struct alignas(64) Ring
+  {
+    std::atomic<uint64_t> head{ 0 };
+    std::atomic<uint64_t> tasks{ 0 };
+    std::atomic<int64_t> busy_ns{ 0 };
+    std::array<std::atomic<uint64_t>, threaded_queue::QueueStatsSnapshot::kLatencyBuckets> queue_wait_ns{};
+    std::array<std::atomic<uint64_t>, threaded_queue::QueueStatsSnapshot::kLatencyBuckets> run_ns{};
+    std::unique_ptr<Slot[]> slots;
+  };
+
+  std::chrono::steady_clock::time_point m_epoch;
+  size_t m_capacity;
+  std::vector<Ring> m_rings;
+};
+
+}// namespace threadpool
@@ -0,0 +1,263 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+
+namespace threaded_queue {
+
+/**
+ * @brief Bounded lock-free multi-producer multi-consumer queue.
+ *
+ * A ring of cells, each carrying a sequence number (Dmitry Vyukov's bounded
+ * MPMC queue). A producer claims a slot by advancing the enqueue position
+ * with a CAS and publishes the value by bumping the cell's sequence; consumers
+ * do the same on the dequeue side. Producers and consumers never touch the
+ * same cache line unless they work on the same cell, and there is no lock on
+ * the hot path.
+ *
+ * The surface matches ThreadSafeQueue so the two can be swapped. The
+ * differences come from the bound: push() waits for space when the queue is
+ * full, and try_push() fails instead. Blocked threads sleep on a condition
+ * variable that is only touched when someone is actually waiting.
+ *
+ * @note Capacity is rounded up to a power of two.
+ * @note All operations are thread-safe and can be called concurrently.
+ */
+template<typename F, typename Deleter = std::default_delete<F>>
+class BoundedMPMCQueue
+{
+public:
+  using pointer_type = std::unique_ptr<F, Deleter>;
+  using value_type = pointer_type;
+
+  explicit BoundedMPMCQueue(size_t capacity);
+  BoundedMPMCQueue(const BoundedMPMCQueue &) = delete;
+  BoundedMPMCQueue &operator=(const BoundedMPMCQueue &) = delete;
+
+  /**
+   * @brief Pushes @p item, waiting for space while the queue is full.
+   * @return false if the queue was shut down while waiting; the item is then
+   * destroyed.
+   */
+  bool push(pointer_type item);
+
+  /**
+   * @brief Pushes @p item if there is space.
+   * @return false if the queue is full, @p item is left untouched.
+   */
+  bool try_push(pointer_type &item);
+
+  std::optional<pointer_type> try_pop();
+
+  /**
+   * @brief Pops an item, waiting while the queue is empty.
+   * @return std::nullopt once the queue is shut down and drained.
+   */
+  std::optional<pointer_type> wait_and_pop();
+
+  /**
+   * @brief Approximate number of items; exact when no push/pop is in flight.
+   */
+  size_t size() const;
+  bool empty() const;
+  size_t capacity() const noexcept { return m_mask + 1; }
+  void shutdown();
+
+private:
+  struct alignas(64) Cell
+  {
+    std::atomic<size_t> sequence;
+    pointer_type value;
+  };
+
+  // push/wait_and_pop retry this many times, yielding in between, before they
+  // go to sleep; a short wait is much cheaper than a condition variable round trip.
+  static constexpr int kSpinAttempts = 16;
+
+  static size_t checked_capacity(size_t capacity)
+  {
+    if (capacity == 0) { throw std::invalid_argument("BoundedMPMCQueue capacity must be non-zero"); }
+    return std::bit_ceil(capacity);
+  }
+
+  bool enqueue(pointer_type &item);
+  bool dequeue(pointer_type &item);
+  void wake(std::atomic<int> &sleepers, std::condition_variable &cond);
+
+  std::unique_ptr<Cell[]> m_cells;
+  size_t m_mask = 0;
+  alignas(64) std::atomic<size_t> m_enqueue_pos{ 0 };
+  alignas(64) std::atomic<size_t> m_dequeue_pos{ 0 };
+
+  // Slow path only: threads that found the queue empty/full and went to sleep.
+  alignas(64) std::atomic<bool> m_shutdown{ false };
+  std::atomic<int> m_sleeping_consumers{ 0 };
+  std::atomic<int> m_sleeping_producers{ 0 };
+  std::mutex m_mutex;
+  std::condition_variable m_not_empty;
+  std::condition_variable m_not_full;
+};
+
+// Template implementation
+template<typename F, typename Deleter>
+BoundedMPMCQueue<F, Deleter>::BoundedMPMCQueue(size_t capacity)
+  : m_cells(new Cell[checked_capacity(capacity)]), m_mask(checked_capacity(capacity) - 1)
+{
+  for (size_t i = 0; i <= m_mask; i++) { m_cells[i].sequence.store(i, std::memory_order_relaxed); }
+}
+
+template<typename F, typename Deleter>
+bool BoundedMPMCQueue<F, Deleter>::enqueue(pointer_type &item)
+{
+  size_t pos = m_enqueue_pos.load(std::memory_order_relaxed);
+  while (true) {
+    Cell &cell = m_cells[pos & m_mask];
+    size_t sequence = cell.sequence.load(std::memory_order_seq_cst);
+    auto diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+    if (diff == 0) {
+      if (m_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+        cell.value = std::move(item);
+        cell.sequence.store(pos + 1, std::memory_order_seq_cst);
+        return true;
+      }
+    } else if (diff < 0) {
+      return false;// full: the cell still holds the item from one lap ago
+    } else {
+      pos = m_enqueue_pos.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+template<typename F, typename Deleter>
+bool BoundedMPMCQueue<F, Deleter>::dequeue(pointer_type &item)
+{
+  size_t pos = m_dequeue_pos.load(std::memory_order_relaxed);
+  while (true) {
+    Cell &cell = m_cells[pos & m_mask];
+    size_t sequence = cell.sequence.load(std::memory_order_seq_cst);
+    auto diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+    if (diff == 0) {
+      if (m_dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+        item = std::move(cell.value);
+        cell.sequence.store(pos + m_mask + 1, std::memory_order_seq_cst);
+        return true;
+      }
+    } else if (diff < 0) {
+      return false;// empty
+    } else {
+      pos = m_dequeue_pos.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+// Called after a successful enqueue/dequeue. The cell sequence store, the load
+// of sleepers below, the sleeper's increment and its re-check of the cell are
+// all seq_cst: either we see the sleeper, or the sleeper's re-check under the
+// mutex sees our update. Taking the mutex before notifying closes the gap
+// between that re-check and the sleeper blocking.
+template<typename F, typename Deleter>
+void BoundedMPMCQueue<F, Deleter>::wake(std::atomic<int> &sleepers, std::condition_variable &cond)
+{
+  if (sleepers.load(std::memory_order_seq_cst) > 0) {
+    { auto lock = std::lock_guard(m_mutex); }
+    cond.notify_one();
+  }
+}
+
+template<typename F, typename Deleter>
+bool BoundedMPMCQueue<F, Deleter>::try_push(pointer_type &item)
+{
+  if (!enqueue(item)) { return false; }
+  wake(m_sleeping_consumers, m_not_empty);
+  return true;
+}
+
+template<typename F, typename Deleter>
+bool BoundedMPMCQueue<F, Deleter>::push(pointer_type item)
+{
+  for (int attempt = 0; attempt < kSpinAttempts; attempt++) {
+    if (try_push(item)) { return true; }
+    std::this_thread::yield();
+  }
+
+  m_sleeping_producers.fetch_add(1, std::memory_order_seq_cst);
+  bool pushed = false;
+  {
+    auto lock = std::unique_lock(m_mutex);
+    m_not_full.wait(lock, [&] {
+      pushed = enqueue(item);
+      return pushed || m_shutdown.load(std::memory_order_relaxed);
+    });
+  }
+  m_sleeping_producers.fetch_sub(1, std::memory_order_relaxed);
+  if (pushed) { wake(m_sleeping_consumers, m_not_empty); }
+  return pushed;
+}
+
+template<typename F, typename Deleter>
+auto BoundedMPMCQueue<F, Deleter>::try_pop() -> std::optional<pointer_type>
+{
+  pointer_type item;
+  if (!dequeue(item)) { return std::nullopt; }
+  wake(m_sleeping_producers, m_not_full);
+  return item;
+}
+
+template<typename F, typename Deleter>
+auto BoundedMPMCQueue<F, Deleter>::wait_and_pop() -> std::optional<pointer_type>
+{
+  for (int attempt = 0; attempt < kSpinAttempts; attempt++) {
+    if (auto item = try_pop()) { return item; }
+    std::this_thread::yield();
+  }
+
+  pointer_type item;
+  bool popped = false;
+  m_sleeping_consumers.fetch_add(1, std::memory_order_seq_cst);
+  {
+    auto lock = std::unique_lock(m_mutex);
+    m_not_empty.wait(lock, [&] {
+      popped = dequeue(item);
+      return popped || m_shutdown.load(std::memory_order_relaxed);
+    });
+  }
+  m_sleeping_consumers.fetch_sub(1, std::memory_order_relaxed);
+  if (!popped) { return std::nullopt; }
+  wake(m_sleeping_producers, m_not_full);
+  return item;
+}
+
+template<typename F, typename Deleter>
+size_t BoundedMPMCQueue<F, Deleter>::size() const
+{
+  size_t tail = m_dequeue_pos.load(std::memory_order_acquire);
+  size_t head = m_enqueue_pos.load(std::memory_order_acquire);
+  return head > tail ? std::min(head - tail, m_mask + 1) : 0;
+}
+
+template<typename F, typename Deleter>
+bool BoundedMPMCQueue<F, Deleter>::empty() const
+{
+  return size() == 0;
+}
+
+template<typename F, typename Deleter>
+void BoundedMPMCQueue<F, Deleter>::shutdown()
+{
+  {
+    auto lock = std::lock_guard(m_mutex);
+    m_shutdown.store(true, std::memory_order_relaxed);
+  }
+  m_not_empty.notify_all();
+  m_not_full.notify_all();
+}
+}// namespace threaded_queue
@@ -0,0 +1,217 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace threaded_queue {
+
+/**
+ * @brief Point-in-time copy of a queue's statistics, safe to keep and compare.
+ *
+ * Latencies are counted in HDR-style log buckets: every power of two is split
+ * into kSubBuckets linear buckets, so a bucket's width is at most 25% of its
+ * lower bound whatever the magnitude.
+ */
+struct QueueStatsSnapshot
+{
+  static constexpr unsigned kSubBucketBits = 2;
+  static constexpr size_t kSubBuckets = size_t{ 1 } << kSubBucketBits;
+  static constexpr size_t kLatencyBuckets = (64 - kSubBucketBits + 1) * kSubBuckets;
+
+  uint64_t enqueued = 0;
+  uint64_t dequeued = 0;
+  uint64_t dropped = 0;// discarded by OverflowPolicy::drop_oldest
+  uint64_t high_water = 0;// largest depth seen
+  uint64_t lock_waits = 0;// lock acquisitions that found the mutex taken
+  std::array<uint64_t, kLatencyBuckets> latency_ns{};// enqueue to dequeue
+
+  uint64_t depth() const noexcept { return enqueued - dequeued - dropped; }
+
+  static constexpr size_t bucket_of(uint64_t ns) noexcept
+  {
+    if (ns < kSubBuckets) { return ns; }
+    auto exponent = static_cast<unsigned>(std::bit_width(ns)) - 1;
+    size_t sub = (ns >> (exponent - kSubBucketBits)) & (kSubBuckets - 1);
+    return ((exponent - kSubBucketBits + 1) << kSubBucketBits) + sub;
+  }
+
+  /**
+   * @brief Smallest latency that falls into @p bucket.
+   */
+  static constexpr uint64_t bucket_floor(size_t bucket) noexcept
+  {
+    if (bucket < kSubBuckets) { return bucket; }
+    auto exponent = static_cast<unsigned>(bucket >> kSubBucketBits) + kSubBucketBits - 1;
+    return (kSubBuckets + (bucket & (kSubBuckets - 1))) << (exponent - kSubBucketBits);
+  }
+
+  /**
+   * @brief Latency below which @p fraction (0..1) of the dequeued items fall,
+   * reported as the floor of the bucket it lands in; 0 when nothing was dequeued.
+   */
+  uint64_t latency_percentile_ns(double fraction) const noexcept { return percentile(latency_ns, fraction); }
+
+  /**
+   * @brief The same for any histogram bucketed by bucket_of.
+   */
+  static uint64_t percentile(const std::array<uint64_t, kLatencyBuckets> &histogram, double fraction) noexcept
+  {
+    uint64_t total = 0;
+    for (uint64_t count : histogram) { total += count; }
+    if (total == 0) { return 0; }
+    auto rank = static_cast<uint64_t>(fraction * static_cast<double>(total - 1));
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < kLatencyBuckets; bucket++) {
+      seen += histogram[bucket];
+      if (seen > rank) { return bucket_floor(bucket); }
+    }
+    return bucket_floor(kLatencyBuckets - 1);
+  }
+};
+
+/**
+ * @brief Statistics recorder for the queues, chosen as a template argument.
+ *
+ * Counters are relaxed atomics spread over kShards cache-line sized shards;
+ * each thread sticks to one shard, so threads rarely share a counter line.
+ * snapshot() sums the shards without stopping the queue, so a snapshot taken
+ * while items move may be off by the operations in flight.
+ *
+ * The recording calls are made by the queue; users only call snapshot(),
+ * usually through the queue's stats().
+ */
+class QueueStats
+{
+public:
+  static constexpr bool enabled = true;
+  static constexpr size_t kShards = 16;
+
+  QueueStats() = default;
+
+  // Copies take the counters as they are, so a queue that owns its stats
+  // stays movable; the source must not be recording at the time.
+  QueueStats(const QueueStats &other) noexcept { *this = other; }
+  QueueStats &operator=(const QueueStats &other) noexcept;
+
+  /**
+   * @brief Enqueue time, stored next to every queued item.
+   */
+  struct Stamp
+  {
+    std::chrono::steady_clock::time_point at;
+  };
+
+  static Stamp now() noexcept { return { std::chrono::steady_clock::now() }; }
+
+  void on_enqueue(size_t depth, uint64_t count = 1) noexcept
+  {
+    shard().enqueued.fetch_add(count, std::memory_order_relaxed);
+    uint64_t high = m_high_water.load(std::memory_order_relaxed);
+    while (depth > high && !m_high_water.compare_exchange_weak(high, depth, std::memory_order_relaxed)) {}
+  }
+
+  void on_dequeue(const Stamp &stamp) noexcept
+  {
+    auto waited = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - stamp.at);
+    Shard &own = shard();
+    own.dequeued.fetch_add(1, std::memory_order_relaxed);
+    own.latency_ns[QueueStatsSnapshot::bucket_of(static_cast<uint64_t>(waited.count()))].fetch_add(
+      1, std::memory_order_relaxed);
+  }
+
+  void on_drop() noexcept { shard().dropped.fetch_add(1, std::memory_order_relaxed); }
+  void on_lock_wait() noexcept { shard().lock_waits.fetch_add(1, std::memory_order_relaxed); }
+
+  QueueStatsSnapshot snapshot() const noexcept
+  {
+    QueueStatsSnapshot result;
+    for (const Shard &each : m_shards) {
+      result.enqueued += each.enqueued.load(std::memory_order_relaxed);
+      result.dequeued += each.dequeued.load(std::memory_order_relaxed);
+      result.dropped += each.dropped.load(std::memory_order_relaxed);
+      result.lock_waits += each.lock_waits.load(std::memory_order_relaxed);
+      for (size_t bucket = 0; bucket < QueueStatsSnapshot::kLatencyBuckets; bucket++) {
+        result.latency_ns[bucket] += each.latency_ns[bucket].load(std::memory_order_relaxed);
+      }
+    }
+    result.high_water = m_high_water.load(std::memory_order_relaxed);
+    return result;
+  }
+
+private:
+  struct alignas(64) Shard
+  {
+    std::atomic<uint64_t> enqueued{ 0 };
+    std::atomic<uint64_t> dequeued{ 0 };
+    std::atomic<uint64_t> dropped{ 0 };
+    std::atomic<uint64_t> lock_waits{ 0 };
+    std::array<std::atomic<uint64_t>, QueueStatsSnapshot::kLatencyBuckets> latency_ns{};
+  };
+
+  Shard &shard() noexcept
+  {
+    static std::atomic<size_t> next_thread{ 0 };
+    thread_local size_t index = next_thread.fetch_add(1, std::memory_order_relaxed) % kShards;
+    return m_shards[index];
+  }
+
+  std::array<Shard, kShards> m_shards{};
+  std::atomic<uint64_t> m_high_water{ 0 };
+};
+
+inline QueueStats &QueueStats::operator=(const QueueStats &other) noexcept
+{
+  auto copy = [](std::atomic<uint64_t> &to, const std::atomic<uint64_t> &from) {
+    to.store(from.load(std::memory_order_relaxed), std::memory_order_relaxed);
+  };
+  for (size_t shard = 0; shard < kShards; shard++) {
+    Shard &to = m_shards[shard];
+    const Shard &from = other.m_shards[shard];
+    copy(to.enqueued, from.enqueued);
+    copy(to.dequeued, from.dequeued);
+    copy(to.dropped, from.dropped);
+    copy(to.lock_waits, from.lock_waits);
+    for (size_t bucket = 0; bucket < QueueStatsSnapshot::kLatencyBuckets; bucket++) {
+      copy(to.latency_ns[bucket], from.latency_ns[bucket]);
+    }
+  }
+  copy(m_high_water, other.m_high_water);
+  return *this;
+}
+
+/**
+ * @brief Recorder that records nothing. Its Stamp is empty and every call
+ * compiles away, so a queue using it carries no statistics overhead at all.
+ */
+struct NoQueueStats
+{
+  static constexpr bool enabled = false;
+
+  struct Stamp
+  {
+  };
+
+  static constexpr Stamp now() noexcept { return {}; }
+  constexpr void on_enqueue(size_t /*depth*/, uint64_t /*count*/ = 1) noexcept {}
+  constexpr void on_dequeue(const Stamp & /*stamp*/) noexcept {}
+  constexpr void on_drop() noexcept {}
+  constexpr void on_lock_wait() noexcept {}
+  QueueStatsSnapshot snapshot() const noexcept { return {}; }
+};
+
+/**
+ * @brief The recorder queues use unless told otherwise: QueueStats when the
+ * build defines CPP_EXPERIMENTS_QUEUE_STATS (CMake option
+ * cpp_experiments_ENABLE_QUEUE_STATS), NoQueueStats otherwise.
+ */
+#if defined(CPP_EXPERIMENTS_QUEUE_STATS)
+using DefaultQueueStats = QueueStats;
+#else
+using DefaultQueueStats = NoQueueStats;
+#endif
+
+}// namespace threaded_queue
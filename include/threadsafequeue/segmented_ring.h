@@ -0,0 +1,126 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace threaded_queue {
+
+/**
+ * @brief FIFO storage for values in a ring of fixed-size segments.
+ *
+ * Elements live directly in segments of kSegmentSize slots (about 4 KiB
+ * each); a ring of segment pointers ties them together. Unlike std::deque,
+ * which frees a block every time the front crosses one and allocates another
+ * at the back, a drained segment is simply reused when the back wraps around
+ * to it, so a queue whose length stays bounded stops allocating altogether.
+ *
+ * When the ring is full the segment ring doubles. Elements are not moved,
+ * except for fewer than kSegmentSize elements that share the front's segment.
+ * Memory is never returned before destruction.
+ *
+ * Offers the subset of the std::deque interface that ThreadSafeQueue needs.
+ */
+template<typename T> class SegmentedRing
+{
+  // grow() moves a few elements; a throwing move would leave them in both places.
+  static_assert(std::is_nothrow_move_constructible_v<T>, "SegmentedRing needs a nothrow move constructor");
+
+public:
+  using value_type = T;
+
+  static constexpr size_t kSegmentSize = std::max<size_t>(8, std::bit_floor(size_t{ 4096 } / sizeof(T)));
+
+  explicit SegmentedRing(std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+    : m_segments(resource), m_resource(resource)
+  {}
+  ~SegmentedRing();
+
+  SegmentedRing(const SegmentedRing &) = delete;
+  SegmentedRing &operator=(const SegmentedRing &) = delete;
+
+  bool empty() const noexcept { return m_size == 0; }
+  size_t size() const noexcept { return m_size; }
+  size_t capacity() const noexcept { return m_segments.size() * kSegmentSize; }
+
+  T &front() noexcept { return *slot(m_head); }
+
+  template<typename... Args> T &emplace_back(Args &&...args);
+  void push_back(T &&value) { emplace_back(std::move(value)); }
+  void pop_front() noexcept;
+
+private:
+  std::pmr::vector<T *> m_segments;// ring of segments, size 0 or a power of two
+  std::pmr::memory_resource *m_resource;
+  size_t m_head = 0;// position of the front element in [0, capacity())
+  size_t m_size = 0;
+
+  T *slot(size_t position) const noexcept
+  {
+    return m_segments[position / kSegmentSize] + position % kSegmentSize;
+  }
+  T *allocate_segment() { return static_cast<T *>(m_resource->allocate(sizeof(T) * kSegmentSize, alignof(T))); }
+  void grow();
+};
+
+template<typename T> SegmentedRing<T>::~SegmentedRing()
+{
+  while (!empty()) { pop_front(); }
+  for (T *segment : m_segments) { m_resource->deallocate(segment, sizeof(T) * kSegmentSize, alignof(T)); }
+}
+
+template<typename T> template<typename... Args> T &SegmentedRing<T>::emplace_back(Args &&...args)
+{
+  if (m_size == capacity()) { grow(); }
+  T *target = slot((m_head + m_size) & (capacity() - 1));
+  std::construct_at(target, std::forward<Args>(args)...);
+  ++m_size;
+  return *target;
+}
+
+template<typename T> void SegmentedRing<T>::pop_front() noexcept
+{
+  std::destroy_at(slot(m_head));
+  m_head = (m_head + 1) & (capacity() - 1);
+  --m_size;
+}
+
+template<typename T> void SegmentedRing<T>::grow()
+{
+  size_t count = m_segments.size();
+  std::pmr::vector<T *> segments(m_resource);
+  segments.reserve(std::max<size_t>(1, 2 * count));
+
+  // Rotate so the front's segment comes first; when the ring is full the back
+  // has wrapped into the part of that segment before the front, and those
+  // elements move to a fresh segment placed after all the others.
+  size_t first = m_head / kSegmentSize;
+  size_t offset = m_head % kSegmentSize;
+  for (size_t i = 0; i < count; i++) { segments.push_back(m_segments[(first + i) % count]); }
+  try {
+    while (segments.size() < std::max<size_t>(1, 2 * count)) { segments.push_back(allocate_segment()); }
+  } catch (...) {
+    for (size_t i = count; i < segments.size(); i++) {
+      m_resource->deallocate(segments[i], sizeof(T) * kSegmentSize, alignof(T));
+    }
+    throw;
+  }
+  if (offset != 0) {
+    T *from = segments.front();
+    T *to = segments[count];
+    for (size_t i = 0; i < offset; i++) {
+      std::construct_at(to + i, std::move(from[i]));
+      std::destroy_at(from + i);
+    }
+  }
+  m_segments = std::move(segments);
+  m_head = offset;
+}
+
+}// namespace threaded_queue
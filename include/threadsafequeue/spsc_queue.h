@@ -0,0 +1,254 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <thread>
+
+namespace threaded_queue {
+
+/**
+ * @brief Bounded single-producer single-consumer ring buffer.
+ *
+ * Exactly one thread may push and exactly one thread may pop. Each side owns
+ * one index and only ever stores to it with release; the other side reads it
+ * with acquire. Each side also keeps a private copy of the other side's index
+ * and only re-reads the shared one when the copy says the ring is full
+ * (producer) or empty (consumer), so in steady state a push or pop touches no
+ * cache line written by the other thread except the cell itself.
+ *
+ * Besides the ThreadSafeQueue surface, batches can be written and read in
+ * place: prepare_write()/commit_write() on the producer side and
+ * read_span()/commit_read() on the consumer side publish or release a whole
+ * span with a single index store.
+ *
+ * push() and wait_and_pop() do not use a lock or condition variable either.
+ * They retry with yields and then back off with short sleeps, so an idle
+ * consumer notices a new item within kMaxBackoff.
+ *
+ * @note Capacity is rounded up to a power of two.
+ */
+template<typename F, typename Deleter = std::default_delete<F>>
+class SPSCQueue
+{
+public:
+  using pointer_type = std::unique_ptr<F, Deleter>;
+  using value_type = pointer_type;
+
+  static constexpr std::chrono::microseconds kMaxBackoff{ 50 };
+
+  explicit SPSCQueue(size_t capacity);
+  SPSCQueue(const SPSCQueue &) = delete;
+  SPSCQueue &operator=(const SPSCQueue &) = delete;
+
+  // Producer side.
+
+  /**
+   * @brief Pushes @p item, waiting for space while the queue is full.
+   * @return false if the queue was shut down while waiting; the item is then
+   * destroyed.
+   */
+  bool push(pointer_type item);
+
+  /**
+   * @brief Pushes @p item if there is space.
+   * @return false if the queue is full, @p item is left untouched.
+   */
+  bool try_push(pointer_type &item);
+
+  /**
+   * @brief Returns up to @p max_n contiguous free cells to move items into.
+   * @note The span may be shorter than the free space when the free space
+   * wraps around the end of the ring; call again after commit_write().
+   */
+  std::span<pointer_type> prepare_write(size_t max_n);
+
+  /**
+   * @brief Publishes the first @p n cells of the last prepare_write() span.
+   */
+  void commit_write(size_t n);
+
+  // Consumer side.
+
+  std::optional<pointer_type> try_pop();
+
+  /**
+   * @brief Pops an item, waiting while the queue is empty.
+   * @return std::nullopt once the queue is shut down and drained.
+   */
+  std::optional<pointer_type> wait_and_pop();
+
+  /**
+   * @brief Returns up to @p max_n contiguous published items.
+   * @note Like prepare_write(), the span stops at the end of the ring.
+   */
+  std::span<pointer_type> read_span(size_t max_n);
+
+  /**
+   * @brief Releases the first @p n cells of the last read_span() span.
+   * Items not moved out of them are destroyed.
+   */
+  void commit_read(size_t n);
+
+  // Either side.
+
+  size_t size() const;
+  bool empty() const;
+  size_t capacity() const noexcept { return m_mask + 1; }
+  void shutdown();
+
+private:
+  static constexpr int kSpinAttempts = 64;
+
+  static size_t checked_capacity(size_t capacity)
+  {
+    if (capacity == 0) { throw std::invalid_argument("SPSCQueue capacity must be non-zero"); }
+    return std::bit_ceil(capacity);
+  }
+
+  // Free/published cells, re-reading the other side's index only when the
+  // cached copy shows fewer than @p wanted.
+  size_t writable(size_t wanted) noexcept;
+  size_t readable(size_t wanted) noexcept;
+  template<typename Ready> bool wait_until(Ready ready);
+
+  std::unique_ptr<pointer_type[]> m_cells;
+  size_t m_mask = 0;
+  std::atomic<bool> m_shutdown{ false };
+
+  // Written by the producer.
+  alignas(64) std::atomic<size_t> m_tail{ 0 };
+  size_t m_head_cache = 0;
+
+  // Written by the consumer.
+  alignas(64) std::atomic<size_t> m_head{ 0 };
+  size_t m_tail_cache = 0;
+};
+
+// Template implementation
+template<typename F, typename Deleter>
+SPSCQueue<F, Deleter>::SPSCQueue(size_t capacity)
+  : m_cells(new pointer_type[checked_capacity(capacity)]), m_mask(checked_capacity(capacity) - 1)
+{}
+
+template<typename F, typename Deleter> size_t SPSCQueue<F, Deleter>::writable(size_t wanted) noexcept
+{
+  size_t tail = m_tail.load(std::memory_order_relaxed);
+  size_t free = m_mask + 1 - (tail - m_head_cache);
+  if (free < wanted) {
+    m_head_cache = m_head.load(std::memory_order_acquire);
+    free = m_mask + 1 - (tail - m_head_cache);
+  }
+  return free;
+}
+
+template<typename F, typename Deleter> size_t SPSCQueue<F, Deleter>::readable(size_t wanted) noexcept
+{
+  size_t head = m_head.load(std::memory_order_relaxed);
+  if (m_tail_cache - head < wanted) { m_tail_cache = m_tail.load(std::memory_order_acquire); }
+  return m_tail_cache - head;
+}
+
+template<typename F, typename Deleter>
+template<typename Ready>
+bool SPSCQueue<F, Deleter>::wait_until(Ready ready)
+{
+  auto backoff = std::chrono::microseconds(1);
+  for (int attempt = 0;; attempt++) {
+    if (ready()) { return true; }
+    if (m_shutdown.load(std::memory_order_acquire)) { return ready(); }
+    if (attempt < kSpinAttempts) {
+      std::this_thread::yield();
+    } else {
+      std::this_thread::sleep_for(backoff);
+      backoff = std::min(backoff * 2, kMaxBackoff);
+    }
+  }
+}
+
+template<typename F, typename Deleter> bool SPSCQueue<F, Deleter>::try_push(pointer_type &item)
+{
+  if (writable(1) == 0) { return false; }
+  size_t tail = m_tail.load(std::memory_order_relaxed);
+  m_cells[tail & m_mask] = std::move(item);
+  m_tail.store(tail + 1, std::memory_order_release);
+  return true;
+}
+
+template<typename F, typename Deleter> bool SPSCQueue<F, Deleter>::push(pointer_type item)
+{
+  return wait_until([&] { return try_push(item); });
+}
+
+template<typename F, typename Deleter> auto SPSCQueue<F, Deleter>::prepare_write(size_t max_n) -> std::span<pointer_type>
+{
+  size_t tail = m_tail.load(std::memory_order_relaxed);
+  size_t offset = tail & m_mask;
+  size_t n = std::min(max_n, m_mask + 1 - offset);
+  n = std::min(n, writable(n));
+  return { &m_cells[offset], n };
+}
+
+template<typename F, typename Deleter> void SPSCQueue<F, Deleter>::commit_write(size_t n)
+{
+  m_tail.store(m_tail.load(std::memory_order_relaxed) + n, std::memory_order_release);
+}
+
+template<typename F, typename Deleter> auto SPSCQueue<F, Deleter>::try_pop() -> std::optional<pointer_type>
+{
+  if (readable(1) == 0) { return std::nullopt; }
+  size_t head = m_head.load(std::memory_order_relaxed);
+  pointer_type item = std::move(m_cells[head & m_mask]);
+  m_head.store(head + 1, std::memory_order_release);
+  return item;
+}
+
+template<typename F, typename Deleter> auto SPSCQueue<F, Deleter>::wait_and_pop() -> std::optional<pointer_type>
+{
+  std::optional<pointer_type> item;
+  wait_until([&] {
+    item = try_pop();
+    return item.has_value();
+  });
+  return item;
+}
+
+template<typename F, typename Deleter> auto SPSCQueue<F, Deleter>::read_span(size_t max_n) -> std::span<pointer_type>
+{
+  size_t head = m_head.load(std::memory_order_relaxed);
+  size_t offset = head & m_mask;
+  size_t n = std::min(max_n, m_mask + 1 - offset);
+  n = std::min(n, readable(n));
+  return { &m_cells[offset], n };
+}
+
+template<typename F, typename Deleter> void SPSCQueue<F, Deleter>::commit_read(size_t n)
+{
+  size_t head = m_head.load(std::memory_order_relaxed);
+  for (size_t i = 0; i < n; i++) { m_cells[(head + i) & m_mask].reset(); }
+  m_head.store(head + n, std::memory_order_release);
+}
+
+template<typename F, typename Deleter> size_t SPSCQueue<F, Deleter>::size() const
+{
+  size_t head = m_head.load(std::memory_order_acquire);
+  size_t tail = m_tail.load(std::memory_order_acquire);
+  return tail > head ? tail - head : 0;
+}
+
+template<typename F, typename Deleter> bool SPSCQueue<F, Deleter>::empty() const
+{
+  return size() == 0;
+}
+
+template<typename F, typename Deleter> void SPSCQueue<F, Deleter>::shutdown()
+{
+  m_shutdown.store(true, std::memory_order_release);
+}
+}// namespace threaded_queue
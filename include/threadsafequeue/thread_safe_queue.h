@@ -1,101 +1,556 @@
 #pragma once
 
 #include "message.h"
-#include <deque>
+#include "queue_stats.h"
+#include "segmented_ring.h"
+#include "wait_policy.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <concepts>
+#include <iterator>
 #include <memory>
+#include <memory_resource>
 #include <mutex>
 #include <optional>
+#include <ranges>
+#include <stdexcept>
+#include <thread>
 #include <condition_variable>
+#include <cstdint>
+#include <vector>
 
 namespace threaded_queue {
 
 /**
- * @brief A thread-safe queue implementation for Message objects.
+ * @brief What a bounded ThreadSafeQueue does with a push while it is full.
  *
- * This class provides a thread-safe wrapper around std::deque for storing
- * unique_ptr<Message> objects. It uses mutex-based synchronization to ensure
- * safe concurrent access from multiple threads.
+ * block:       wait until a consumer makes room (or the queue is shut down).
+ * drop_oldest: discard the item at the front to make room; the push succeeds.
+ * reject:      discard the pushed item; push returns false.
+ */
+enum class OverflowPolicy { block, drop_oldest, reject };
+
+/**
+ * @brief A thread-safe FIFO queue of values.
+ *
+ * Items of type T are moved in and out, or constructed in place with
+ * emplace(), and stored directly in a SegmentedRing, so pushing a small
+ * value such as a std::function costs neither an allocation of its own nor a
+ * deque node. It uses mutex-based synchronization to ensure safe concurrent
+ * access from multiple threads.
+ *
+ * ThreadSafeQueue<F, Deleter> below is the pointer-carrying flavour used for
+ * Message objects and other items that are created elsewhere and handed over.
+ *
+ * By default the queue is unbounded. Constructed with a capacity it never
+ * holds more than that many items and applies its OverflowPolicy when full;
+ * try_push() and push_for()/push_until() fail instead of applying it.
  *
- * @note This class is non-copyable but supports move semantics.
+ * Consumers that find the queue empty wait according to a WaitPolicy; see
+ * there. Timed pops spin like the others but then sleep on the condition
+ * variable, since std::atomic waits cannot time out.
+ *
+ * Stats records depth, contention and latency; see QueueStats. The default,
+ * DefaultQueueStats, records nothing unless the build enables it.
+ *
+ * @note T must be nothrow move constructible.
+ * @note This class is non-copyable and non-movable.
  * @note All operations are thread-safe and can be called concurrently.
  */
-template<typename F>
-class ThreadSafeQueue
+template<typename T, typename Stats = DefaultQueueStats>
+class ThreadSafeValueQueue
 {
 public:
-  ThreadSafeQueue() = default;
-  ThreadSafeQueue(const ThreadSafeQueue &) = delete;
-  ThreadSafeQueue &operator=(const ThreadSafeQueue &) = delete;
+  using value_type = T;
+
+  ThreadSafeValueQueue() = default;
+
+  /**
+   * @brief Creates a queue whose storage segments are allocated from @p resource.
+   * @note The resource is only used with the queue mutex held, so it does not
+   * need to be thread-safe. It must outlive the queue.
+   * @note A template so that a literal 0 picks the capacity constructor
+   * instead of being ambiguous with a null pointer.
+   */
+  template<typename Resource>
+    requires std::derived_from<Resource, std::pmr::memory_resource>
+  explicit ThreadSafeValueQueue(Resource *resource) : m_queue(resource)
+  {}
+
+  /**
+   * @brief Creates an unbounded queue whose consumers wait according to @p wait.
+   */
+  explicit ThreadSafeValueQueue(WaitPolicy wait,
+    std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+    : m_wait(wait), m_queue(resource)
+  {}
+
+  /**
+   * @brief Creates a queue holding at most @p capacity items.
+   * @throws std::invalid_argument if @p capacity is 0.
+   */
+  explicit ThreadSafeValueQueue(size_t capacity,
+    OverflowPolicy overflow = OverflowPolicy::block,
+    WaitPolicy wait = {},
+    std::pmr::memory_resource *resource = std::pmr::get_default_resource());
 
-  ThreadSafeQueue(ThreadSafeQueue &&) = default;
-  ThreadSafeQueue &operator=(ThreadSafeQueue &&) = default;
+  ThreadSafeValueQueue(const ThreadSafeValueQueue &) = delete;
+  ThreadSafeValueQueue &operator=(const ThreadSafeValueQueue &) = delete;
 
+  /**
+   * @brief Pushes @p msg, applying the overflow policy if the queue is full.
+   * @return false if the item was rejected, or the queue was shut down while
+   * a blocking push waited. The item is destroyed in that case.
+   */
+  bool push(value_type msg) { return emplace(std::move(msg)); }
+
+  /**
+   * @brief Constructs an item from @p args at the back of the queue, applying
+   * the overflow policy if the queue is full.
+   * @return false if the item was rejected or the queue was shut down while
+   * waiting; nothing is constructed in that case.
+   */
+  template<typename... Args> bool emplace(Args &&...args);
+  /**
+   * @brief Pushes @p msg only if there is room right now.
+   * @return false if the queue is full; @p msg is left untouched.
+   */
+  bool try_push(value_type &msg);
+
+  /**
+   * @brief Pushes @p msg, waiting for room until @p timeout has passed.
+   * @return false on timeout or shutdown; @p msg is left untouched.
+   */
+  template<typename Rep, typename Period>
+  bool push_for(value_type &msg, const std::chrono::duration<Rep, Period> &timeout);
+  template<typename Clock, typename Duration>
+  bool push_until(value_type &msg, const std::chrono::time_point<Clock, Duration> &deadline);
+
+  std::optional<value_type> try_pop();
+  std::optional<value_type> wait_and_pop();
+
+  /**
+   * @brief Pops an item, waiting until @p timeout has passed.
+   * @return std::nullopt on timeout, or once the queue is shut down and drained.
+   */
+  template<typename Rep, typename Period>
+  std::optional<value_type> pop_for(const std::chrono::duration<Rep, Period> &timeout);
+  template<typename Clock, typename Duration>
+  std::optional<value_type> pop_until(const std::chrono::time_point<Clock, Duration> &deadline);
+
+  /**
+   * @brief Moves the elements of @p items into the queue under a single lock
+   * and sends a single notification.
+   *
+   * A bounded queue applies its overflow policy per item: block waits for
+   * room (notifying consumers of what it has pushed so far), drop_oldest
+   * discards from the front, reject stops at the first item that does not fit.
+   *
+   * @return The number of items pushed. Those elements of @p items are left
+   * empty; the rest are untouched.
+   */
+  template<std::ranges::input_range R>
+    requires std::assignable_from<value_type &, std::ranges::range_rvalue_reference_t<R>>
+  size_t push_bulk(R &&items);
+
+  /**
+   * @brief Moves up to @p max_n items to @p out under a single lock.
+   * @return The number of items written, 0 if the queue was empty.
+   */
+  template<std::output_iterator<value_type> Out> size_t pop_bulk(Out out, size_t max_n);
+
+  /**
+   * @brief Like pop_bulk(), but waits until at least one item is available.
+   * @return The number of items written, 0 once the queue is shut down and drained.
+   */
+  template<std::output_iterator<value_type> Out> size_t wait_and_pop_bulk(Out out, size_t max_n);
 
-  void push(std::unique_ptr<F> msg);
-  std::optional<std::unique_ptr<F>> try_pop();
-  std::optional<std::unique_ptr<F>> wait_and_pop();
   size_t size() const;
   bool empty() const;
+
+  /**
+   * @brief The maximum number of items, 0 for an unbounded queue.
+   */
+  size_t capacity() const noexcept { return m_capacity; }
+  const WaitPolicy &wait_policy() const noexcept { return m_wait; }
+
+  /**
+   * @brief Current statistics, read without taking the queue lock. All zero
+   * unless Stats records them.
+   */
+  QueueStatsSnapshot stats() const noexcept { return m_stats.snapshot(); }
   void shutdown();
 
 private:
-  bool m_shutdown = false;
-  std::deque<std::unique_ptr<F>> m_queue;
+  std::atomic<bool> m_shutdown{ false };// written with m_mutex held
+  size_t m_capacity = 0;
+  OverflowPolicy m_overflow = OverflowPolicy::block;
+  WaitPolicy m_wait;
+  // An item and the time it was queued; with NoQueueStats the stamp is empty
+  // and takes no space.
+  struct Entry
+  {
+    template<typename... Args>
+    explicit Entry(typename Stats::Stamp at, Args &&...args) : value(std::forward<Args>(args)...), stamp(at)
+    {}
+
+    value_type value;
+    [[no_unique_address]] typename Stats::Stamp stamp;
+  };
+
+  SegmentedRing<Entry> m_queue;
+  mutable Stats m_stats;
   mutable std::mutex m_mutex;
   mutable std::condition_variable m_cond_variable;
+  std::condition_variable m_not_full;// only waited on by bounded queues
+
+  // Consumer wake-up state. The counters are guarded by m_mutex, so a producer
+  // that finds both at zero skips the notification altogether.
+  size_t m_cond_waiters = 0;// consumers blocked on m_cond_variable
+  size_t m_parked = 0;// consumers parked on m_epoch
+  std::atomic<uint32_t> m_epoch{ 0 };// bumped to release parked consumers
+  std::atomic<size_t> m_size_hint{ 0 };// m_queue.size(), read by spinning consumers
+
+  bool ready() const { return !m_queue.empty() || m_shutdown.load(std::memory_order_relaxed); }
+  bool ready_hint() const noexcept
+  {
+    return m_size_hint.load(std::memory_order_relaxed) != 0 || m_shutdown.load(std::memory_order_relaxed);
+  }
+
+  // Spins and yields per m_wait with the lock released, until the queue looks
+  // ready, the budget runs out or @p expired returns true.
+  template<typename Expired> void spin(std::unique_lock<std::mutex> &lock, Expired expired);
+
+  // Locks m_mutex, counting the acquisitions that have to wait.
+  std::unique_lock<std::mutex> acquire() const;
+
+  // Helpers below expect m_mutex to be held.
+  bool full() const { return m_capacity != 0 && m_queue.size() >= m_capacity; }
+  void notify_not_full(size_t popped);
+  void wake_consumers(size_t pushed);
+  void wait_ready(std::unique_lock<std::mutex> &lock);
+  template<typename Clock, typename Duration>
+  bool wait_ready_until(std::unique_lock<std::mutex> &lock, const std::chrono::time_point<Clock, Duration> &deadline);
+  value_type pop_front();
+  void drop_front();
+  template<typename... Args> void emplace_back(typename Stats::Stamp stamp, Args &&...args);
+  template<typename Out> size_t move_front(Out out, size_t max_n);
 };
 
+/**
+ * @brief ThreadSafeValueQueue of unique_ptr<F, Deleter>, for items such as
+ * Message objects that are created elsewhere and handed over by pointer.
+ *
+ * Deleter is the deleter of the stored unique_ptr. Pass
+ * memory::PoolDeleter<F> to carry memory::pooled_ptr<F> objects, so messages
+ * can cycle producer -> queue -> consumer -> pool without touching the heap.
+ */
+template<typename F, typename Deleter = std::default_delete<F>, typename Stats = DefaultQueueStats>
+using ThreadSafeQueue = ThreadSafeValueQueue<std::unique_ptr<F, Deleter>, Stats>;
+
 // Template implementation
-template<typename F>
-void ThreadSafeQueue<F>::push(std::unique_ptr<F> item) {
-  auto lock = std::lock_guard(m_mutex);
-  m_queue.push_back(std::move(item));
-  m_cond_variable.notify_one();
+template<typename T, typename Stats>
+ThreadSafeValueQueue<T, Stats>::ThreadSafeValueQueue(size_t capacity,
+  OverflowPolicy overflow,
+  WaitPolicy wait,
+  std::pmr::memory_resource *resource)
+  : m_capacity(capacity), m_overflow(overflow), m_wait(wait), m_queue(resource) {
+  if (capacity == 0) { throw std::invalid_argument("ThreadSafeQueue capacity must be non-zero"); }
 }
 
-template<typename F>
-std::optional<std::unique_ptr<F>> ThreadSafeQueue<F>::try_pop() {
-  auto lock = std::lock_guard(m_mutex);
-  if (m_queue.empty()) { 
-    return std::nullopt; 
+template<typename T, typename Stats>
+void ThreadSafeValueQueue<T, Stats>::notify_not_full(size_t popped) {
+  if (m_capacity == 0 || popped == 0) { return; }
+  if (popped == 1) {
+    m_not_full.notify_one();
+  } else {
+    m_not_full.notify_all();
+  }
+}
+
+template<typename T, typename Stats>
+void ThreadSafeValueQueue<T, Stats>::wake_consumers(size_t pushed) {
+  m_size_hint.store(m_queue.size(), std::memory_order_relaxed);
+  if (pushed == 0) { return; }
+  if (m_cond_waiters > 0) {
+    if (pushed == 1) {
+      m_cond_variable.notify_one();
+    } else {
+      m_cond_variable.notify_all();
+    }
+  }
+  if (m_parked > 0) {
+    m_epoch.fetch_add(1, std::memory_order_release);
+    if (pushed == 1) {
+      m_epoch.notify_one();
+    } else {
+      m_epoch.notify_all();
+    }
+  }
+}
+
+template<typename T, typename Stats>
+template<typename Expired>
+void ThreadSafeValueQueue<T, Stats>::spin(std::unique_lock<std::mutex> &lock, Expired expired) {
+  lock.unlock();
+  for (int i = 0; i < m_wait.spins && !ready_hint(); i++) { cpu_relax(); }
+  for (int i = 0; i < m_wait.yields && !ready_hint() && !expired(); i++) { std::this_thread::yield(); }
+  lock.lock();
+}
+
+template<typename T, typename Stats>
+void ThreadSafeValueQueue<T, Stats>::wait_ready(std::unique_lock<std::mutex> &lock) {
+  if (ready()) { return; }
+  if (m_wait.kind == WaitPolicy::Kind::block) {
+    ++m_cond_waiters;
+    m_cond_variable.wait(lock, [this]{return ready();});
+    --m_cond_waiters;
+    return;
+  }
+  spin(lock, []{return false;});
+  // Registering and reading the epoch under the lock means a producer either
+  // pushed before we checked, or sees m_parked and bumps the epoch we wait on.
+  while (!ready()) {
+    ++m_parked;
+    uint32_t epoch = m_epoch.load(std::memory_order_relaxed);
+    lock.unlock();
+    m_epoch.wait(epoch, std::memory_order_acquire);
+    lock.lock();
+    --m_parked;
   }
-  auto msg = std::move(m_queue.front());
+}
+
+template<typename T, typename Stats>
+template<typename Clock, typename Duration>
+bool ThreadSafeValueQueue<T, Stats>::wait_ready_until(std::unique_lock<std::mutex> &lock,
+  const std::chrono::time_point<Clock, Duration> &deadline) {
+  if (ready()) { return true; }
+  if (m_wait.kind == WaitPolicy::Kind::spin_then_park) {
+    spin(lock, [&]{return Clock::now() >= deadline;});
+  }
+  ++m_cond_waiters;
+  bool result = m_cond_variable.wait_until(lock, deadline, [this]{return ready();});
+  --m_cond_waiters;
+  return result;
+}
+
+template<typename T, typename Stats>
+std::unique_lock<std::mutex> ThreadSafeValueQueue<T, Stats>::acquire() const {
+  if constexpr (Stats::enabled) {
+    auto lock = std::unique_lock(m_mutex, std::try_to_lock);
+    if (!lock.owns_lock()) {
+      m_stats.on_lock_wait();
+      lock.lock();
+    }
+    return lock;
+  } else {
+    return std::unique_lock(m_mutex);
+  }
+}
+
+template<typename T, typename Stats>
+template<typename... Args>
+void ThreadSafeValueQueue<T, Stats>::emplace_back(typename Stats::Stamp stamp, Args &&...args) {
+  m_queue.emplace_back(stamp, std::forward<Args>(args)...);
+  m_stats.on_enqueue(m_queue.size());
+}
+
+template<typename T, typename Stats>
+void ThreadSafeValueQueue<T, Stats>::drop_front() {
   m_queue.pop_front();
+  m_stats.on_drop();
+}
+
+template<typename T, typename Stats>
+auto ThreadSafeValueQueue<T, Stats>::pop_front() -> value_type {
+  m_stats.on_dequeue(m_queue.front().stamp);
+  auto msg = std::move(m_queue.front().value);
+  m_queue.pop_front();
+  m_size_hint.store(m_queue.size(), std::memory_order_relaxed);
+  notify_not_full(1);
   return msg;
 }
 
-template<typename F>
-std::optional<std::unique_ptr<F>> ThreadSafeQueue<F>::wait_and_pop() {
-  auto lock = std::unique_lock(m_mutex);
-  m_cond_variable.wait(lock, [this]{return !m_queue.empty() || m_shutdown;});
+template<typename T, typename Stats>
+template<typename... Args>
+bool ThreadSafeValueQueue<T, Stats>::emplace(Args &&...args) {
+  std::optional<value_type> dropped;// destroyed after the lock is released
+  auto stamp = Stats::now();// read before locking, to keep the clock out of the critical section
+  auto lock = acquire();
+  if (full()) {
+    switch (m_overflow) {
+    case OverflowPolicy::block:
+      m_not_full.wait(lock, [this]{return !full() || m_shutdown;});
+      if (full()) { return false; }
+      break;
+    case OverflowPolicy::drop_oldest:
+      dropped.emplace(std::move(m_queue.front().value));
+      drop_front();
+      break;
+    case OverflowPolicy::reject:
+      return false;
+    }
+  }
+  emplace_back(stamp, std::forward<Args>(args)...);
+  wake_consumers(1);
+  return true;
+}
+
+template<typename T, typename Stats>
+bool ThreadSafeValueQueue<T, Stats>::try_push(value_type &item) {
+  auto stamp = Stats::now();
+  auto lock = acquire();
+  if (full()) { return false; }
+  emplace_back(stamp, std::move(item));
+  wake_consumers(1);
+  return true;
+}
+
+template<typename T, typename Stats>
+template<typename Rep, typename Period>
+bool ThreadSafeValueQueue<T, Stats>::push_for(value_type &item, const std::chrono::duration<Rep, Period> &timeout) {
+  return push_until(item, std::chrono::steady_clock::now() + timeout);
+}
+
+template<typename T, typename Stats>
+template<typename Clock, typename Duration>
+bool ThreadSafeValueQueue<T, Stats>::push_until(value_type &item,
+  const std::chrono::time_point<Clock, Duration> &deadline) {
+  auto stamp = Stats::now();
+  auto lock = acquire();
+  if (!m_not_full.wait_until(lock, deadline, [this]{return !full() || m_shutdown;}) || full()) {
+    return false;
+  }
+  emplace_back(stamp, std::move(item));
+  wake_consumers(1);
+  return true;
+}
+
+template<typename T, typename Stats>
+auto ThreadSafeValueQueue<T, Stats>::try_pop() -> std::optional<value_type> {
+  auto lock = acquire();
+  if (m_queue.empty()) { 
+    return std::nullopt; 
+  }
+  return pop_front();
+}
+
+template<typename T, typename Stats>
+auto ThreadSafeValueQueue<T, Stats>::wait_and_pop() -> std::optional<value_type> {
+  auto lock = acquire();
+  wait_ready(lock);
 
   if(m_shutdown && m_queue.empty()){
     return std::nullopt;
   }
 
-  auto msg = std::move(m_queue.front());
-  m_queue.pop_front();
-  return msg;
+  return pop_front();
+}
+
+template<typename T, typename Stats>
+template<typename Rep, typename Period>
+auto ThreadSafeValueQueue<T, Stats>::pop_for(const std::chrono::duration<Rep, Period> &timeout)
+  -> std::optional<value_type> {
+  return pop_until(std::chrono::steady_clock::now() + timeout);
+}
+
+template<typename T, typename Stats>
+template<typename Clock, typename Duration>
+auto ThreadSafeValueQueue<T, Stats>::pop_until(const std::chrono::time_point<Clock, Duration> &deadline)
+  -> std::optional<value_type> {
+  auto lock = acquire();
+  if (!wait_ready_until(lock, deadline) || m_queue.empty()) {
+    return std::nullopt;
+  }
+  return pop_front();
+}
+
+template<typename T, typename Stats>
+template<std::ranges::input_range R>
+  requires std::assignable_from<typename ThreadSafeValueQueue<T, Stats>::value_type &,
+    std::ranges::range_rvalue_reference_t<R>>
+size_t ThreadSafeValueQueue<T, Stats>::push_bulk(R &&items) {
+  size_t pushed = 0;
+  size_t unannounced = 0;
+  std::vector<value_type> dropped;// destroyed after the lock is released
+  auto stamp = Stats::now();// one clock read for the whole batch, before locking
+  auto lock = acquire();
+  for (auto &&item : items) {
+    if (full()) {
+      if (m_overflow == OverflowPolicy::reject) { break; }
+      if (m_overflow == OverflowPolicy::drop_oldest) {
+        dropped.push_back(std::move(m_queue.front().value));
+        drop_front();
+      } else {
+        // Let consumers at what is already queued before waiting on them.
+        wake_consumers(unannounced);
+        unannounced = 0;
+        m_not_full.wait(lock, [this]{return !full() || m_shutdown;});
+        if (full()) { break; }
+      }
+    }
+    emplace_back(stamp, std::move(item));
+    ++pushed;
+    ++unannounced;
+  }
+  // One wake-up call for the whole batch; several items may feed several consumers.
+  wake_consumers(unannounced);
+  return pushed;
+}
+
+// Caller holds m_mutex.
+template<typename T, typename Stats>
+template<typename Out>
+size_t ThreadSafeValueQueue<T, Stats>::move_front(Out out, size_t max_n) {
+  size_t n = std::min(max_n, m_queue.size());
+  for (size_t i = 0; i < n; i++) {
+    m_stats.on_dequeue(m_queue.front().stamp);
+    *out = std::move(m_queue.front().value);
+    ++out;
+    m_queue.pop_front();
+  }
+  m_size_hint.store(m_queue.size(), std::memory_order_relaxed);
+  notify_not_full(n);
+  return n;
+}
+
+template<typename T, typename Stats>
+template<std::output_iterator<typename ThreadSafeValueQueue<T, Stats>::value_type> Out>
+size_t ThreadSafeValueQueue<T, Stats>::pop_bulk(Out out, size_t max_n) {
+  auto lock = acquire();
+  return move_front(out, max_n);
+}
+
+template<typename T, typename Stats>
+template<std::output_iterator<typename ThreadSafeValueQueue<T, Stats>::value_type> Out>
+size_t ThreadSafeValueQueue<T, Stats>::wait_and_pop_bulk(Out out, size_t max_n) {
+  auto lock = acquire();
+  wait_ready(lock);
+  return move_front(out, max_n);
 }
 
-template<typename F>
-size_t ThreadSafeQueue<F>::size() const {
-  auto lock = std::lock_guard(m_mutex);
+template<typename T, typename Stats>
+size_t ThreadSafeValueQueue<T, Stats>::size() const {
+  auto lock = acquire();
   return m_queue.size();
 }
 
-template<typename F>
-bool ThreadSafeQueue<F>::empty() const {
-  auto lock = std::lock_guard(m_mutex);
+template<typename T, typename Stats>
+bool ThreadSafeValueQueue<T, Stats>::empty() const {
+  auto lock = acquire();
   return m_queue.empty();
 }
 
-template<typename F>
-void ThreadSafeQueue<F>::shutdown() {
+template<typename T, typename Stats>
+void ThreadSafeValueQueue<T, Stats>::shutdown() {
   {
-    auto lock = std::lock_guard(m_mutex);
-    m_shutdown = true;
+    auto lock = acquire();
+    m_shutdown.store(true, std::memory_order_relaxed);
+    m_epoch.fetch_add(1, std::memory_order_release);
   }
   m_cond_variable.notify_all();
+  m_not_full.notify_all();
+  m_epoch.notify_all();
 }
 }// namespace threaded_queue
\ No newline at end of file
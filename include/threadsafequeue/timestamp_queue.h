@@ -0,0 +1,339 @@
+#pragma once
+
+#include <bit>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace threaded_queue {
+
+/**
+ * @brief Reads timestamp_ns from a Message-like value or through a pointer to one.
+ */
+struct MessageTimestamp
+{
+  template<typename T> uint64_t operator()(const T &item) const noexcept
+  {
+    if constexpr (requires { item->timestamp_ns; }) {
+      return item->timestamp_ns;
+    } else {
+      return item.timestamp_ns;
+    }
+  }
+};
+
+/**
+ * @brief Single-threaded priority queue that pops the earliest timestamp first.
+ *
+ * An Arity-ary min-heap. Keys (timestamp plus an insertion sequence number
+ * that keeps equal timestamps in FIFO order) live in their own array, apart
+ * from the items, so sifting compares adjacent 16 byte keys and never follows
+ * an item pointer. The keys are stored in aligned groups of Arity, offset
+ * so that the children of a node fill exactly one group: with the default
+ * arity of 4 that is one 64 byte cache line per level, and the heap is half
+ * as deep as a binary one.
+ *
+ * The timestamp is read once, on push; items must not change it while queued.
+ */
+template<typename T, typename TimestampOf = MessageTimestamp, size_t Arity = 4>
+class TimestampHeap
+{
+  static_assert(Arity >= 2, "TimestampHeap needs at least two children per node");
+  static_assert(std::is_nothrow_move_constructible_v<T> && std::is_nothrow_move_assignable_v<T>,
+    "TimestampHeap moves items while sifting and needs nothrow moves");
+
+public:
+  using value_type = T;
+
+  explicit TimestampHeap(std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+    : m_groups(resource), m_items(resource)
+  {}
+
+  void push(T item);
+
+  /**
+   * @brief The earliest timestamp queued.
+   * @note The heap must not be empty.
+   */
+  uint64_t top_timestamp() const noexcept { return key(0).timestamp; }
+  const T &top() const noexcept { return m_items.front(); }
+
+  /**
+   * @brief Removes and returns the item with the earliest timestamp.
+   * @note The heap must not be empty.
+   */
+  T pop();
+  std::optional<T> try_pop();
+
+  /**
+   * @brief Moves every item with a timestamp before @p watermark to @p out,
+   * earliest first.
+   * @return The number of items written.
+   */
+  template<std::output_iterator<T> Out> size_t pop_older_than(uint64_t watermark, Out out);
+
+  size_t size() const noexcept { return m_items.size(); }
+  bool empty() const noexcept { return m_items.empty(); }
+  void reserve(size_t n);
+
+private:
+  struct Key
+  {
+    uint64_t timestamp;
+    uint64_t sequence;
+
+    bool operator<(const Key &other) const noexcept
+    {
+      return timestamp != other.timestamp ? timestamp < other.timestamp : sequence < other.sequence;
+    }
+  };
+
+  // The children of node i are group i + 1; the root sits alone at the end
+  // of group 0, so node i is slot (i + Arity - 1) % Arity of its group.
+  struct alignas(std::bit_ceil(Arity * sizeof(Key))) KeyGroup
+  {
+    Key keys[Arity];
+  };
+
+  std::pmr::vector<KeyGroup> m_groups;
+  std::pmr::vector<T> m_items;
+  uint64_t m_next_sequence = 0;
+
+  // Whether node index is the first in its group, which it then adds or removes.
+  static bool starts_group(size_t index) noexcept { return index == 0 || (index + Arity - 1) % Arity == 0; }
+  Key &key(size_t index) noexcept { return m_groups[(index + Arity - 1) / Arity].keys[(index + Arity - 1) % Arity]; }
+  const Key &key(size_t index) const noexcept
+  {
+    return m_groups[(index + Arity - 1) / Arity].keys[(index + Arity - 1) % Arity];
+  }
+
+  void sift_up(size_t index) noexcept;
+  void sift_down(size_t index) noexcept;
+  void move_node(size_t from, size_t to) noexcept
+  {
+    key(to) = key(from);
+    m_items[to] = std::move(m_items[from]);
+  }
+};
+
+/**
+ * @brief Thread-safe TimestampHeap for merging out-of-order data from several
+ * producers.
+ *
+ * Consumers can either pop one item at a time, earliest first, or drain
+ * everything older than a watermark in one call, typically the lowest
+ * timestamp every producer has already passed.
+ *
+ * @note All operations are thread-safe and can be called concurrently.
+ */
+template<typename T, typename TimestampOf = MessageTimestamp, size_t Arity = 4>
+class TimestampQueue
+{
+public:
+  using value_type = T;
+
+  TimestampQueue() = default;
+  explicit TimestampQueue(std::pmr::memory_resource *resource) : m_heap(resource) {}
+
+  TimestampQueue(const TimestampQueue &) = delete;
+  TimestampQueue &operator=(const TimestampQueue &) = delete;
+
+  void push(T item);
+
+  std::optional<T> try_pop();
+
+  /**
+   * @brief Pops the earliest item, waiting while the queue is empty.
+   * @return std::nullopt once the queue is shut down and drained.
+   */
+  std::optional<T> wait_and_pop();
+
+  /**
+   * @brief Moves every item with a timestamp before @p watermark to @p out,
+   * earliest first, under a single lock.
+   * @return The number of items written.
+   */
+  template<std::output_iterator<T> Out> size_t pop_older_than(uint64_t watermark, Out out);
+
+  /**
+   * @brief The earliest timestamp queued, std::nullopt when empty.
+   */
+  std::optional<uint64_t> top_timestamp() const;
+
+  size_t size() const;
+  bool empty() const;
+  void shutdown();
+
+private:
+  TimestampHeap<T, TimestampOf, Arity> m_heap;
+  bool m_shutdown = false;
+  mutable std::mutex m_mutex;
+  std::condition_variable m_cond_variable;
+};
+
+// Template implementation
+template<typename T, typename TimestampOf, size_t Arity> void TimestampHeap<T, TimestampOf, Arity>::reserve(size_t n)
+{
+  m_groups.reserve(n == 0 ? 0 : (n + 2 * Arity - 2) / Arity);
+  m_items.reserve(n);
+}
+
+template<typename T, typename TimestampOf, size_t Arity> void TimestampHeap<T, TimestampOf, Arity>::push(T item)
+{
+  size_t index = m_items.size();
+  if (starts_group(index)) { m_groups.emplace_back(); }
+  try {
+    m_items.push_back(std::move(item));
+  } catch (...) {
+    if (starts_group(index)) { m_groups.pop_back(); }
+    throw;
+  }
+  key(index) = { TimestampOf{}(m_items.back()), m_next_sequence++ };
+  sift_up(index);
+}
+
+template<typename T, typename TimestampOf, size_t Arity> T TimestampHeap<T, TimestampOf, Arity>::pop()
+{
+  T result = std::move(m_items.front());
+  size_t last = m_items.size() - 1;
+  if (last != 0) { move_node(last, 0); }
+  m_items.pop_back();
+  if (starts_group(last)) { m_groups.pop_back(); }
+  if (last != 0) { sift_down(0); }
+  return result;
+}
+
+template<typename T, typename TimestampOf, size_t Arity> std::optional<T> TimestampHeap<T, TimestampOf, Arity>::try_pop()
+{
+  if (empty()) { return std::nullopt; }
+  return pop();
+}
+
+template<typename T, typename TimestampOf, size_t Arity>
+template<std::output_iterator<T> Out>
+size_t TimestampHeap<T, TimestampOf, Arity>::pop_older_than(uint64_t watermark, Out out)
+{
+  size_t n = 0;
+  while (!empty() && top_timestamp() < watermark) {
+    *out = pop();
+    ++out;
+    ++n;
+  }
+  return n;
+}
+
+// Both sifts carry the moving node in locals and shift the others over it,
+// writing it once at its final position.
+template<typename T, typename TimestampOf, size_t Arity>
+void TimestampHeap<T, TimestampOf, Arity>::sift_up(size_t index) noexcept
+{
+  Key moving = key(index);
+  T item = std::move(m_items[index]);
+  while (index > 0) {
+    size_t parent = (index - 1) / Arity;
+    if (!(moving < key(parent))) { break; }
+    move_node(parent, index);
+    index = parent;
+  }
+  key(index) = moving;
+  m_items[index] = std::move(item);
+}
+
+template<typename T, typename TimestampOf, size_t Arity>
+void TimestampHeap<T, TimestampOf, Arity>::sift_down(size_t index) noexcept
+{
+  size_t count = m_items.size();
+  Key moving = key(index);
+  T item = std::move(m_items[index]);
+  while (true) {
+    size_t first = index * Arity + 1;
+    if (first >= count) { break; }
+    // All the children are in one group; a full one is scanned with a
+    // constant trip count.
+    const Key *children = m_groups[index + 1].keys;
+    size_t smallest = 0;
+    if (count - first >= Arity) {
+      for (size_t child = 1; child < Arity; child++) {
+        if (children[child] < children[smallest]) { smallest = child; }
+      }
+    } else {
+      for (size_t child = 1; child < count - first; child++) {
+        if (children[child] < children[smallest]) { smallest = child; }
+      }
+    }
+    if (!(children[smallest] < moving)) { break; }
+    key(index) = children[smallest];
+    m_items[index] = std::move(m_items[first + smallest]);
+    index = first + smallest;
+  }
+  key(index) = moving;
+  m_items[index] = std::move(item);
+}
+
+template<typename T, typename TimestampOf, size_t Arity> void TimestampQueue<T, TimestampOf, Arity>::push(T item)
+{
+  {
+    auto lock = std::lock_guard(m_mutex);
+    m_heap.push(std::move(item));
+  }
+  m_cond_variable.notify_one();
+}
+
+template<typename T, typename TimestampOf, size_t Arity> std::optional<T> TimestampQueue<T, TimestampOf, Arity>::try_pop()
+{
+  auto lock = std::lock_guard(m_mutex);
+  return m_heap.try_pop();
+}
+
+template<typename T, typename TimestampOf, size_t Arity>
+std::optional<T> TimestampQueue<T, TimestampOf, Arity>::wait_and_pop()
+{
+  auto lock = std::unique_lock(m_mutex);
+  m_cond_variable.wait(lock, [this] { return !m_heap.empty() || m_shutdown; });
+  return m_heap.try_pop();
+}
+
+template<typename T, typename TimestampOf, size_t Arity>
+template<std::output_iterator<T> Out>
+size_t TimestampQueue<T, TimestampOf, Arity>::pop_older_than(uint64_t watermark, Out out)
+{
+  auto lock = std::lock_guard(m_mutex);
+  return m_heap.pop_older_than(watermark, out);
+}
+
+template<typename T, typename TimestampOf, size_t Arity>
+std::optional<uint64_t> TimestampQueue<T, TimestampOf, Arity>::top_timestamp() const
+{
+  auto lock = std::lock_guard(m_mutex);
+  if (m_heap.empty()) { return std::nullopt; }
+  return m_heap.top_timestamp();
+}
+
+template<typename T, typename TimestampOf, size_t Arity> size_t TimestampQueue<T, TimestampOf, Arity>::size() const
+{
+  auto lock = std::lock_guard(m_mutex);
+  return m_heap.size();
+}
+
+template<typename T, typename TimestampOf, size_t Arity> bool TimestampQueue<T, TimestampOf, Arity>::empty() const
+{
+  auto lock = std::lock_guard(m_mutex);
+  return m_heap.empty();
+}
+
+template<typename T, typename TimestampOf, size_t Arity> void TimestampQueue<T, TimestampOf, Arity>::shutdown()
+{
+  {
+    auto lock = std::lock_guard(m_mutex);
+    m_shutdown = true;
+  }
+  m_cond_variable.notify_all();
+}
+}// namespace threaded_queue
@@ -0,0 +1,50 @@
+#pragma once
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace threaded_queue {
+
+/**
+ * @brief How a consumer waits for work on an empty queue.
+ *
+ * block:          sleep on a condition variable straight away.
+ * spin_then_park: re-check the queue @p spins times with a pause instruction
+ *                 in between, then @p yields times with a yield, and only then
+ *                 park on a std::atomic wait. Producers skip the notification
+ *                 entirely while nobody is parked.
+ *
+ * Spinning trades CPU time for wake-up latency: a consumer that is still
+ * spinning picks up a new item without a futex wake or a context switch. On
+ * machines with fewer cores than busy threads the spinner only steals time
+ * from the producer, so keep @p spins small there.
+ */
+struct WaitPolicy
+{
+  enum class Kind { block, spin_then_park };
+
+  Kind kind = Kind::block;
+  int spins = 256;
+  int yields = 16;
+
+  static constexpr WaitPolicy block() noexcept { return {}; }
+  static constexpr WaitPolicy spin_then_park(int spins = 256, int yields = 16) noexcept
+  {
+    return { Kind::spin_then_park, spins, yields };
+  }
+};
+
+/**
+ * @brief Tells the CPU we are in a spin loop (x86 pause, Arm yield).
+ */
+inline void cpu_relax() noexcept
+{
+#if defined(__x86_64__) || defined(__i386__)
+  _mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+  asm volatile("yield");
+#endif
+}
+
+}// namespace threaded_queue
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+namespace threaded_queue {
+
+/**
+ * @brief Chase-Lev work-stealing deque.
+ *
+ * One owner thread pushes and pops at the bottom, LIFO, so it keeps working on
+ * what it produced last while that is still in cache. Any number of thieves
+ * steal from the top, FIFO, taking the oldest and usually largest pieces of
+ * work. Owner operations touch no shared cache line unless the deque is
+ * almost empty; a steal costs one CAS.
+ *
+ * The ring grows when full. Old rings are kept until the deque is destroyed,
+ * since a thief may still be reading one.
+ *
+ * Follows Lê, Pop, Cohen and Zappa Nardelli, "Correct and Efficient
+ * Work-Stealing for Weak Memory Models" (PPoPP 2013), with the seq_cst fences
+ * folded into seq_cst loads and stores (ThreadSanitizer does not model
+ * fences). The bottom store in push() is seq_cst as well, so a pusher that
+ * then checks for sleeping thieves cannot miss one that checked the deque.
+ *
+ * @note T is copied in and out with atomic loads and stores, so it must be
+ * trivially copyable; typically a pointer to the work item.
+ */
+template<typename T> class WorkStealingDeque
+{
+  static_assert(std::is_trivially_copyable_v<T>, "WorkStealingDeque stores T in std::atomic");
+
+public:
+  using value_type = T;
+
+  explicit WorkStealingDeque(size_t capacity = 256);
+  WorkStealingDeque(const WorkStealingDeque &) = delete;
+  WorkStealingDeque &operator=(const WorkStealingDeque &) = delete;
+
+  // Owner only.
+  void push(T item);
+  std::optional<T> pop();
+
+  /**
+   * @brief Takes the oldest item; any thread.
+   * @return std::nullopt when the deque is empty or another thread won the race.
+   */
+  std::optional<T> steal();
+
+  /**
+   * @brief Approximate; exact when no operation is in flight.
+   */
+  size_t size() const noexcept;
+  bool empty() const noexcept { return size() == 0; }
+
+private:
+  struct Ring
+  {
+    explicit Ring(size_t capacity) : mask(capacity - 1), cells(new std::atomic<T>[capacity]) {}
+
+    size_t mask;
+    std::unique_ptr<std::atomic<T>[]> cells;
+
+    size_t capacity() const noexcept { return mask + 1; }
+    std::atomic<T> &at(int64_t index) const noexcept { return cells[static_cast<size_t>(index) & mask]; }
+  };
+
+  Ring *grow(Ring *ring, int64_t bottom, int64_t top);
+
+  alignas(64) std::atomic<int64_t> m_top{ 0 };
+  alignas(64) std::atomic<int64_t> m_bottom{ 0 };
+  std::atomic<Ring *> m_ring;
+  std::vector<std::unique_ptr<Ring>> m_rings;// owner only; the last one is current
+};
+
+// Template implementation
+template<typename T> WorkStealingDeque<T>::WorkStealingDeque(size_t capacity)
+{
+  if (capacity == 0) { throw std::invalid_argument("WorkStealingDeque capacity must be non-zero"); }
+  m_rings.push_back(std::make_unique<Ring>(std::bit_ceil(capacity)));
+  m_ring.store(m_rings.back().get(), std::memory_order_relaxed);
+}
+
+template<typename T> auto WorkStealingDeque<T>::grow(Ring *ring, int64_t bottom, int64_t top) -> Ring *
+{
+  m_rings.push_back(std::make_unique<Ring>(2 * ring->capacity()));
+  Ring *bigger = m_rings.back().get();
+  for (int64_t i = top; i < bottom; i++) {
+    bigger->at(i).store(ring->at(i).load(std::memory_order_relaxed), std::memory_order_relaxed);
+  }
+  m_ring.store(bigger, std::memory_order_release);
+  return bigger;
+}
+
+template<typename T> void WorkStealingDeque<T>::push(T item)
+{
+  int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+  int64_t top = m_top.load(std::memory_order_acquire);
+  Ring *ring = m_ring.load(std::memory_order_relaxed);
+  if (bottom - top > static_cast<int64_t>(ring->mask)) { ring = grow(ring, bottom, top); }
+  ring->at(bottom).store(item, std::memory_order_relaxed);
+  m_bottom.store(bottom + 1, std::memory_order_seq_cst);
+}
+
+template<typename T> std::optional<T> WorkStealingDeque<T>::pop()
+{
+  int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+  Ring *ring = m_ring.load(std::memory_order_relaxed);
+  m_bottom.store(bottom, std::memory_order_seq_cst);
+  int64_t top = m_top.load(std::memory_order_seq_cst);
+
+  if (top > bottom) {// empty
+    m_bottom.store(bottom + 1, std::memory_order_relaxed);
+    return std::nullopt;
+  }
+  T item = ring->at(bottom).load(std::memory_order_relaxed);
+  if (top == bottom) {
+    // Last item: race the thieves for it.
+    bool won = m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+    m_bottom.store(bottom + 1, std::memory_order_relaxed);
+    if (!won) { return std::nullopt; }
+  }
+  return item;
+}
+
+template<typename T> std::optional<T> WorkStealingDeque<T>::steal()
+{
+  int64_t top = m_top.load(std::memory_order_seq_cst);
+  int64_t bottom = m_bottom.load(std::memory_order_seq_cst);
+  if (top >= bottom) { return std::nullopt; }
+
+  T item = m_ring.load(std::memory_order_acquire)->at(top).load(std::memory_order_relaxed);
+  if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+    return std::nullopt;
+  }
+  return item;
+}
+
+template<typename T> size_t WorkStealingDeque<T>::size() const noexcept
+{
+  int64_t bottom = m_bottom.load(std::memory_order_seq_cst);
+  int64_t top = m_top.load(std::memory_order_seq_cst);
+  return bottom > top ? static_cast<size_t>(bottom - top) : 0;
+}
+}// namespace threaded_queue
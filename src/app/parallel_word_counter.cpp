@@ -1,6 +1,11 @@
 #include "apps/parallel_word_counter.h"
+#include "objectpool/arena_resource.h"
+#include "threadpool/task_group.h"
+#include <algorithm>
 #include <iostream>
+#include <memory_resource>
 #include <sstream>
+#include <string_view>
 
 namespace apps {
 ParallelWordCounter::ParallelWordCounter(size_t num_threads, std::string filepath)
@@ -58,8 +63,16 @@ auto ParallelWordCounter::GetTotalWordCount(bool print) -> std::map<std::string,
   std::vector<std::string_view> data_per_thread_partition;
   Partition(data_per_thread_partition);
 
-  using task_result = std::map<std::string, int, std::less<>>;
-  std::vector<std::future<task_result>> task_futures;
+  // Each task counts into a pmr map backed by its own arena, so neither the
+  // tree nodes nor the word strings go through malloc on the hot path. The
+  // arenas and maps live here, outside the tasks, because the maps are read
+  // back during the merge below; a TaskGroup waits for all of them at once.
+  using task_result = std::pmr::map<std::pmr::string, int, std::less<>>;
+  auto arenas = std::make_unique<memory::ArenaResource[]>(data_per_thread_partition.size());
+  std::vector<task_result> partials;
+  partials.reserve(data_per_thread_partition.size());
+  for (size_t i = 0; i < data_per_thread_partition.size(); i++) { partials.emplace_back(&arenas[i]); }
+  threadpool::TaskGroup counting(m_thread_pool);
 
 
   auto SkipSeparators = [](const char* ptr, const char* end) -> const char* {
@@ -71,39 +84,45 @@ auto ParallelWordCounter::GetTotalWordCount(bool print) -> std::map<std::string,
     return ptr;
   };
 
-  for (auto chunk : data_per_thread_partition) {
-    auto word_counting_task = [chunk, SkipSeparators, FindNextWord]() -> task_result {
-      task_result per_thread_word_count;
+  for (size_t i = 0; i < data_per_thread_partition.size(); i++) {
+    auto chunk = data_per_thread_partition[i];
+    auto* result = &partials[i];
+    auto word_counting_task = [chunk, result, SkipSeparators, FindNextWord] {
+      task_result& per_thread_word_count = *result;
       const char* ptr = chunk.data();
       const char* end = ptr + chunk.size();
-      std::string word;
-      word.reserve(45); // Assuming english and largest word size of 45.
       while(ptr < end){
         ptr= SkipSeparators(ptr, end);
         const char* start = ptr;
         ptr = FindNextWord(ptr, end);
         if(start < ptr){
-          word.assign(start, static_cast<size_t>(ptr - start));
+          std::string_view word(start, static_cast<size_t>(ptr - start));
           auto iter = per_thread_word_count.find(word);
           if(iter != per_thread_word_count.end()){
             iter->second++;
           }
           else{
-            per_thread_word_count.emplace(std::string(word), 1);
+            per_thread_word_count.emplace(word, 1);
           }
           
         }
       }
-      return per_thread_word_count;
     };
-    task_futures.push_back(m_thread_pool.enqueue(std::move(word_counting_task)));
+    counting.run(std::move(word_counting_task));
   }
+  counting.wait();
 
-  task_result total_word_count;
-  for(auto& f: task_futures){
-    auto partial = f.get();
+  std::map<std::string, int, std::less<>> total_word_count;
+  for(auto& partial: partials){
     for(auto& kv : partial){
-      total_word_count[kv.first] += kv.second;
+      std::string_view word(kv.first);
+      auto iter = total_word_count.find(word);
+      if(iter != total_word_count.end()){
+        iter->second += kv.second;
+      }
+      else{
+        total_word_count.emplace(word, kv.second);
+      }
     }
   }
 
@@ -121,7 +140,7 @@ auto ParallelWordCounter::GetTotalWordCount(bool print) -> std::map<std::string,
 int main(int /*argc*/, char* /*argv*/[]){
 
   auto total_hardware_threads = std::thread::hardware_concurrency();
-  auto parser_thread_count = std::min(total_hardware_threads/4, 2U);
+  auto parser_thread_count = std::clamp(total_hardware_threads/4, 1U, 2U);// 0 on small hosts otherwise
   std::string filename("sample_text.txt");
   apps::ParallelWordCounter word_counter(static_cast<size_t>(parser_thread_count), filename);
   auto output = word_counter.GetTotalWordCount(true);
@@ -1,17 +1,46 @@
 #include "messagequeue/message_queue.h"
+#include <algorithm>
+
+MessageQueue::MessageQueue(std::pmr::memory_resource *resource) : m_queue(resource) {}
 
 bool MessageQueue::empty() const { return m_queue.empty(); }
 
 size_t MessageQueue::size() const { return m_queue.size(); }
 
-std::optional<std::unique_ptr<Message>> MessageQueue::try_pop()
+std::optional<memory::pooled_ptr<Message>> MessageQueue::try_pop()
 {
   if (m_queue.empty()) { return std::nullopt; }
   // Considering that m_queue front and pop_front provide noexcept
   // A subtle issue of move, exception and left with a dangling unique_ptr exception wont happen.
-  auto output = std::move(m_queue.front());
+  m_stats.on_dequeue(m_queue.front().stamp);
+  auto output = std::move(m_queue.front().msg);
   m_queue.pop_front();
   return output;
 }
 
-void MessageQueue::push(std::unique_ptr<Message> msg) { m_queue.push_back(std::move(msg)); }
\ No newline at end of file
+void MessageQueue::push(memory::pooled_ptr<Message> msg)
+{
+  m_queue.push_back({ std::move(msg), Stats::now() });
+  m_stats.on_enqueue(m_queue.size());
+}
+
+void MessageQueue::push_bulk(std::span<memory::pooled_ptr<Message>> msgs)
+{
+  auto stamp = Stats::now();
+  for (auto &msg : msgs) { m_queue.push_back({ std::move(msg), stamp }); }
+  m_stats.on_enqueue(m_queue.size(), msgs.size());
+}
+
+size_t MessageQueue::pop_bulk(std::vector<memory::pooled_ptr<Message>> &out, size_t max_n)
+{
+  size_t n = std::min(max_n, m_queue.size());
+  auto last = m_queue.begin() + static_cast<std::ptrdiff_t>(n);
+  for (auto it = m_queue.begin(); it != last; ++it) {
+    m_stats.on_dequeue(it->stamp);
+    out.push_back(std::move(it->msg));
+  }
+  m_queue.erase(m_queue.begin(), last);
+  return n;
+}
+
+threaded_queue::QueueStatsSnapshot MessageQueue::stats() const { return m_stats.snapshot(); }
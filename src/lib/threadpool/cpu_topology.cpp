@@ -0,0 +1,175 @@
+#include "threadpool/cpu_topology.h"
+#include <algorithm>
+#include <charconv>
+#include <iterator>
+#include <map>
+#include <tuple>
+#include <utility>
+
+#if defined(__linux__)
+#include <filesystem>
+#include <fstream>
+#include <pthread.h>
+#include <sched.h>
+#include <string>
+#endif
+
+namespace threadpool {
+
+namespace {
+#if defined(__linux__)
+  int read_int(const std::filesystem::path &path, int fallback)
+  {
+    std::ifstream file(path);
+    int value = 0;
+    if (file >> value) { return value; }
+    return fallback;
+  }
+
+  // sysfs links every CPU directory to its node as "node<N>".
+  int node_of(const std::filesystem::path &cpu_dir)
+  {
+    std::error_code error;
+    for (const auto &entry : std::filesystem::directory_iterator(cpu_dir, error)) {
+      std::string name = entry.path().filename().string();
+      if (name.size() <= 4 || name.compare(0, 4, "node") != 0) { continue; }
+      int node = -1;
+      auto [end, parsed] = std::from_chars(name.data() + 4, name.data() + name.size(), node);
+      if (parsed == std::errc{} && end == name.data() + name.size()) { return node; }
+    }
+    return -1;
+  }
+#endif
+
+  auto compact_key(const CpuInfo &info) { return std::tuple(info.node, info.package, info.core, info.cpu); }
+}// namespace
+
+CpuTopology CpuTopology::detect()
+{
+  std::vector<CpuInfo> cpus;
+#if defined(__linux__)
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if (::sched_getaffinity(0, sizeof(allowed), &allowed) != 0) { return {}; }
+  for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if (!CPU_ISSET(static_cast<size_t>(cpu), &allowed)) { continue; }
+    std::filesystem::path dir = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+    CpuInfo &info = cpus.emplace_back();
+    info.cpu = cpu;
+    info.core = read_int(dir / "topology" / "core_id", cpu);
+    info.package = read_int(dir / "topology" / "physical_package_id", cpu);
+    info.node = node_of(dir);
+  }
+#endif
+  return CpuTopology(std::move(cpus));
+}
+
+CpuTopology::CpuTopology(std::vector<CpuInfo> cpus) : m_cpus(std::move(cpus))
+{
+  std::sort(m_cpus.begin(), m_cpus.end(), [](const CpuInfo &a, const CpuInfo &b) { return a.cpu < b.cpu; });
+}
+
+const CpuInfo *CpuTopology::find(int cpu) const noexcept
+{
+  auto it = std::lower_bound(
+    m_cpus.begin(), m_cpus.end(), cpu, [](const CpuInfo &info, int id) { return info.cpu < id; });
+  return it != m_cpus.end() && it->cpu == cpu ? &*it : nullptr;
+}
+
+CpuTopology CpuTopology::on_node(int node) const
+{
+  std::vector<CpuInfo> cpus;
+  std::copy_if(m_cpus.begin(), m_cpus.end(), std::back_inserter(cpus), [node](const CpuInfo &info) {
+    return info.node == node;
+  });
+  return CpuTopology(std::move(cpus));
+}
+
+std::vector<int> CpuTopology::order(CpuLayout layout) const
+{
+  if (layout == CpuLayout::none) { return {}; }
+
+  std::vector<CpuInfo> compact = m_cpus;
+  std::sort(compact.begin(), compact.end(), [](const CpuInfo &a, const CpuInfo &b) {
+    return compact_key(a) < compact_key(b);
+  });
+
+  std::vector<CpuInfo> ordered;
+  if (layout == CpuLayout::compact) {
+    ordered = std::move(compact);
+  } else if (layout == CpuLayout::physical_cores) {
+    std::unique_copy(compact.begin(), compact.end(), std::back_inserter(ordered), [](const CpuInfo &a, const CpuInfo &b) {
+      return a.package == b.package && a.core == b.core;
+    });
+  } else {
+    // Rank every CPU by its hyperthread sibling index, then by its core within
+    // the socket, then by socket; walking that order visits every socket once
+    // before any socket gets a second core.
+    using Socket = std::pair<int, int>;// node, package
+    std::map<Socket, int> sockets;
+    std::map<std::tuple<int, int, int>, int> cores;// node, package, core -> rank in socket
+    std::map<std::tuple<int, int, int>, int> siblings;// hardware threads seen per core
+    std::map<Socket, int> cores_per_socket;
+    std::vector<std::tuple<int, int, int, CpuInfo>> ranked;
+    for (const CpuInfo &info : compact) {
+      Socket socket{ info.node, info.package };
+      auto [socket_it, new_socket] = sockets.try_emplace(socket, static_cast<int>(sockets.size()));
+      std::tuple core{ info.node, info.package, info.core };
+      auto [core_it, new_core] = cores.try_emplace(core, cores_per_socket[socket]);
+      if (new_core) { cores_per_socket[socket]++; }
+      ranked.emplace_back(siblings[core]++, core_it->second, socket_it->second, info);
+    }
+    std::sort(ranked.begin(), ranked.end(), [](const auto &a, const auto &b) {
+      return std::tie(std::get<0>(a), std::get<1>(a), std::get<2>(a))
+             < std::tie(std::get<0>(b), std::get<1>(b), std::get<2>(b));
+    });
+    for (const auto &entry : ranked) { ordered.push_back(std::get<3>(entry)); }
+  }
+
+  std::vector<int> ids;
+  ids.reserve(ordered.size());
+  for (const CpuInfo &info : ordered) { ids.push_back(info.cpu); }
+  return ids;
+}
+
+bool pin_current_thread(const std::vector<int> &cpus) noexcept
+{
+#if defined(__linux__)
+  if (cpus.empty()) { return false; }
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int cpu : cpus) {
+    if (cpu >= 0 && cpu < CPU_SETSIZE) { CPU_SET(static_cast<size_t>(cpu), &set); }
+  }
+  return ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set) == 0;
+#else
+  (void)cpus;
+  return false;
+#endif
+}
+
+bool name_current_thread(std::string_view name) noexcept
+{
+#if defined(__linux__)
+  char truncated[16] = {};// the kernel limit, including the terminator
+  name.copy(truncated, sizeof(truncated) - 1);
+  return ::pthread_setname_np(::pthread_self(), truncated) == 0;
+#else
+  (void)name;
+  return false;
+#endif
+}
+
+bool name_current_thread(std::string_view name, size_t index) noexcept
+{
+  char suffix[24] = { '-' };
+  auto end = std::to_chars(suffix + 1, suffix + sizeof(suffix), index).ptr;
+  std::string_view tail(suffix, static_cast<size_t>(end - suffix));
+  char combined[16] = {};// the kernel limit, including the terminator
+  size_t keep = std::min(name.size(), tail.size() < 15 ? 15 - tail.size() : 0);
+  name.copy(combined, keep);
+  tail.copy(combined + keep, sizeof(combined) - 1 - keep);
+  return name_current_thread(std::string_view(combined));
+}
+
+}// namespace threadpool
@@ -0,0 +1,172 @@
+#include "threadpool/task_graph.h"
+#include <stdexcept>
+#include <utility>
+
+namespace threadpool {
+
+TaskGraph::NodeId TaskGraph::add(Task work, std::initializer_list<NodeId> predecessors, std::string name)
+{
+  for (NodeId before : predecessors) {
+    if (before >= m_nodes.size()) { throw std::invalid_argument("TaskGraph predecessor does not exist"); }
+  }
+  NodeId id = m_nodes.size();
+  Node &node = m_nodes.emplace_back();
+  node.work = std::move(work);
+  node.name = std::move(name);
+  for (NodeId before : predecessors) { precede(before, id); }
+  m_validated = false;
+  return id;
+}
+
+void TaskGraph::precede(NodeId before, NodeId after)
+{
+  if (before >= m_nodes.size() || after >= m_nodes.size()) {
+    throw std::invalid_argument("TaskGraph node does not exist");
+  }
+  m_nodes[before].successors.push_back(after);
+  m_nodes[after].predecessor_count++;
+  m_validated = false;
+}
+
+// Kahn's algorithm: if repeatedly removing nodes without predecessors does not
+// remove them all, the rest sit on a cycle.
+void TaskGraph::validate()
+{
+  std::vector<uint32_t> pending(m_nodes.size());
+  std::vector<NodeId> ready;
+  m_roots.clear();
+  for (NodeId id = 0; id < m_nodes.size(); id++) {
+    pending[id] = m_nodes[id].predecessor_count;
+    if (pending[id] == 0) {
+      m_roots.push_back(id);
+      ready.push_back(id);
+    }
+  }
+  size_t visited = 0;
+  while (!ready.empty()) {
+    NodeId id = ready.back();
+    ready.pop_back();
+    visited++;
+    for (NodeId next : m_nodes[id].successors) {
+      if (--pending[next] == 0) { ready.push_back(next); }
+    }
+  }
+  if (visited != m_nodes.size()) { throw std::invalid_argument("TaskGraph has a cycle"); }
+  for (Node &node : m_nodes) { node.pending.store(node.predecessor_count, std::memory_order_relaxed); }
+  m_validated = true;
+}
+
+void TaskGraph::run(ThreadPool &pool)
+{
+  if (!m_validated) { validate(); }
+  if (m_nodes.empty()) { return; }
+
+  m_pool = &pool;
+  m_failed.store(false, std::memory_order_relaxed);
+  m_error = nullptr;
+  m_remaining.store(m_nodes.size(), std::memory_order_relaxed);
+  m_finished = false;
+  m_abandoned.assign(m_nodes.size(), 0);
+  m_unreached.reserve(m_nodes.size());// abandon() must not allocate
+  m_any_abandoned = false;
+  m_started = std::chrono::steady_clock::now();
+
+  for (size_t i = 1; i < m_roots.size(); i++) { release(m_roots[i]); }
+  execute(m_roots.front());
+
+  // Help with queued tasks rather than block, so a task of the pool can run
+  // a graph on it; sleep only once the rest is running elsewhere.
+  while (m_remaining.load(std::memory_order_acquire) != 0 && pool.run_pending_task()) {}
+  {
+    auto lock = std::unique_lock(m_done_mutex);
+    m_done.wait(lock, [this] { return m_finished; });
+  }
+  m_elapsed = since_start();
+  // Abandoned nodes keep counters that are partly counted down; start the
+  // next run from scratch.
+  if (m_any_abandoned) { m_validated = false; }
+  if (m_error) { std::rethrow_exception(std::exchange(m_error, nullptr)); }
+}
+
+void TaskGraph::release(NodeId node) noexcept
+{
+  try {
+    m_pool->submit([this, node] { execute(node); });
+  } catch (...) {
+    fail(std::current_exception());
+    abandon(node);
+  }
+}
+
+// node and everything downstream of it can no longer run: each of them waits
+// on a predecessor that never finishes. Takes them off m_remaining, once each
+// even when several releases fail.
+void TaskGraph::abandon(NodeId node) noexcept
+{
+  auto lock = std::lock_guard(m_done_mutex);
+  m_any_abandoned = true;
+  size_t count = 0;
+  if (!m_abandoned[node]) {
+    m_abandoned[node] = 1;
+    m_unreached.push_back(node);
+  }
+  while (!m_unreached.empty()) {
+    NodeId id = m_unreached.back();
+    m_unreached.pop_back();
+    count++;
+    for (NodeId next : m_nodes[id].successors) {
+      if (!m_abandoned[next]) {
+        m_abandoned[next] = 1;
+        m_unreached.push_back(next);
+      }
+    }
+  }
+  if (count > 0 && m_remaining.fetch_sub(count, std::memory_order_acq_rel) == count) {
+    m_finished = true;
+    m_done.notify_one();
+  }
+}
+
+void TaskGraph::fail(std::exception_ptr error) noexcept
+{
+  if (!m_failed.exchange(true, std::memory_order_relaxed)) { m_error = std::move(error); }
+}
+
+void TaskGraph::execute(NodeId id)
+{
+  while (id != kNone) {
+    Node &node = m_nodes[id];
+    // Every predecessor has finished, so nothing else touches the counter
+    // until the next run.
+    node.pending.store(node.predecessor_count, std::memory_order_relaxed);
+
+    node.timing.start = since_start();
+    if (!m_failed.load(std::memory_order_relaxed)) {
+      try {
+        node.work();
+      } catch (...) {
+        fail(std::current_exception());
+      }
+    }
+    node.timing.end = since_start();
+
+    NodeId next = kNone;
+    for (NodeId successor : node.successors) {
+      if (m_nodes[successor].pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        if (next != kNone) { release(next); }
+        next = successor;
+      }
+    }
+    // next, if any, is still unfinished, so this cannot be the last node.
+    if (m_remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      // Signalled under the lock, so run() cannot return, and the graph go
+      // away, while this thread still uses it.
+      auto lock = std::lock_guard(m_done_mutex);
+      m_finished = true;
+      m_done.notify_one();
+    }
+    id = next;
+  }
+}
+
+}// namespace threadpool
@@ -0,0 +1,41 @@
+#include "threadpool/task_group.h"
+
+namespace threadpool {
+
+void TaskGroup::add_exception(std::exception_ptr error)
+{
+  auto lock = std::lock_guard(m_mutex);
+  m_exceptions.push_back(std::move(error));
+}
+
+void TaskGroup::finish()
+{
+  size_t pending = m_pending.load(std::memory_order_relaxed);
+  while (pending > 1) {
+    if (m_pending.compare_exchange_weak(pending, pending - 1, std::memory_order_acq_rel)) { return; }
+  }
+  // Maybe the last task. It decrements under the lock, so join() cannot
+  // return, and the group go away, while this thread still signals.
+  auto lock = std::lock_guard(m_mutex);
+  if (m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) { m_done.notify_all(); }
+}
+
+std::vector<std::exception_ptr> TaskGroup::join()
+{
+  while (m_pending.load(std::memory_order_acquire) != 0) {
+    if (m_pool->run_pending_task()) { continue; }
+    // Nothing queued to help with: the rest is running elsewhere.
+    auto lock = std::unique_lock(m_mutex);
+    m_done.wait(lock, [this] { return m_pending.load(std::memory_order_acquire) == 0; });
+  }
+  auto lock = std::lock_guard(m_mutex);
+  return std::exchange(m_exceptions, {});
+}
+
+void TaskGroup::wait()
+{
+  auto exceptions = join();
+  if (!exceptions.empty()) { std::rethrow_exception(exceptions.front()); }
+}
+
+}// namespace threadpool
@@ -1,47 +1,648 @@
 ﻿#include "threadpool/threadpool.h"
+#include "objectpool/slab_allocator.h"
 #include "threadsafequeue/thread_safe_queue.h"
-#include <functional>
+#include "threadsafequeue/work_stealing_deque.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <memory_resource>
+#include <mutex>
 #include <optional>
+#include <stdexcept>
+#include <string>
 #include <thread>
 #include <vector>
 
+namespace {
+// The pool and worker the current thread belongs to, so a task that enqueues
+// more work can put it on its own worker's deque.
+struct WorkerContext {
+  const void* pool = nullptr;
+  size_t index = 0;
+  int cpu = -1;
+  int node = -1;
+};
+thread_local WorkerContext tl_worker;
+
+// The CPUs one worker may run on; empty leaves it to the OS.
+struct Placement {
+  std::vector<int> cpus;
+  int cpu = -1;
+  int node = -1;
+};
+
+// Placements for worker slots [0, count).
+std::vector<Placement> place_workers(const ThreadPool::Options& options, size_t count) {
+  std::vector<Placement> placements(count);
+  bool pinned = !options.cpus.empty() || options.layout != threadpool::CpuLayout::none || options.numa_node >= 0;
+  if (!pinned || count == 0) return placements;
+
+  auto topology = threadpool::CpuTopology::detect();
+  if (!options.cpus.empty()) {
+    for (size_t i = 0; i < count; ++i) {
+      int cpu = options.cpus[i % options.cpus.size()];
+      const auto* info = topology.find(cpu);
+      if (info == nullptr) throw std::invalid_argument("ThreadPool cpu " + std::to_string(cpu) + " is not available");
+      placements[i] = { { cpu }, cpu, info->node };
+    }
+    return placements;
+  }
+
+  if (options.numa_node >= 0) {
+    topology = topology.on_node(options.numa_node);
+    if (topology.empty()) {
+      throw std::invalid_argument("ThreadPool NUMA node " + std::to_string(options.numa_node) + " has no available cpus");
+    }
+  }
+  std::vector<int> order = topology.order(options.layout);
+  for (size_t i = 0; i < count; ++i) {
+    if (order.empty()) { // numa_node without a layout: anywhere on the node
+      placements[i].node = options.numa_node;
+      for (const auto& info : topology.cpus()) placements[i].cpus.push_back(info.cpu);
+      continue;
+    }
+    int cpu = order[i % order.size()];
+    placements[i] = { { cpu }, cpu, topology.find(cpu)->node };
+  }
+  return placements;
+}
+
+int64_t now_ns() noexcept {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+    .count();
+}
+} // namespace
+
 class ThreadPool::Impl {
 public:
-  explicit Impl(size_t num_threads) {
-    m_workers.reserve(num_threads);
-    for (size_t i = 0; i < num_threads; ++i) {
-      m_workers.emplace_back([this] { worker_loop(); });
+  using Task = threadpool::Task;
+
+  explicit Impl(const Options& options)
+    : m_wait(options.wait), m_scheduling(options.scheduling), m_reserved(options.reserved_high),
+      m_slots(std::max(options.threads, options.max_threads)), m_name(options.name),
+      m_grow_after(options.grow_after), m_grow_depth(options.grow_depth), m_idle_timeout(options.idle_timeout) {
+    if (m_grow_after <= std::chrono::milliseconds::zero()) {
+      throw std::invalid_argument("ThreadPool grow_after must be positive");
+    }
+    check_bounds(options.threads, m_slots.size());
+    if (m_scheduling == Scheduling::work_stealing) {
+      for (size_t i = 0; i < m_slots.size(); ++i) {
+        m_deques.push_back(std::make_unique<threaded_queue::WorkStealingDeque<Task*>>());
+      }
+    }
+    m_placements = place_workers(options, m_slots.size());
+    for (auto& slot : m_slots) slot = std::make_unique<Worker>();
+    if (options.trace) {
+      // One ring per worker slot and one for threads outside the pool.
+      m_tracer = std::make_unique<threadpool::TraceRecorder>(m_slots.size() + 1, options.trace_capacity);
     }
+
+    auto lock = std::unique_lock(m_resize_mutex);
+    m_min = options.threads;
+    m_max = m_slots.size();
+    while (m_active.load(std::memory_order_relaxed) < m_min) spawn();
+    if (m_max > m_min) m_supervisor = std::thread([this] { supervise(); });
   }
 
   ~Impl() {
-    m_task_queue.shutdown();
-    for (auto& worker : m_workers) {
-      if (worker.joinable()) worker.join();
+    {
+      auto lock = std::unique_lock(m_resize_mutex);
+      m_stopping.store(true, std::memory_order_seq_cst);
+    }
+    m_supervisor_wake.notify_all();
+    if (m_supervisor.joinable()) m_supervisor.join();
+    for (Sleep* sleep : { &m_general, &m_reserved_sleep }) wake_all(*sleep);
+    for (auto& slot : m_slots) {
+      if (slot->thread.joinable()) slot->thread.join();
+    }
+    for (auto& deque : m_deques) { // workers drain their deques, this is just in case
+      while (auto task = deque->pop()) m_nodes.delete_object(*task);
+    }
+  }
+
+  void enqueue_task(Task fn, Priority priority) {
+    if (m_tracer) fn = traced(std::move(fn));
+    if (priority == Priority::normal && !m_deques.empty() && tl_worker.pool == this) {
+      Task* node = m_nodes.new_object<Task>(std::move(fn));
+      auto& pushed = m_slots[tl_worker.index]->deque_pushed;
+      pushed.fetch_add(1, std::memory_order_seq_cst);
+      try {
+        m_deques[tl_worker.index]->push(node);
+      } catch (...) {
+        m_nodes.delete_object(node);
+        uncount(pushed);
+        throw;
+      }
+      wake(m_general);
+      return;
+    }
+    Lane& lane = m_lanes[static_cast<size_t>(priority)];
+    lane.pushed.fetch_add(1, std::memory_order_seq_cst);
+    try {
+      lane.queue.push(std::move(fn));
+    } catch (...) {
+      uncount(lane.pushed);
+      throw;
+    }
+    if (priority == Priority::high && m_reserved > 0 && wake(m_reserved_sleep)) return;
+    wake(m_general);
+  }
+
+  void resize(size_t min_threads, size_t max_threads) {
+    auto lock = std::unique_lock(m_resize_mutex);
+    if (max_threads > m_slots.size()) throw std::invalid_argument("ThreadPool cannot grow past its max_threads");
+    check_bounds(min_threads, max_threads);
+    m_min = min_threads;
+    m_max = max_threads;
+    while (m_active.load(std::memory_order_relaxed) < m_min) spawn();
+    while (m_active.load(std::memory_order_relaxed) > m_max) retire();
+    if (m_max > m_min && !m_supervisor.joinable()) m_supervisor = std::thread([this] { supervise(); });
+  }
+
+  size_t size() const noexcept { return m_active.load(std::memory_order_relaxed); }
+
+  // Runs one queued task on the calling thread: a worker of this pool looks
+  // where it would in its own loop, any other thread takes the lanes in
+  // priority order and then steals from the deques.
+  bool run_pending_task() {
+    if (tl_worker.pool == this) {
+      uint64_t rng = 0x9E3779B97F4A7C15ULL * (tl_worker.index + 1);
+      return run_one(tl_worker.index, rng, 0);
+    }
+    size_t external = m_slots.size();
+    for (Priority priority : { Priority::high, Priority::normal, Priority::low }) {
+      if (run_from(priority, external)) return true;
+    }
+    for (auto& deque : m_deques) {
+      if (auto task = deque->steal()) {
+        run(*task, external);
+        return true;
+      }
     }
+    return false;
   }
 
-  void enqueue_task(std::function<void()> fn) {
-    m_task_queue.push(std::make_unique<std::function<void()>>(std::move(fn)));
+  void wait_idle() {
+    if (tl_worker.pool == this) throw std::logic_error("ThreadPool::wait_idle called from one of its own tasks");
+    struct Waiting {
+      std::atomic<size_t>& waiters;
+      explicit Waiting(std::atomic<size_t>& count) : waiters(count) { waiters.fetch_add(1, std::memory_order_seq_cst); }
+      ~Waiting() { waiters.fetch_sub(1, std::memory_order_seq_cst); }
+    } waiting(m_idle_waiters);
+    size_t external = m_slots.size();
+    while (!idle()) {
+      if (run_pending_task()) continue;
+      // Sleeps until a task finishes: finished() checks m_idle_waiters after
+      // counting the task, and idle() reads the counts after it was raised.
+      auto lock = std::unique_lock(m_idle_mutex);
+      m_idle.wait(lock, [this, external] { return idle() || has_work(external); });
+    }
+  }
+
+  void write_trace(std::ostream& out) const {
+    std::vector<std::string> names;
+    for (size_t i = 0; i < m_slots.size(); ++i) names.push_back(m_name + "-" + std::to_string(i));
+    names.push_back(m_name + "-external");
+    if (m_tracer) {
+      m_tracer->write_chrome_json(out, names);
+    } else {
+      threadpool::TraceRecorder(0, 1).write_chrome_json(out, {});
+    }
   }
 
+  threadpool::TraceStats trace_stats() const { return m_tracer ? m_tracer->stats() : threadpool::TraceStats{}; }
+
 private:
-  std::vector<std::thread> m_workers;
-  threaded_queue::ThreadSafeQueue<std::function<void()>> m_task_queue;
+  // One queue per Priority, indexed by its value. pushed and popped only grow;
+  // their difference is the depth, which may briefly read one high while a
+  // push is under way. pushed counts a task before it is in the queue, so
+  // it cannot finish uncounted (see idle()). The supervisor compares popped
+  // between samples to see whether tasks wait.
+  struct Lane {
+    threaded_queue::ThreadSafeValueQueue<Task> queue;
+    alignas(64) std::atomic<uint64_t> pushed{ 0 };
+    alignas(64) std::atomic<uint64_t> popped{ 0 };
+
+    int64_t depth() const noexcept {
+      return static_cast<int64_t>(pushed.load(std::memory_order_seq_cst) - popped.load(std::memory_order_seq_cst));
+    }
+  };
+
+  // A worker thread slot. Active workers always fill the slots [0, size()):
+  // growing starts the next slot, shrinking retires the last one. A retiring
+  // worker finishes its current task and its own deque, then exits; growing
+  // again before it has exited simply takes it back.
+  enum class State : uint8_t { stopped, running, retiring };
+  struct Worker {
+    std::thread thread;
+    std::atomic<State> state{ State::stopped };
+    std::atomic<int64_t> idle_since{ 0 }; // steady clock ns since parked, 0 while awake
+    std::atomic<uint64_t> deque_pushed{ 0 }; // tasks it put on its own deque
+    std::atomic<uint64_t> finished{ 0 }; // tasks it ran
+  };
+
+  // Workers sleeping on one epoch. Reserved workers get their own, so a
+  // wake-up meant for work they cannot take never lands on them.
+  struct Sleep {
+    std::atomic<int> sleepers{ 0 };
+    std::atomic<uint32_t> epoch{ 0 }; // bumped to wake sleeping workers
+    std::atomic<bool> notified{ false }; // a wake-up is on its way to a sleeper
+  };
+
+  // Every kNormalTurn-th pick a worker looks at the normal lane first, every
+  // kLowTurn-th at the low lane, so under a stream of high priority work the
+  // lower lanes still get 3/16 and 1/16 of each worker's picks.
+  static constexpr uint32_t kNormalTurn = 4;
+  static constexpr uint32_t kLowTurn = 16;
+
+  threaded_queue::WaitPolicy m_wait;
+  Scheduling m_scheduling;
+  size_t m_reserved; // workers [0, m_reserved) only run high priority tasks
+  std::vector<std::unique_ptr<Worker>> m_slots; // one per possible worker, max_threads of them
+  std::vector<Placement> m_placements; // per slot
+  std::string m_name;
+  std::unique_ptr<threadpool::TraceRecorder> m_tracer; // only with Options::trace
+  std::array<Lane, 3> m_lanes;
+
+  // Elasticity. Slot threads, m_min and m_max are guarded by m_resize_mutex.
+  std::chrono::milliseconds m_grow_after;
+  size_t m_grow_depth;
+  std::chrono::milliseconds m_idle_timeout;
+  std::mutex m_resize_mutex;
+  std::condition_variable m_supervisor_wake;
+  std::thread m_supervisor;
+  size_t m_min = 0;
+  size_t m_max = 0;
+  std::atomic<size_t> m_active{ 0 };
+
+  // wait_idle(). Threads that are not workers count the tasks they help run
+  // in m_external_finished.
+  alignas(64) std::atomic<uint64_t> m_external_finished{ 0 };
+  alignas(64) std::atomic<size_t> m_idle_waiters{ 0 };
+  std::mutex m_idle_mutex;
+  std::condition_variable m_idle;
+
+  // Work-stealing state.
+  std::vector<std::unique_ptr<threaded_queue::WorkStealingDeque<Task*>>> m_deques;
+  std::pmr::polymorphic_allocator<Task> m_nodes{ threadpool::task_resource() }; // deque entries
+
+  Sleep m_general;
+  Sleep m_reserved_sleep;
+  std::atomic<bool> m_stopping{ false };
+
+  bool reserved(size_t index) const noexcept { return index < m_reserved; }
+  Sleep& sleep_of(size_t index) noexcept { return reserved(index) ? m_reserved_sleep : m_general; }
+
+  void check_bounds(size_t min_threads, size_t max_threads) const {
+    if (m_reserved > 0 && m_reserved >= min_threads) {
+      throw std::invalid_argument("ThreadPool needs at least one worker that is not reserved");
+    }
+    if (min_threads > max_threads) throw std::invalid_argument("ThreadPool min_threads exceeds max_threads");
+  }
+
+  // Starts a worker in the first free slot. Called with m_resize_mutex held.
+  void spawn() {
+    size_t index = m_active.load(std::memory_order_relaxed);
+    Worker& slot = *m_slots[index];
+    auto retiring = State::retiring;
+    if (!slot.state.compare_exchange_strong(retiring, State::running, std::memory_order_seq_cst)) {
+      if (slot.thread.joinable()) slot.thread.join(); // it has exited or is about to
+      slot.state.store(State::running, std::memory_order_seq_cst);
+      slot.thread = std::thread([this, index] {
+        const Placement& placement = m_placements[index];
+        if (!placement.cpus.empty()) threadpool::pin_current_thread(placement.cpus);
+        threadpool::name_current_thread(m_name, index);
+        tl_worker = { this, index, placement.cpu, placement.node };
+        worker_loop(index);
+      });
+    }
+    m_active.store(index + 1, std::memory_order_relaxed);
+  }
+
+  // Retires the worker in the last active slot. Called with m_resize_mutex held.
+  void retire() {
+    size_t index = m_active.load(std::memory_order_relaxed) - 1;
+    m_slots[index]->state.store(State::retiring, std::memory_order_seq_cst);
+    m_active.store(index, std::memory_order_relaxed);
+    wake_all(sleep_of(index)); // it may be parked
+  }
+
+  // Adds a worker when a task has been queued for a whole sample period, or
+  // when more than m_grow_depth tasks are queued; otherwise retires the
+  // highest workers while they have been parked for m_idle_timeout.
+  void supervise() {
+    std::array<int64_t, 3> last_depth{};
+    std::array<uint64_t, 3> last_popped{};
+    std::vector<int64_t> last_deque_depth(m_deques.size());
+    std::vector<uint64_t> last_deque_taken(m_deques.size());
+    auto lock = std::unique_lock(m_resize_mutex);
+    while (!m_stopping.load(std::memory_order_relaxed)) {
+      m_supervisor_wake.wait_for(lock, m_grow_after);
+      if (m_stopping.load(std::memory_order_relaxed)) return;
+
+      // FIFO lanes: if fewer tasks left a lane than it held at the last
+      // sample, one of those has waited at least m_grow_after.
+      bool waited = false;
+      int64_t depth = 0;
+      for (size_t lane = 0; lane < m_lanes.size(); ++lane) {
+        uint64_t popped = m_lanes[lane].popped.load(std::memory_order_relaxed);
+        int64_t lane_depth = m_lanes[lane].depth();
+        waited = waited || static_cast<int64_t>(popped - last_popped[lane]) < last_depth[lane];
+        depth += std::max<int64_t>(lane_depth, 0);
+        last_popped[lane] = popped;
+        last_depth[lane] = lane_depth;
+      }
+      // The same test on the deques, whatever order they are taken from:
+      // fewer taken than were held means one of those is still there.
+      for (size_t index = 0; index < m_deques.size(); ++index) {
+        auto deque_depth = static_cast<int64_t>(m_deques[index]->size());
+        uint64_t taken = m_slots[index]->deque_pushed.load(std::memory_order_relaxed) - static_cast<uint64_t>(deque_depth);
+        waited = waited || static_cast<int64_t>(taken - last_deque_taken[index]) < last_deque_depth[index];
+        depth += deque_depth;
+        last_deque_taken[index] = taken;
+        last_deque_depth[index] = deque_depth;
+      }
+      bool deep = m_grow_depth > 0 && depth > static_cast<int64_t>(m_grow_depth);
+      size_t active = m_active.load(std::memory_order_relaxed);
+      if ((waited || deep) && active < m_max) {
+        spawn();
+        continue;
+      }
 
-  void worker_loop() {
+      // Active workers are always the lowest slots, so only the highest can
+      // go; a busy one there keeps idle ones below it until it idles too.
+      int64_t idle_before = now_ns() - std::chrono::duration_cast<std::chrono::nanoseconds>(m_idle_timeout).count();
+      while (active > m_min) {
+        int64_t since = m_slots[active - 1]->idle_since.load(std::memory_order_relaxed);
+        if (since == 0 || since > idle_before) break;
+        retire();
+        --active;
+      }
+    }
+  }
+
+  void worker_loop(size_t index) {
+    // xorshift state for picking victims, distinct per worker
+    uint64_t rng = 0x9E3779B97F4A7C15ULL * (index + 1);
+    uint32_t tick = 0;
+    Worker& self = *m_slots[index];
+    Sleep& sleep = sleep_of(index);
     while (true) {
-      auto task_opt = m_task_queue.wait_and_pop();
-      if (!task_opt) return; // shutdown signaled
-      (**task_opt)(); // optional -> unique_ptr -> function
+      if (self.state.load(std::memory_order_relaxed) == State::retiring && !has_own_work(index)) {
+        auto retiring = State::retiring;
+        if (self.state.compare_exchange_strong(retiring, State::stopped, std::memory_order_seq_cst)) return;
+      }
+      if (run_one(index, rng, tick++)) continue;
+      if (spin_for_work(index)) continue;
+      if (!park(index, self, sleep)) return;
+    }
+  }
+
+  // Wraps fn to record its run in the calling worker's ring.
+  Task traced(Task fn) {
+    return [this, fn = std::move(fn), enqueued = m_tracer->now(), label = threadpool::TraceLabel::current()]() mutable {
+      threadpool::TraceEvent event{ enqueued, m_tracer->now(), 0, m_slots.size(), label };
+      if (tl_worker.pool == this) event.worker = tl_worker.index;
+      try {
+        fn();
+      } catch (...) {
+        event.end = m_tracer->now();
+        m_tracer->record(event);
+        throw;
+      }
+      event.end = m_tracer->now();
+      m_tracer->record(event);
+    };
+  }
+
+  bool has_own_work(size_t index) const noexcept { return !m_deques.empty() && !m_deques[index]->empty(); }
+
+  bool run_one(size_t index, uint64_t& rng, uint32_t tick) {
+    if (reserved(index)) return run_from(Priority::high, index);
+    Priority first = Priority::high;
+    if (tick % kLowTurn == kLowTurn - 1) {
+      first = Priority::low;
+    } else if (tick % kNormalTurn == kNormalTurn - 1) {
+      first = Priority::normal;
+    }
+    if (run_lane(first, index, rng)) return true;
+    for (Priority priority : { Priority::high, Priority::normal, Priority::low }) {
+      if (priority != first && run_lane(priority, index, rng)) return true;
+    }
+    return false;
+  }
+
+  // The normal lane also covers the work-stealing deques: own deque first,
+  // then the injection queue, then a random victim.
+  bool run_lane(Priority priority, size_t index, uint64_t& rng) {
+    if (priority != Priority::normal || m_deques.empty()) return run_from(priority, index);
+    if (auto task = m_deques[index]->pop()) {
+      run(*task, index);
+      return true;
+    }
+    if (run_from(Priority::normal, index)) return true;
+    size_t count = m_deques.size();
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    size_t start = rng % count;
+    for (size_t i = 0; i < count; ++i) {
+      size_t victim = (start + i) % count;
+      if (victim == index) continue;
+      if (auto task = m_deques[victim]->steal()) {
+        run(*task, index);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // index is the running worker, or m_slots.size() for any other thread.
+  bool run_from(Priority priority, size_t index) {
+    Lane& lane = m_lanes[static_cast<size_t>(priority)];
+    if (lane.depth() <= 0) return false;
+    auto task = lane.queue.try_pop();
+    if (!task) return false;
+    lane.popped.fetch_add(1, std::memory_order_relaxed);
+    invoke(*task);
+    finished(index);
+    return true;
+  }
+
+  void run(Task* task, size_t index) {
+    Task owned(std::move(*task));
+    m_nodes.delete_object(task);
+    invoke(owned);
+    finished(index);
+  }
+
+  // A task that throws terminates the program on whichever thread runs it,
+  // as documented for submit(): a helping thread would otherwise carry the
+  // exception off and never count the task as finished.
+  static void invoke(Task& task) noexcept { task(); }
+
+  void finished(size_t index) {
+    auto& count = index < m_slots.size() ? m_slots[index]->finished : m_external_finished;
+    count.fetch_add(1, std::memory_order_seq_cst);
+    notify_idle_waiters();
+  }
+
+  // Takes back the queued count of a task whose push failed. wait_idle() may
+  // have gone to sleep on that count, so it has to look again.
+  void uncount(std::atomic<uint64_t>& pushed) {
+    pushed.fetch_sub(1, std::memory_order_seq_cst);
+    notify_idle_waiters();
+  }
+
+  void notify_idle_waiters() {
+    if (m_idle_waiters.load(std::memory_order_seq_cst) > 0) {
+      auto lock = std::lock_guard(m_idle_mutex);
+      m_idle.notify_all();
     }
   }
+
+  // Every task counted as queued has also finished. Finish counts are read
+  // first: each task is counted as queued before it can finish, so equal
+  // sums mean that at the moment the finish counts were read, nothing was
+  // queued or running.
+  bool idle() const {
+    uint64_t finished = m_external_finished.load(std::memory_order_seq_cst);
+    for (const auto& slot : m_slots) finished += slot->finished.load(std::memory_order_seq_cst);
+    uint64_t queued = 0;
+    for (const Lane& lane : m_lanes) queued += lane.pushed.load(std::memory_order_seq_cst);
+    for (const auto& slot : m_slots) queued += slot->deque_pushed.load(std::memory_order_seq_cst);
+    return queued == finished;
+  }
+
+  bool has_work(size_t index) const {
+    if (m_lanes[static_cast<size_t>(Priority::high)].depth() > 0) return true;
+    if (reserved(index)) return false;
+    for (Priority priority : { Priority::normal, Priority::low }) {
+      if (m_lanes[static_cast<size_t>(priority)].depth() > 0) return true;
+    }
+    for (const auto& deque : m_deques) {
+      if (!deque->empty()) return true;
+    }
+    return false;
+  }
+
+  // Spins and yields per m_wait; returns true as soon as work shows up.
+  bool spin_for_work(size_t index) const {
+    if (m_wait.kind == threaded_queue::WaitPolicy::Kind::block) return false;
+    for (int i = 0; i < m_wait.spins; ++i) {
+      if (has_work(index)) return true;
+      threaded_queue::cpu_relax();
+    }
+    for (int i = 0; i < m_wait.yields; ++i) {
+      if (has_work(index)) return true;
+      std::this_thread::yield();
+    }
+    return false;
+  }
+
+  // Sleeps until work may be available or the worker is told to retire; false
+  // once the pool is stopping and nothing is left to run. A pusher increments
+  // a lane's pushed count or stores a
+  // deque bottom (seq_cst) before reading sleepers (seq_cst); we increment
+  // sleepers before checking for work, so one of the two sees the other.
+  //
+  // notified is cleared on the way in as well as on the way out. The flag may
+  // be stale: its pusher's task can be taken by a worker that then parks
+  // before the pusher sets the flag, leaving no sleeper to clear it. Clearing
+  // it after loading the epoch means a flag set before the clear cannot keep
+  // the next push from waking us, and one set after it comes with an epoch
+  // bump that ends our wait.
+  bool park(size_t index, Worker& self, Sleep& sleep) {
+    sleep.sleepers.fetch_add(1, std::memory_order_seq_cst);
+    uint32_t epoch = sleep.epoch.load(std::memory_order_seq_cst);
+    sleep.notified.store(false, std::memory_order_seq_cst);
+    bool work = has_work(index);
+    bool stopping = m_stopping.load(std::memory_order_seq_cst);
+    bool retiring = self.state.load(std::memory_order_seq_cst) == State::retiring;
+    bool slept = !work && !stopping && !retiring;
+    if (slept) {
+      self.idle_since.store(now_ns(), std::memory_order_relaxed);
+      sleep.epoch.wait(epoch, std::memory_order_seq_cst);
+      self.idle_since.store(0, std::memory_order_relaxed);
+    }
+    // Lets the next push wake another worker while this one gets going.
+    sleep.notified.store(false, std::memory_order_seq_cst);
+    sleep.sleepers.fetch_sub(1, std::memory_order_seq_cst);
+    // Pushes made while our wake-up was in flight woke nobody; pass it on
+    // before running anything, so a burst fans out over the sleepers.
+    if (slept && has_work(index)) wake(sleep);
+    return work || !stopping;
+  }
+
+  // Returns whether anyone was asleep to be woken. While one wake-up is still
+  // in flight further pushes leave it at that instead of making a futex call
+  // each. The woken worker clears notified and, if it finds work queued,
+  // wakes the next sleeper in turn, so wake-ups chain through a burst.
+  static bool wake(Sleep& sleep) {
+    if (sleep.sleepers.load(std::memory_order_seq_cst) == 0) return false;
+    if (sleep.notified.exchange(true, std::memory_order_seq_cst)) return true;
+    sleep.epoch.fetch_add(1, std::memory_order_seq_cst);
+    sleep.epoch.notify_one();
+    return true;
+  }
+
+  static void wake_all(Sleep& sleep) {
+    sleep.epoch.fetch_add(1, std::memory_order_seq_cst);
+    sleep.epoch.notify_all();
+  }
 };
 
+namespace threadpool {
+std::pmr::memory_resource* task_resource() noexcept {
+  // Leaked on purpose: workers of static pools may still free into it at exit.
+  static auto* resource = new memory::SlabAllocator({ 64, 128, 256, 512 });
+  return resource;
+}
+} // namespace threadpool
+
 // ThreadPool private forwarding function
-void ThreadPool::enqueue_wrapper(std::function<void()> fn) {
-  m_pimpl->enqueue_task(std::move(fn));
+void ThreadPool::enqueue_wrapper(threadpool::Task task, Priority priority) {
+  m_pimpl->enqueue_task(std::move(task), priority);
 }
 
-ThreadPool::ThreadPool(size_t num_threads) : m_pimpl(std::make_unique<Impl>(num_threads)) {}
+ThreadPool::ThreadPool(size_t num_threads, threaded_queue::WaitPolicy wait, Scheduling scheduling)
+  : ThreadPool(Options{ .threads = num_threads, .wait = wait, .scheduling = scheduling }) {}
+ThreadPool::ThreadPool(const Options& options)
+  : m_pimpl(std::make_unique<Impl>(options)) {}
 ThreadPool::~ThreadPool() = default;
+
+size_t ThreadPool::size() const noexcept {
+  return m_pimpl->size();
+}
+
+void ThreadPool::resize(size_t min_threads, size_t max_threads) {
+  m_pimpl->resize(min_threads, max_threads);
+}
+
+void ThreadPool::wait_idle() {
+  m_pimpl->wait_idle();
+}
+
+bool ThreadPool::run_pending_task() {
+  return m_pimpl->run_pending_task();
+}
+
+void ThreadPool::dump_trace(const std::string& path) const {
+  std::ofstream out(path);
+  if (!out) throw std::runtime_error("Failed to open trace file " + path);
+  m_pimpl->write_trace(out);
+  if (!out.flush()) throw std::runtime_error("Failed to write trace file " + path);
+}
+
+threadpool::TraceStats ThreadPool::trace_stats() const {
+  return m_pimpl->trace_stats();
+}
+
+std::optional<ThreadPool::WorkerInfo> ThreadPool::this_worker() noexcept {
+  if (tl_worker.pool == nullptr) return std::nullopt;
+  return WorkerInfo{ tl_worker.index, tl_worker.cpu, tl_worker.node };
+}
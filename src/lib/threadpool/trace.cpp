@@ -0,0 +1,153 @@
+#include "threadpool/trace.h"
+#include <algorithm>
+#include <bit>
+#include <cstdio>
+#include <ostream>
+#include <string_view>
+#include <utility>
+
+namespace threadpool {
+
+namespace {
+  thread_local const char *tl_label = nullptr;
+
+  using threaded_queue::QueueStatsSnapshot;
+
+  uint64_t non_negative(int64_t ns) noexcept { return ns > 0 ? static_cast<uint64_t>(ns) : 0; }
+
+  // Trace-event times are microseconds; keep the nanoseconds as decimals.
+  void write_us(std::ostream &out, int64_t ns)
+  {
+    uint64_t value = non_negative(ns);
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%llu.%03llu", static_cast<unsigned long long>(value / 1000),
+      static_cast<unsigned long long>(value % 1000));
+    out << buffer;
+  }
+
+  void write_string(std::ostream &out, std::string_view text)
+  {
+    out << '"';
+    for (char c : text) {
+      if (c == '"' || c == '\\') {
+        out << '\\' << c;
+      } else if (static_cast<unsigned char>(c) < 0x20) {
+        char escaped[8];
+        std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned>(c));
+        out << escaped;
+      } else {
+        out << c;
+      }
+    }
+    out << '"';
+  }
+}// namespace
+
+TraceLabel::TraceLabel(const char *label) noexcept : m_previous(std::exchange(tl_label, label)) {}
+
+TraceLabel::~TraceLabel() { tl_label = m_previous; }
+
+const char *TraceLabel::current() noexcept { return tl_label; }
+
+TraceRecorder::TraceRecorder(size_t rings, size_t capacity)
+  : m_epoch(std::chrono::steady_clock::now()), m_capacity(std::bit_ceil(std::max<size_t>(capacity, 1))),
+    m_rings(rings)
+{
+  for (Ring &ring : m_rings) { ring.slots = std::make_unique<Slot[]>(m_capacity); }
+}
+
+void TraceRecorder::record(const TraceEvent &event) noexcept
+{
+  Ring &ring = m_rings[event.worker];
+  uint64_t index = ring.head.fetch_add(1, std::memory_order_relaxed);
+  Slot &slot = ring.slots[index & (m_capacity - 1)];
+  // Claim the slot unless another writer is still on it or has already
+  // lapped this one; then the event only counts in the totals. The release
+  // stores keep the odd sequence ahead of the new fields, so a reader that
+  // sees any of them also sees the slot is being rewritten.
+  uint64_t previous = slot.sequence.load(std::memory_order_relaxed);
+  if (previous % 2 == 0 && previous < 2 * index + 2
+      && slot.sequence.compare_exchange_strong(previous, 2 * index + 1, std::memory_order_relaxed)) {
+    slot.enqueued.store(event.enqueued, std::memory_order_release);
+    slot.start.store(event.start, std::memory_order_release);
+    slot.end.store(event.end, std::memory_order_release);
+    slot.label.store(event.label, std::memory_order_release);
+    slot.sequence.store(2 * index + 2, std::memory_order_release);
+  }
+
+  ring.tasks.fetch_add(1, std::memory_order_relaxed);
+  ring.busy_ns.fetch_add(event.end - event.start, std::memory_order_relaxed);
+  ring.queue_wait_ns[QueueStatsSnapshot::bucket_of(non_negative(event.start - event.enqueued))].fetch_add(
+    1, std::memory_order_relaxed);
+  ring.run_ns[QueueStatsSnapshot::bucket_of(non_negative(event.end - event.start))].fetch_add(
+    1, std::memory_order_relaxed);
+}
+
+std::vector<TraceEvent> TraceRecorder::events() const
+{
+  std::vector<TraceEvent> events;
+  for (size_t worker = 0; worker < m_rings.size(); worker++) {
+    const Ring &ring = m_rings[worker];
+    uint64_t head = ring.head.load(std::memory_order_acquire);
+    for (uint64_t index = head > m_capacity ? head - m_capacity : 0; index < head; index++) {
+      const Slot &slot = ring.slots[index & (m_capacity - 1)];
+      uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+      if (sequence != 2 * index + 2) { continue; }// still being written, or already overwritten
+      TraceEvent event;
+      event.enqueued = slot.enqueued.load(std::memory_order_acquire);
+      event.start = slot.start.load(std::memory_order_acquire);
+      event.end = slot.end.load(std::memory_order_acquire);
+      event.label = slot.label.load(std::memory_order_acquire);
+      event.worker = worker;
+      if (slot.sequence.load(std::memory_order_relaxed) == sequence) { events.push_back(event); }
+    }
+  }
+  std::sort(events.begin(), events.end(), [](const TraceEvent &a, const TraceEvent &b) { return a.start < b.start; });
+  return events;
+}
+
+TraceStats TraceRecorder::stats() const
+{
+  TraceStats result;
+  result.elapsed = std::chrono::nanoseconds(now());
+  for (const Ring &ring : m_rings) {
+    TraceStats::Worker &worker = result.workers.emplace_back();
+    worker.tasks = ring.tasks.load(std::memory_order_relaxed);
+    worker.busy = std::chrono::nanoseconds(ring.busy_ns.load(std::memory_order_relaxed));
+    if (result.elapsed.count() > 0) {
+      worker.utilization = static_cast<double>(worker.busy.count()) / static_cast<double>(result.elapsed.count());
+    }
+    for (size_t bucket = 0; bucket < QueueStatsSnapshot::kLatencyBuckets; bucket++) {
+      result.queue_wait_ns[bucket] += ring.queue_wait_ns[bucket].load(std::memory_order_relaxed);
+      result.run_ns[bucket] += ring.run_ns[bucket].load(std::memory_order_relaxed);
+    }
+  }
+  return result;
+}
+
+void TraceRecorder::write_chrome_json(std::ostream &out, const std::vector<std::string> &thread_names) const
+{
+  out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+  const char *separator = "\n";
+  for (size_t worker = 0; worker < thread_names.size(); worker++) {
+    out << separator << R"({"name":"thread_name","ph":"M","pid":1,"tid":)" << worker << R"(,"args":{"name":)";
+    write_string(out, thread_names[worker]);
+    out << "}}";
+    separator = ",\n";
+  }
+  for (const TraceEvent &event : events()) {
+    out << separator << R"({"name":)";
+    write_string(out, event.label != nullptr ? event.label : "task");
+    out << R"(,"cat":"threadpool","ph":"X","pid":1,"tid":)" << event.worker << R"(,"ts":)";
+    write_us(out, event.start);
+    out << R"(,"dur":)";
+    write_us(out, event.end - event.start);
+    out << R"(,"args":{"queued_us":)";
+    write_us(out, event.start - event.enqueued);
+    out << "}}";
+    separator = ",\n";
+  }
+  out << "\n]}\n";
+}
+
+}// namespace threadpool
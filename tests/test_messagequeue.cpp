@@ -4,6 +4,9 @@
 
 // Fix the include path based on the actual structure
 #include "messagequeue/message_queue.h"
+#include "objectpool/objectpool.h"
+#include "objectpool/pool_resource.h"
+#include "objectpool/pooled_ptr.h"
 
 TEST_CASE("Message struct basic functionality", "[messagequeue][message]") {
     SECTION("Message creation and initialization") {
@@ -240,3 +243,91 @@ TEST_CASE("MessageQueue edge cases", "[messagequeue][queue][edge]") {
         }
     }
 }
+
+
+TEST_CASE("MessageQueue with a memory resource", "[messagequeue][queue][pmr]") {
+    memory::ObjectPoolResource<512> resource(4);
+    MessageQueue queue(&resource);
+
+    for (int i = 0; i < 200; ++i) {
+        auto msg = std::make_unique<Message>();
+        msg->timestamp_ns = static_cast<uint64_t>(i);
+        queue.push(std::move(msg));
+    }
+    REQUIRE(queue.size() == 200);
+    REQUIRE(resource.blocks_in_use() > 0);
+
+    for (int i = 0; i < 200; ++i) {
+        auto result = queue.try_pop();
+        REQUIRE(result.has_value());
+        REQUIRE(result.value()->timestamp_ns == static_cast<uint64_t>(i));
+    }
+    REQUIRE(queue.empty());
+}
+
+
+TEST_CASE("MessageQueue with pooled messages", "[messagequeue][queue][pooled_ptr]") {
+    memory::ObjectPool<Message> pool(8);
+    MessageQueue queue;
+
+    for (int round = 0; round < 3; ++round) {
+        for (int i = 0; i < 8; ++i) {
+            queue.push(memory::make_pooled(pool, Message{static_cast<uint64_t>(i), "pooled", {}}));
+        }
+        REQUIRE(pool.in_use() == 8);
+        queue.push(std::make_unique<Message>(Message{99, "heap", {}}));
+
+        for (int i = 0; i < 8; ++i) {
+            auto result = queue.try_pop();
+            REQUIRE(result.has_value());
+            REQUIRE(result.value()->timestamp_ns == static_cast<uint64_t>(i));
+            REQUIRE(result.value().get_deleter().pool() == &pool);
+        }
+        auto heap = queue.try_pop();
+        REQUIRE(heap.has_value());
+        REQUIRE(heap.value().get_deleter().pool() == nullptr);
+        REQUIRE(pool.in_use() == 0);
+        REQUIRE(pool.capacity() == 8);
+    }
+}
+
+
+TEST_CASE("MessageQueue bulk operations", "[messagequeue][queue][bulk]") {
+    MessageQueue queue;
+    std::vector<memory::pooled_ptr<Message>> batch;
+    for (int i = 0; i < 10; ++i) {
+        batch.push_back(std::make_unique<Message>(Message{static_cast<uint64_t>(i), "bulk", {}}));
+    }
+    queue.push_bulk(batch);
+    REQUIRE(queue.size() == 10);
+    REQUIRE(batch[0] == nullptr);
+
+    std::vector<memory::pooled_ptr<Message>> out;
+    REQUIRE(queue.pop_bulk(out, 4) == 4);
+    REQUIRE(queue.pop_bulk(out, 100) == 6);
+    REQUIRE(queue.pop_bulk(out, 100) == 0);
+    REQUIRE(out.size() == 10);
+    for (size_t i = 0; i < out.size(); ++i) {
+        REQUIRE(out[i]->timestamp_ns == i);
+    }
+    REQUIRE(queue.empty());
+}
+
+TEST_CASE("MessageQueue statistics", "[messagequeue][stats]") {
+    MessageQueue queue;
+    for (uint64_t i = 0; i < 5; ++i) { queue.push(std::make_unique<Message>(Message{ i, "stats", {} })); }
+    std::vector<memory::pooled_ptr<Message>> out;
+    queue.pop_bulk(out, 2);
+    queue.try_pop();
+
+    auto stats = queue.stats();
+    if constexpr (threaded_queue::DefaultQueueStats::enabled) {
+        REQUIRE(stats.enqueued == 5);
+        REQUIRE(stats.dequeued == 3);
+        REQUIRE(stats.high_water == 5);
+    } else {
+        REQUIRE(stats.enqueued == 0);
+        REQUIRE(stats.depth() == 0);
+    }
+    REQUIRE(stats.lock_waits == 0);
+}
@@ -1,5 +1,18 @@
 #include <catch2/catch_test_macros.hpp>
+#include "objectpool/arena_resource.h"
+#include "objectpool/concurrent_objectpool.h"
+#include "objectpool/lockfree_objectpool.h"
 #include "objectpool/objectpool.h"
+#include "objectpool/page_memory.h"
+#include "objectpool/pool_resource.h"
+#include "objectpool/pooled_ptr.h"
+#include "objectpool/slab_allocator.h"
+#include <map>
+#include <memory_resource>
+#include <string>
+#include <atomic>
+#include <thread>
+#include <vector>
 
 
 struct TestObject{
@@ -40,3 +53,550 @@ TEST_CASE("ObjectPool Core Functionality", "[objectpool]"){
     }
 }
 
+
+
+TEST_CASE("ObjectPool Growth", "[objectpool][growth]"){
+    using Kind = memory::GrowthPolicy::Kind;
+
+    SECTION("Linear growth chains chunks of the initial size"){
+        memory::ObjectPool<TestObject> pool(4, {Kind::linear, 0});
+        std::vector<TestObject*> objs;
+        for(int i = 0; i < 10; i++){
+            objs.push_back(pool.construct(i, 0.0));
+        }
+        REQUIRE(pool.capacity() == 12);
+        REQUIRE(pool.chunk_count() == 3);
+        REQUIRE(pool.in_use() == 10);
+        for(int i = 0; i < 10; i++){
+            REQUIRE(objs[static_cast<size_t>(i)]->x == i);
+        }
+        for(auto* obj : objs){ pool.destroy(obj); }
+        REQUIRE(pool.in_use() == 0);
+    }
+
+    SECTION("Geometric growth doubles capacity"){
+        memory::ObjectPool<TestObject> pool(4, {Kind::geometric, 0});
+        std::vector<TestObject*> objs;
+        for(int i = 0; i < 9; i++){
+            objs.push_back(pool.construct());
+        }
+        REQUIRE(pool.capacity() == 16);
+        for(auto* obj : objs){ pool.destroy(obj); }
+    }
+
+    SECTION("Growth stops at the cap"){
+        memory::ObjectPool<TestObject> pool(4, {Kind::geometric, 6});
+        std::vector<TestObject*> objs;
+        for(int i = 0; i < 6; i++){
+            objs.push_back(pool.construct());
+        }
+        REQUIRE(pool.capacity() == 6);
+        REQUIRE_THROWS_AS(pool.construct(), std::bad_alloc);
+        for(auto* obj : objs){ pool.destroy(obj); }
+    }
+
+    SECTION("Trim releases fully free chunks only"){
+        memory::ObjectPool<TestObject> pool(4, {Kind::linear, 0});
+        std::vector<TestObject*> objs;
+        for(int i = 0; i < 12; i++){
+            objs.push_back(pool.construct());
+        }
+        REQUIRE(pool.chunk_count() == 3);
+
+        // Keep one object alive in the last chunk.
+        TestObject* survivor = objs.back();
+        objs.pop_back();
+        for(auto* obj : objs){ pool.destroy(obj); }
+
+        REQUIRE(pool.trim() == 4);
+        REQUIRE(pool.chunk_count() == 2);
+        REQUIRE(pool.capacity() == 8);
+
+        // The remaining free list must only hand out live slots.
+        std::vector<TestObject*> again;
+        for(int i = 0; i < 7; i++){
+            again.push_back(pool.construct(i, 1.0));
+        }
+        REQUIRE(pool.capacity() == 8);
+        for(auto* obj : again){ pool.destroy(obj); }
+
+        pool.destroy(survivor);
+        REQUIRE(pool.trim() == 4);
+        REQUIRE(pool.chunk_count() == 1);
+        REQUIRE(pool.capacity() == 4);
+    }
+
+    SECTION("Move transfers every slot"){
+        memory::ObjectPool<TestObject> pool(2);
+        TestObject* obj = pool.construct(1, 2.0);
+        memory::ObjectPool<TestObject> moved(std::move(pool));
+        REQUIRE(moved.in_use() == 1);
+        REQUIRE(moved.capacity() == 2);
+        moved.destroy(obj);
+        REQUIRE(moved.construct() == obj);
+    }
+}
+
+TEST_CASE("ConcurrentObjectPool Core Functionality", "[objectpool][concurrent]"){
+    memory::ConcurrentObjectPool<TestObject, 4> pool(10);
+
+    SECTION("Construction and Destruction"){
+        TestObject* obj1 = pool.construct(10, 20.5);
+        REQUIRE(obj1 != nullptr);
+        REQUIRE(obj1->x == 10);
+        REQUIRE(obj1->y == 20.5);
+        pool.destroy(obj1);
+    }
+
+    SECTION("Pool Exhaustion"){
+        std::vector<TestObject*> objs;
+        for(size_t i = 0; i < pool.capacity(); i++){
+            objs.push_back(pool.construct());
+        }
+        REQUIRE_THROWS_AS(pool.construct(), std::bad_alloc);
+        for(auto* obj : objs){
+            pool.destroy(obj);
+        }
+    }
+
+    SECTION("Slot reuse"){
+        TestObject* ptr1 = pool.construct();
+        pool.destroy(ptr1);
+
+        TestObject* ptr2 = pool.construct();
+        REQUIRE(ptr1 == ptr2);
+        pool.destroy(ptr2);
+    }
+}
+
+TEST_CASE("ConcurrentObjectPool Multi-threaded", "[objectpool][concurrent][threading]"){
+    constexpr size_t num_threads = 4;
+    constexpr int iterations = 10000;
+    memory::ConcurrentObjectPool<TestObject, 8> pool(num_threads * 64);
+
+    SECTION("Concurrent construct and destroy"){
+        std::atomic<int> mismatches{0};
+        std::vector<std::thread> threads;
+        for(size_t t = 0; t < num_threads; t++){
+            threads.emplace_back([&pool, &mismatches, t]{
+                std::vector<TestObject*> live;
+                for(int i = 0; i < iterations; i++){
+                    live.push_back(pool.construct(static_cast<int>(t), static_cast<double>(i)));
+                    if(live.size() == 16){
+                        for(auto* obj : live){
+                            if(obj->x != static_cast<int>(t)){ mismatches.fetch_add(1); }
+                            pool.destroy(obj);
+                        }
+                        live.clear();
+                    }
+                }
+                for(auto* obj : live){ pool.destroy(obj); }
+            });
+        }
+        for(auto& thread : threads){ thread.join(); }
+        REQUIRE(mismatches.load() == 0);
+
+        // Exited threads flush their caches, so the whole capacity is reachable again.
+        std::vector<TestObject*> objs;
+        for(size_t i = 0; i < pool.capacity(); i++){
+            objs.push_back(pool.construct());
+        }
+        REQUIRE_THROWS_AS(pool.construct(), std::bad_alloc);
+        for(auto* obj : objs){ pool.destroy(obj); }
+    }
+
+    SECTION("Cross-thread destroy"){
+        std::vector<TestObject*> objs;
+        for(int i = 0; i < 100; i++){
+            objs.push_back(pool.construct(i, 0.0));
+        }
+        std::thread destroyer([&pool, &objs]{
+            for(auto* obj : objs){ pool.destroy(obj); }
+        });
+        destroyer.join();
+
+        std::vector<TestObject*> again;
+        for(size_t i = 0; i < pool.capacity(); i++){
+            again.push_back(pool.construct());
+        }
+        REQUIRE(again.size() == pool.capacity());
+        for(auto* obj : again){ pool.destroy(obj); }
+    }
+}
+
+
+TEST_CASE("LockFreeObjectPool Core Functionality", "[objectpool][lockfree]"){
+    memory::LockFreeObjectPool<TestObject> pool(2);
+
+    SECTION("Construction and Destruction"){
+        TestObject* obj1 = pool.construct(10, 20.5);
+        REQUIRE(obj1 != nullptr);
+        REQUIRE(obj1->x == 10);
+        REQUIRE(obj1->y == 20.5);
+        pool.destroy(obj1);
+    }
+
+    SECTION("Pool Exhaustion"){
+        TestObject* obj1 = pool.construct();
+        TestObject* obj2 = pool.construct();
+
+        REQUIRE_THROWS_AS(pool.construct(), std::bad_alloc);
+        pool.destroy(obj1);
+        pool.destroy(obj2);
+    }
+
+    SECTION("Slot reuse"){
+        TestObject* ptr1 = pool.construct();
+        pool.destroy(ptr1);
+
+        TestObject* ptr2 = pool.construct();
+        REQUIRE(ptr1 == ptr2);
+        pool.destroy(ptr2);
+    }
+}
+
+TEST_CASE("LockFreeObjectPool Cross-thread stress", "[objectpool][lockfree][threading][stress]"){
+    // Every thread constructs objects tagged with its id and trades them through
+    // a shared mailbox, so most objects are destroyed by a thread that did not
+    // construct them. A slot handed out twice shows up as a corrupted tag.
+    constexpr size_t num_threads = 4;
+    constexpr size_t mailbox_size = 16;
+    constexpr int iterations = 20000;
+    memory::LockFreeObjectPool<TestObject> pool(num_threads + mailbox_size);
+
+    std::vector<std::atomic<TestObject*>> mailbox(mailbox_size);
+    for(auto& slot : mailbox){ slot.store(nullptr); }
+    std::atomic<int> corrupted{0};
+    std::atomic<int> exhausted{0};
+
+    std::vector<std::thread> threads;
+    for(size_t t = 0; t < num_threads; t++){
+        threads.emplace_back([&, t]{
+            for(int i = 0; i < iterations; i++){
+                TestObject* obj = nullptr;
+                try {
+                    obj = pool.construct(static_cast<int>(t), static_cast<double>(i));
+                } catch(const std::bad_alloc&) {
+                    exhausted.fetch_add(1);
+                    continue;
+                }
+                if(obj->x != static_cast<int>(t) || obj->y != static_cast<double>(i)){ corrupted.fetch_add(1); }
+                obj->y = -1.0;
+                auto& slot = mailbox[(t + static_cast<size_t>(i)) % mailbox_size];
+                TestObject* other = slot.exchange(obj);
+                if(other != nullptr){
+                    if(other->y != -1.0){ corrupted.fetch_add(1); }
+                    pool.destroy(other);
+                }
+            }
+        });
+    }
+    for(auto& thread : threads){ thread.join(); }
+    for(auto& slot : mailbox){ pool.destroy(slot.exchange(nullptr)); }
+
+    REQUIRE(corrupted.load() == 0);
+    // One live object per thread plus a full mailbox always fits.
+    REQUIRE(exhausted.load() == 0);
+
+    std::vector<TestObject*> objs;
+    for(size_t i = 0; i < pool.capacity(); i++){
+        objs.push_back(pool.construct());
+    }
+    REQUIRE_THROWS_AS(pool.construct(), std::bad_alloc);
+    for(auto* obj : objs){ pool.destroy(obj); }
+}
+
+
+TEST_CASE("ObjectPoolResource", "[objectpool][pmr]"){
+    memory::ObjectPoolResource<64> resource(4);
+
+    SECTION("Small requests come from the pool"){
+        void* block1 = resource.allocate(48, 8);
+        void* block2 = resource.allocate(64, 16);
+        REQUIRE(resource.blocks_in_use() == 2);
+        resource.deallocate(block1, 48, 8);
+        REQUIRE(resource.allocate(32, 8) == block1);
+        resource.deallocate(block1, 32, 8);
+        resource.deallocate(block2, 64, 16);
+        REQUIRE(resource.blocks_in_use() == 0);
+    }
+
+    SECTION("Large requests go upstream"){
+        void* big = resource.allocate(1024, 8);
+        REQUIRE(resource.blocks_in_use() == 0);
+        resource.deallocate(big, 1024, 8);
+    }
+
+    SECTION("Backs a pmr container"){
+        std::pmr::map<int, int> map(&resource);
+        for(int i = 0; i < 100; i++){
+            map.emplace(i, i * i);
+        }
+        REQUIRE(resource.blocks_in_use() == 100);
+        REQUIRE(map.at(9) == 81);
+        map.clear();
+        REQUIRE(resource.blocks_in_use() == 0);
+        REQUIRE(resource.trim() > 0);
+    }
+}
+
+TEST_CASE("ArenaResource", "[objectpool][pmr]"){
+    memory::ArenaResource arena(256);
+
+    SECTION("Allocations are aligned and distinct"){
+        auto* a = static_cast<char*>(arena.allocate(3, 1));
+        auto* b = arena.allocate(8, 8);
+        auto* c = arena.allocate(16, 64);
+        REQUIRE(reinterpret_cast<uintptr_t>(b) % 8 == 0);
+        REQUIRE(reinterpret_cast<uintptr_t>(c) % 64 == 0);
+        REQUIRE(static_cast<void*>(a + 3) <= b);
+        REQUIRE(arena.bytes_allocated() == 27);
+    }
+
+    SECTION("Grows past the first chunk"){
+        for(int i = 0; i < 100; i++){
+            REQUIRE(arena.allocate(32, 8) != nullptr);
+        }
+        REQUIRE(arena.chunk_count() > 1);
+        REQUIRE(arena.bytes_reserved() >= 3200);
+    }
+
+    SECTION("Reset reuses chunks"){
+        std::vector<void*> first;
+        for(int i = 0; i < 100; i++){
+            first.push_back(arena.allocate(32, 8));
+        }
+        size_t chunks = arena.chunk_count();
+        arena.reset();
+        for(int i = 0; i < 100; i++){
+            REQUIRE(arena.allocate(32, 8) != nullptr);
+        }
+        REQUIRE(arena.chunk_count() == chunks);
+        arena.reset();
+        REQUIRE(arena.allocate(32, 8) == first.front());
+    }
+
+    SECTION("Backs a pmr container"){
+        std::pmr::map<std::pmr::string, int, std::less<>> counts(&arena);
+        counts.emplace("a fairly long word that does not fit inline", 1);
+        REQUIRE(counts.find(std::string_view("a fairly long word that does not fit inline")) != counts.end());
+        REQUIRE(arena.bytes_allocated() > 0);
+    }
+}
+
+
+TEST_CASE("SlabAllocator size classes", "[objectpool][slab]"){
+    memory::SlabAllocator slab({24, 64, 200}, 1024);
+
+    SECTION("Classes are rounded to 16 bytes"){
+        REQUIRE(slab.good_size(1) == 32);
+        REQUIRE(slab.good_size(33) == 64);
+        REQUIRE(slab.good_size(65) == 208);
+        REQUIRE(slab.max_class_size() == 208);
+        REQUIRE(slab.good_size(4096) == 4096);
+    }
+
+    SECTION("Blocks are reused within a class"){
+        void* a = slab.allocate(40);
+        slab.deallocate(a, 40);
+        void* b = slab.allocate(60);
+        REQUIRE(a == b);
+        slab.deallocate(b, 60);
+    }
+
+    SECTION("Counters track utilization and fragmentation"){
+        void* a = slab.allocate(48);
+        void* b = slab.allocate(16);
+        void* big = slab.allocate(1000);
+        auto stats = slab.stats();
+        REQUIRE(stats.classes.size() == 3);
+        REQUIRE(stats.classes[1].block_size == 64);
+        REQUIRE(stats.classes[1].blocks_in_use == 1);
+        REQUIRE(stats.classes[1].bytes_requested == 48);
+        REQUIRE(stats.classes[1].utilization() == 0.75);
+        REQUIRE(stats.classes[0].blocks_in_use == 1);
+        REQUIRE(stats.internal_fragmentation() == (64 - 48) + (32 - 16));
+        REQUIRE(stats.oversize_in_use == 1);
+        REQUIRE(stats.oversize_bytes == 1000);
+
+        slab.deallocate(a, 48);
+        slab.deallocate(b, 16);
+        slab.deallocate(big, 1000);
+        stats = slab.stats();
+        REQUIRE(stats.classes[1].blocks_in_use == 0);
+        REQUIRE(stats.oversize_in_use == 0);
+        REQUIRE(stats.free_slab_bytes() == stats.classes[0].blocks_total * 32 + stats.classes[1].blocks_total * 64);
+    }
+}
+
+TEST_CASE("ByteBuffer", "[objectpool][slab]"){
+    memory::SlabAllocator slab;
+
+    SECTION("Copies bytes in"){
+        std::vector<uint8_t> payload = {1, 2, 3, 4, 5};
+        memory::ByteBuffer buffer(slab, payload);
+        REQUIRE(buffer.size() == 5);
+        REQUIRE(buffer.capacity() == 16);
+        REQUIRE(std::vector<uint8_t>(buffer.begin(), buffer.end()) == payload);
+    }
+
+    SECTION("Grows into a larger class and keeps its bytes"){
+        memory::ByteBuffer buffer(slab, 10);
+        for(size_t i = 0; i < buffer.size(); i++){ buffer[i] = static_cast<uint8_t>(i); }
+        buffer.resize(100);
+        REQUIRE(buffer.capacity() == 128);
+        for(size_t i = 0; i < 10; i++){ REQUIRE(buffer[i] == i); }
+        REQUIRE(slab.stats().classes[0].blocks_in_use == 0);
+        REQUIRE(slab.stats().classes[3].blocks_in_use == 1);
+    }
+
+    SECTION("Move transfers the block"){
+        memory::ByteBuffer buffer(slab, 20);
+        uint8_t* data = buffer.data();
+        memory::ByteBuffer moved(std::move(buffer));
+        REQUIRE(moved.data() == data);
+        REQUIRE(buffer.empty());
+        moved = memory::ByteBuffer();
+        REQUIRE(slab.stats().classes[1].blocks_in_use == 0);
+    }
+}
+
+
+TEST_CASE("SlabAllocator cross-thread frees", "[objectpool][slab][threading]"){
+    memory::SlabAllocator slab({64, 256});
+    constexpr int count = 5000;
+    std::vector<memory::ByteBuffer> buffers;
+    buffers.reserve(count);
+
+    std::thread producer([&]{
+        for(int i = 0; i < count; i++){
+            memory::ByteBuffer buffer(slab, (i % 2 == 0) ? 40 : 200);
+            buffer[0] = static_cast<uint8_t>(i);
+            buffers.push_back(std::move(buffer));
+        }
+    });
+    producer.join();
+
+    auto stats = slab.stats();
+    REQUIRE(stats.classes[0].blocks_in_use == count / 2);
+    REQUIRE(stats.classes[1].blocks_in_use == count / 2);
+    REQUIRE(stats.classes[0].bytes_requested == 40 * (count / 2));
+
+    std::thread consumer([&]{
+        for(int i = 0; i < count; i++){
+            REQUIRE(buffers[static_cast<size_t>(i)][0] == static_cast<uint8_t>(i));
+        }
+        buffers.clear();
+    });
+    consumer.join();
+
+    stats = slab.stats();
+    REQUIRE(stats.classes[0].blocks_in_use == 0);
+    REQUIRE(stats.classes[1].blocks_in_use == 0);
+    REQUIRE(stats.internal_fragmentation() == 0);
+}
+
+
+TEST_CASE("SlabAllocator destroyed before a thread that used it exits", "[objectpool][slab][threading]"){
+    auto slab = std::make_unique<memory::SlabAllocator>(std::vector<size_t>{64});
+    std::atomic<int> step{0};
+
+    // The thread's cache for the allocator is retired at thread exit, after
+    // the allocator is gone; that must only touch the shared registry.
+    std::thread user([&]{
+        { memory::ByteBuffer buffer(*slab, 40); }
+        step = 1;
+        while(step.load() != 2){ std::this_thread::yield(); }
+    });
+    while(step.load() != 1){ std::this_thread::yield(); }
+    slab.reset();
+    step = 2;
+    user.join();
+    REQUIRE(step.load() == 2);
+}
+
+TEST_CASE("pooled_ptr", "[objectpool][pooled_ptr]"){
+    SECTION("Returns the object to its pool"){
+        memory::ObjectPool<TestObject> pool(2);
+        {
+            auto obj = memory::make_pooled(pool, 3, 4.5);
+            REQUIRE(obj->x == 3);
+            REQUIRE(obj.get_deleter().pool() == &pool);
+            REQUIRE(pool.in_use() == 1);
+        }
+        REQUIRE(pool.in_use() == 0);
+    }
+
+    SECTION("Works with every pool type"){
+        memory::ConcurrentObjectPool<TestObject> concurrent(4);
+        memory::LockFreeObjectPool<TestObject> lockfree(4);
+        memory::pooled_ptr<TestObject> a = memory::make_pooled(concurrent, 1, 1.0);
+        memory::pooled_ptr<TestObject> b = memory::make_pooled(lockfree, 2, 2.0);
+        std::swap(a, b);
+        REQUIRE(a->x == 2);
+        REQUIRE(a.get_deleter().pool() == &lockfree);
+        REQUIRE(b.get_deleter().pool() == &concurrent);
+    }
+
+    SECTION("Adopts a unique_ptr"){
+        memory::pooled_ptr<TestObject> obj = std::make_unique<TestObject>(7, 0.5);
+        REQUIRE(obj->x == 7);
+        REQUIRE(obj.get_deleter().pool() == nullptr);
+    }
+
+    SECTION("Released on another thread"){
+        memory::LockFreeObjectPool<TestObject> pool(1);
+        auto obj = memory::make_pooled(pool, 1, 1.0);
+        std::thread([o = std::move(obj)]{}).join();
+        REQUIRE_NOTHROW(memory::make_pooled(pool, 2, 2.0));
+    }
+}
+
+
+TEST_CASE("ObjectPool page backing", "[objectpool][pages]"){
+    using HugePages = memory::PageOptions::HugePages;
+    using Backing = memory::PageRegion::Backing;
+
+    SECTION("Default options use the heap"){
+        memory::ObjectPool<TestObject> pool(16);
+        REQUIRE(pool.backing() == Backing::heap);
+    }
+
+    SECTION("Every backing constructs, grows and trims"){
+        for(auto huge_pages : {HugePages::none, HugePages::transparent, HugePages::explicit_}){
+            memory::ObjectPool<TestObject> pool(1000, {memory::GrowthPolicy::Kind::linear, 0}, {huge_pages, -1, true});
+            REQUIRE(pool.backing() != Backing::heap);
+            if(huge_pages == HugePages::transparent){
+                REQUIRE(pool.backing() == Backing::transparent_huge_pages);
+            }
+            if(huge_pages == HugePages::explicit_){
+                // Falls back to transparent huge pages when none are reserved.
+                REQUIRE((pool.backing() == Backing::huge_pages || pool.backing() == Backing::transparent_huge_pages));
+            }
+
+            std::vector<TestObject*> objects;
+            for(int i = 0; i < 2500; i++){
+                objects.push_back(pool.construct(i, 0.5));
+            }
+            REQUIRE(pool.chunk_count() == 3);
+            for(int i = 0; i < 2500; i++){
+                REQUIRE(objects[static_cast<size_t>(i)]->x == i);
+            }
+            for(auto* obj : objects){
+                pool.destroy(obj);
+            }
+            REQUIRE(pool.trim() == 2000);
+        }
+    }
+
+    SECTION("Region alignment and NUMA binding"){
+        memory::PageRegion region(1000, 64, {HugePages::transparent, 0, false});
+        REQUIRE(reinterpret_cast<uintptr_t>(region.data()) % memory::PageRegion::kHugePageSize == 0);
+        // Binding is best effort; it either took or the region is left unbound.
+        REQUIRE((region.numa_node() == 0 || region.numa_node() == -1));
+
+        memory::PageRegion moved = std::move(region);
+        REQUIRE(region.data() == nullptr);
+        REQUIRE(moved.data() != nullptr);
+    }
+}
@@ -0,0 +1,955 @@
+#include "threadpool/coroutine.h"
+#include "threadpool/cpu_topology.h"
+#include "threadpool/parallel.h"
+#include "threadpool/task_graph.h"
+#include "threadpool/task_group.h"
+#include "threadpool/threadpool.h"
+#include "threadpool/trace.h"
+#include "threadsafequeue/work_stealing_deque.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <iterator>
+#include <memory>
+#include <numeric>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#endif
+
+using threaded_queue::WaitPolicy;
+using threaded_queue::WorkStealingDeque;
+
+TEST_CASE("WorkStealingDeque owner and thief ends", "[threadpool][deque]")
+{
+  WorkStealingDeque<int> deque(2);
+  for (int i = 0; i < 10; ++i) { deque.push(i); }// grows twice
+  REQUIRE(deque.size() == 10);
+  REQUIRE(deque.pop() == 9);// LIFO for the owner
+  REQUIRE(deque.steal() == 0);// FIFO for thieves
+  REQUIRE(deque.steal() == 1);
+  REQUIRE(deque.pop() == 8);
+  for (int i = 2; i < 8; ++i) { REQUIRE(deque.steal() == i); }
+  REQUIRE_FALSE(deque.pop().has_value());
+  REQUIRE_FALSE(deque.steal().has_value());
+  REQUIRE(deque.empty());
+}
+
+TEST_CASE("WorkStealingDeque hands out every item once", "[threadpool][deque][threading]")
+{
+  constexpr int count = 100000;
+  constexpr int thieves = 3;
+  WorkStealingDeque<int> deque(16);
+  std::vector<std::atomic<int>> taken(count);
+  std::atomic<bool> done{ false };
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < thieves; ++t) {
+    threads.emplace_back([&] {
+      while (!done.load()) {
+        if (auto item = deque.steal()) { taken[static_cast<size_t>(*item)].fetch_add(1); }
+      }
+    });
+  }
+  for (int i = 0; i < count; ++i) {
+    deque.push(i);
+    if (i % 3 == 0) {
+      if (auto item = deque.pop()) { taken[static_cast<size_t>(*item)].fetch_add(1); }
+    }
+  }
+  while (auto item = deque.pop()) { taken[static_cast<size_t>(*item)].fetch_add(1); }
+  done = true;
+  for (auto &thread : threads) { thread.join(); }
+
+  bool once = std::all_of(taken.begin(), taken.end(), [](auto &n) { return n.load() == 1; });
+  REQUIRE(once);
+}
+
+TEST_CASE("Task stores small closures inline", "[threadpool][task]")
+{
+  using threadpool::Task;
+
+  SECTION("Small and move-only closures")
+  {
+    int calls = 0;
+    auto owned = std::make_unique<int>(7);
+    Task task = [&calls, owned = std::move(owned)] { calls += *owned; };
+    STATIC_REQUIRE(Task::stores_inline<decltype([&calls] { ++calls; })>);
+    Task moved = std::move(task);
+    REQUIRE_FALSE(task);
+    REQUIRE(moved);
+    moved();
+    REQUIRE(calls == 7);
+  }
+
+  SECTION("Large closures fall back to pooled storage")
+  {
+    std::array<int64_t, 16> big{};
+    big[15] = 5;
+    int64_t seen = 0;
+    auto fn = [big, &seen] { seen = big[15]; };
+    STATIC_REQUIRE_FALSE(Task::stores_inline<decltype(fn)>);
+    Task task = fn;
+    Task moved;
+    moved = std::move(task);
+    moved();
+    REQUIRE(seen == 5);
+  }
+
+  SECTION("Destroys the callable exactly once")
+  {
+    auto counter = std::make_shared<int>(0);
+    {
+      Task task = [counter] {};
+      Task moved = std::move(task);
+      REQUIRE(counter.use_count() == 2);
+    }
+    REQUIRE(counter.use_count() == 1);
+  }
+}
+
+TEST_CASE("Promise and Future", "[threadpool][future]")
+{
+  SECTION("Value set on another thread")
+  {
+    threadpool::Promise<std::string> promise;
+    auto future = promise.get_future();
+    std::thread setter([&promise] { promise.set_value("done"); });
+    REQUIRE(future.get() == "done");
+    REQUIRE_FALSE(future.valid());
+    setter.join();
+  }
+
+  SECTION("Exceptions and broken promises")
+  {
+    threadpool::Future<void> failed;
+    {
+      threadpool::Promise<void> promise;
+      failed = promise.get_future();
+      promise.set_exception(std::make_exception_ptr(std::runtime_error("failed")));
+    }
+    REQUIRE(failed.ready());
+    REQUIRE_THROWS_AS(failed.get(), std::runtime_error);
+
+    threadpool::Future<int> broken;
+    {
+      threadpool::Promise<int> promise;
+      broken = promise.get_future();
+    }
+    REQUIRE_THROWS_AS(broken.get(), std::future_error);
+  }
+}
+
+TEST_CASE("ThreadPool runs tasks", "[threadpool]")
+{
+  auto scheduling = GENERATE(ThreadPool::Scheduling::shared_queue, ThreadPool::Scheduling::work_stealing);
+  auto wait = GENERATE(WaitPolicy::block(), WaitPolicy::spin_then_park(64, 4));
+  ThreadPool pool(3, wait, scheduling);
+
+  SECTION("Results come back through futures")
+  {
+    std::vector<std::future<int>> results;
+    for (int i = 0; i < 100; ++i) { results.push_back(pool.enqueue([](int x) { return x * x; }, i)); }
+    for (int i = 0; i < 100; ++i) { REQUIRE(results[static_cast<size_t>(i)].get() == i * i); }
+  }
+
+  SECTION("Tasks spawning tasks")
+  {
+    // Each task below the leaf depth enqueues two children from inside the
+    // pool; with work stealing they land on the worker's own deque.
+    std::atomic<int> leaves{ 0 };
+    std::atomic<int> pending{ 1 };
+    std::function<void(int)> spawn = [&](int depth) {
+      if (depth == 0) {
+        leaves.fetch_add(1);
+      } else {
+        pending.fetch_add(2);
+        pool.enqueue(spawn, depth - 1);
+        pool.enqueue(spawn, depth - 1);
+      }
+      pending.fetch_sub(1);
+    };
+    pool.enqueue(spawn, 12);
+    while (pending.load() != 0) { std::this_thread::yield(); }
+    REQUIRE(leaves.load() == 1 << 12);
+  }
+
+  SECTION("Exceptions reach the future")
+  {
+    auto result = pool.enqueue([] { throw std::runtime_error("task failed"); });
+    REQUIRE_THROWS_AS(result.get(), std::runtime_error);
+    auto pooled = pool.async([] { throw std::runtime_error("task failed"); });
+    REQUIRE_THROWS_AS(pooled.get(), std::runtime_error);
+  }
+
+  SECTION("async and submit")
+  {
+    std::vector<threadpool::Future<int>> results;
+    for (int i = 0; i < 100; ++i) { results.push_back(pool.async([](int x) { return x + 1; }, i)); }
+    for (int i = 0; i < 100; ++i) { REQUIRE(results[static_cast<size_t>(i)].get() == i + 1); }
+
+    std::atomic<int> pending{ 100 };
+    for (int i = 0; i < 100; ++i) {
+      pool.submit([&pending, owned = std::make_unique<int>(i)] { pending.fetch_sub(1); });
+    }
+    while (pending.load() != 0) { std::this_thread::yield(); }
+  }
+
+  SECTION("Bound arguments are passed as lvalues, as by std::bind")
+  {
+    // The task gets a reference to its own copy of y, not to y itself.
+    int y = 41;
+    auto increment = [](int &x) { return ++x; };
+    REQUIRE(pool.enqueue(increment, y).get() == 42);
+    REQUIRE(pool.async(increment, y).get() == 42);
+    std::atomic<int> seen{ 0 };
+    pool.submit([&seen](int &x) { seen = x; }, y);
+    while (seen.load() == 0) { std::this_thread::yield(); }
+    REQUIRE(seen.load() == 41);
+    REQUIRE(y == 41);
+  }
+}
+
+TEST_CASE("ThreadPool destructor runs queued tasks", "[threadpool]")
+{
+  auto scheduling = GENERATE(ThreadPool::Scheduling::shared_queue, ThreadPool::Scheduling::work_stealing);
+  std::atomic<int> ran{ 0 };
+  {
+    ThreadPool pool(2, {}, scheduling);
+    for (int i = 0; i < 1000; ++i) {
+      pool.enqueue([&] {
+        ran.fetch_add(1);
+        std::this_thread::yield();
+      });
+    }
+  }
+  REQUIRE(ran.load() == 1000);
+}
+
+TEST_CASE("ThreadPool wakes a worker per task of a burst", "[threadpool]")
+{
+  using namespace std::chrono_literals;
+  auto scheduling = GENERATE(ThreadPool::Scheduling::shared_queue, ThreadPool::Scheduling::work_stealing);
+  constexpr int kWorkers = 4;
+  ThreadPool pool(kWorkers, WaitPolicy::block(), scheduling);
+  std::this_thread::sleep_for(20ms);// let every worker park
+
+  // Each task holds its worker until all of them run at once, or gives up.
+  std::atomic<int> running{ 0 };
+  std::atomic<int> peak{ 0 };
+  std::vector<threadpool::Future<void>> done;
+  for (int i = 0; i < kWorkers; ++i) {
+    done.push_back(pool.async([&] {
+      int now = ++running;
+      int seen = peak.load();
+      while (seen < now && !peak.compare_exchange_weak(seen, now)) {}
+      auto deadline = std::chrono::steady_clock::now() + 2s;
+      while (peak.load() < kWorkers && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(1ms);
+      }
+      --running;
+    }));
+  }
+  for (auto &future : done) { future.get(); }
+  REQUIRE(peak.load() == kWorkers);
+}
+
+TEST_CASE("ThreadPool priorities", "[threadpool][priority]")
+{
+  using Priority = ThreadPool::Priority;
+  auto scheduling = GENERATE(ThreadPool::Scheduling::shared_queue, ThreadPool::Scheduling::work_stealing);
+  std::atomic<bool> open{ false };
+  auto gate = [&open] { open.wait(false); };
+  auto release = [&open] {
+    open.store(true);
+    open.notify_all();
+  };
+
+  SECTION("High priority tasks overtake queued ones, each lane stays FIFO")
+  {
+    ThreadPool pool(1, {}, scheduling);
+    pool.submit(gate);
+    std::vector<int> order;// only the worker writes, read after the futures
+    std::vector<std::future<void>> done;
+    for (int i = 0; i < 5; ++i) { done.push_back(pool.enqueue(Priority::low, [&order, i] { order.push_back(20 + i); })); }
+    for (int i = 0; i < 5; ++i) { done.push_back(pool.enqueue([&order, i] { order.push_back(10 + i); })); }
+    for (int i = 0; i < 5; ++i) { done.push_back(pool.enqueue(Priority::high, [&order, i] { order.push_back(i); })); }
+    release();
+    for (auto &result : done) { result.get(); }
+
+    REQUIRE(order.size() == 15);
+    REQUIRE(order.front() == 0);
+    for (int lane : { 0, 10, 20 }) {
+      std::vector<int> seen;
+      std::copy_if(order.begin(), order.end(), std::back_inserter(seen), [lane](int v) { return v / 10 * 10 == lane; });
+      REQUIRE(seen == std::vector<int>{ lane, lane + 1, lane + 2, lane + 3, lane + 4 });
+    }
+  }
+
+  SECTION("A stream of high priority tasks does not starve the low lane")
+  {
+    ThreadPool pool(1, {}, scheduling);
+    std::atomic<bool> stop{ false };
+    std::function<void()> busy = [&] {
+      if (!stop.load()) { pool.submit(Priority::high, busy); }
+    };
+    pool.submit(gate);
+    pool.submit(Priority::high, busy);
+    pool.submit(Priority::high, busy);
+    auto low = pool.async(Priority::low, [&stop] { stop.store(true); });
+    release();
+    low.get();
+    REQUIRE(stop.load());
+  }
+
+  SECTION("Reserved workers only run high priority tasks")
+  {
+    ThreadPool pool(ThreadPool::Options{ .threads = 2, .scheduling = scheduling, .reserved_high = 1 });
+    pool.submit(gate);// occupies the one general worker
+    std::atomic<bool> normal_ran{ false };
+    pool.submit([&normal_ran] { normal_ran.store(true); });
+    REQUIRE(pool.async(Priority::high, [] { return 42; }).get() == 42);
+    REQUIRE_FALSE(normal_ran.load());
+    release();
+    pool.async(Priority::low, [] {}).get();
+    REQUIRE(normal_ran.load());
+  }
+
+  SECTION("At least one worker must stay unreserved")
+  {
+    REQUIRE_THROWS_AS(ThreadPool(ThreadPool::Options{ .threads = 2, .reserved_high = 2 }), std::invalid_argument);
+    release();
+  }
+}
+
+TEST_CASE("CpuTopology layouts", "[threadpool][affinity]")
+{
+  // Two packages on two nodes, two cores each, two hardware threads per core,
+  // numbered the way Linux does: first threads of every core, then siblings.
+  std::vector<threadpool::CpuInfo> cpus;
+  for (int cpu = 0; cpu < 8; ++cpu) {
+    int package = (cpu / 2) % 2;
+    cpus.push_back({ .cpu = cpu, .core = cpu % 2, .package = package, .node = package });
+  }
+  threadpool::CpuTopology topology(cpus);
+
+  REQUIRE(topology.order(threadpool::CpuLayout::none).empty());
+  REQUIRE(topology.order(threadpool::CpuLayout::compact) == std::vector<int>{ 0, 4, 1, 5, 2, 6, 3, 7 });
+  REQUIRE(topology.order(threadpool::CpuLayout::physical_cores) == std::vector<int>{ 0, 1, 2, 3 });
+  REQUIRE(topology.order(threadpool::CpuLayout::scatter) == std::vector<int>{ 0, 2, 1, 3, 4, 6, 5, 7 });
+  REQUIRE(topology.on_node(1).order(threadpool::CpuLayout::compact) == std::vector<int>{ 2, 6, 3, 7 });
+  REQUIRE(topology.find(5)->core == 1);
+  REQUIRE(topology.find(8) == nullptr);
+}
+
+TEST_CASE("ThreadPool places and names workers", "[threadpool][affinity]")
+{
+  REQUIRE_FALSE(ThreadPool::this_worker().has_value());
+  auto topology = threadpool::CpuTopology::detect();
+
+  SECTION("Workers know their index and CPU")
+  {
+    ThreadPool pool(ThreadPool::Options{ .threads = 3, .layout = threadpool::CpuLayout::compact, .name = "placed" });
+    std::vector<threadpool::Future<ThreadPool::WorkerInfo>> infos;
+    for (int i = 0; i < 30; ++i) {
+      infos.push_back(pool.async([] { return ThreadPool::this_worker().value(); }));
+    }
+    for (auto &info : infos) {
+      auto worker = info.get();
+      REQUIRE(worker.index < 3);
+      if (!topology.empty()) {
+        REQUIRE(topology.find(worker.cpu) != nullptr);
+        REQUIRE(worker.numa_node == topology.find(worker.cpu)->node);
+      }
+    }
+#if defined(__linux__)
+    auto name = pool.async([] {
+      std::array<char, 16> buffer{};
+      pthread_getname_np(pthread_self(), buffer.data(), buffer.size());
+      return std::string(buffer.data());
+    });
+    REQUIRE(name.get().starts_with("placed-"));
+#endif
+  }
+
+#if defined(__linux__)
+  SECTION("Long names are shortened before the index")
+  {
+    ThreadPool pool(ThreadPool::Options{ .threads = 2, .name = "a-very-long-pool-name" });
+    // Each task holds its worker until both have started, so both run.
+    std::atomic<int> started{ 0 };
+    auto worker_name = [&started] {
+      started++;
+      while (started.load() < 2) { std::this_thread::yield(); }
+      std::array<char, 16> buffer{};
+      pthread_getname_np(pthread_self(), buffer.data(), buffer.size());
+      return std::string(buffer.data());
+    };
+    auto first = pool.async(worker_name);
+    auto second = pool.async(worker_name);
+    std::set<std::string> names{ first.get(), second.get() };
+    REQUIRE(names == std::set<std::string>{ "a-very-long-p-0", "a-very-long-p-1" });
+  }
+#endif
+
+  SECTION("Unavailable CPUs and nodes are rejected")
+  {
+    REQUIRE_THROWS_AS(ThreadPool(ThreadPool::Options{ .threads = 1, .cpus = { -1 } }), std::invalid_argument);
+    REQUIRE_THROWS_AS(ThreadPool(ThreadPool::Options{ .threads = 1, .numa_node = 4096 }), std::invalid_argument);
+  }
+}
+
+TEST_CASE("Elastic ThreadPool", "[threadpool][elastic]")
+{
+  using namespace std::chrono_literals;
+  auto scheduling = GENERATE(ThreadPool::Scheduling::shared_queue, ThreadPool::Scheduling::work_stealing);
+  auto eventually = [](auto condition) {
+    auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (!condition() && std::chrono::steady_clock::now() < deadline) { std::this_thread::sleep_for(1ms); }
+    return condition();
+  };
+
+  SECTION("resize starts and retires workers")
+  {
+    ThreadPool pool(ThreadPool::Options{ .threads = 2, .max_threads = 4, .scheduling = scheduling });
+    pool.resize(4);
+    REQUIRE(pool.size() == 4);
+    pool.resize(1);
+    REQUIRE(pool.size() == 1);
+    std::atomic<int> ran{ 0 };
+    std::vector<threadpool::Future<void>> done;
+    for (int i = 0; i < 100; ++i) { done.push_back(pool.async([&ran] { ran++; })); }
+    for (auto &future : done) { future.get(); }
+    REQUIRE(ran == 100);
+    pool.resize(3);
+    REQUIRE(pool.size() == 3);
+    REQUIRE(pool.async([] { return ThreadPool::this_worker()->index; }).get() < 3);
+  }
+
+  SECTION("Grows while tasks wait and shrinks once idle")
+  {
+    ThreadPool pool(ThreadPool::Options{
+      .threads = 1, .max_threads = 3, .grow_after = 1ms, .idle_timeout = 20ms, .scheduling = scheduling });
+    std::atomic<bool> release{ false };
+    std::vector<threadpool::Future<void>> blocked;
+    for (int i = 0; i < 3; ++i) {
+      blocked.push_back(pool.async([&release] {
+        while (!release) { std::this_thread::sleep_for(1ms); }
+      }));
+    }
+    // Three blocking tasks only all finish with three workers.
+    REQUIRE(eventually([&] { return pool.size() == 3; }));
+    release = true;
+    for (auto &future : blocked) { future.get(); }
+    REQUIRE(eventually([&] { return pool.size() == 1; }));
+    REQUIRE(pool.async([] { return 42; }).get() == 42);
+  }
+
+  SECTION("Grows for tasks waiting in a worker's deque")
+  {
+    // With work stealing, tasks queued by a task go to its worker's deque,
+    // not to the lanes; two of them only start once two workers are added.
+    ThreadPool pool(ThreadPool::Options{
+      .threads = 1, .max_threads = 3, .grow_after = 1ms, .idle_timeout = 20ms, .scheduling = scheduling });
+    std::atomic<int> started{ 0 };
+    std::atomic<bool> release{ false };
+    bool both_started = pool.async([&] {
+      for (int i = 0; i < 2; ++i) {
+        pool.submit([&] {
+          started++;
+          while (!release) { std::this_thread::sleep_for(1ms); }
+        });
+      }
+      bool result = eventually([&] { return started.load() == 2; });
+      release = true;
+      return result;
+    }).get();
+    REQUIRE(both_started);
+    REQUIRE(eventually([&] { return pool.size() == 1; }));
+  }
+
+  SECTION("Bounds are checked")
+  {
+    ThreadPool pool(ThreadPool::Options{ .threads = 2, .max_threads = 4, .scheduling = scheduling, .reserved_high = 1 });
+    REQUIRE_THROWS_AS(pool.resize(3, 2), std::invalid_argument);
+    REQUIRE_THROWS_AS(pool.resize(2, 5), std::invalid_argument);
+    REQUIRE_THROWS_AS(pool.resize(1), std::invalid_argument);
+    REQUIRE(pool.size() == 2);
+    REQUIRE_THROWS_AS(ThreadPool(ThreadPool::Options{ .threads = 1, .max_threads = 2, .grow_after = 0ms }),
+      std::invalid_argument);
+  }
+}
+
+TEST_CASE("TraceRecorder rings", "[threadpool][trace]")
+{
+  threadpool::TraceRecorder recorder(2, 3);// rounded up to 4 events per ring
+  for (int64_t i = 0; i < 10; i++) { recorder.record({ .enqueued = i, .start = 10 * i, .end = 10 * i + 5, .worker = 0 }); }
+  recorder.record({ .enqueued = 0, .start = 1, .end = 101, .worker = 1, .label = "say \"hi\"" });
+
+  auto events = recorder.events();
+  REQUIRE(events.size() == 5);
+  REQUIRE(events[0].worker == 1);
+  REQUIRE(events[1].start == 60);
+  REQUIRE(events[4].start == 90);
+
+  auto stats = recorder.stats();
+  REQUIRE(stats.workers.size() == 2);
+  REQUIRE(stats.workers[0].tasks == 10);
+  REQUIRE(stats.workers[0].busy == std::chrono::nanoseconds(50));
+  REQUIRE(stats.workers[1].busy == std::chrono::nanoseconds(100));
+  REQUIRE(stats.run_percentile_ns(0.5) == 5);
+  REQUIRE(stats.run_percentile_ns(1.0) == threaded_queue::QueueStatsSnapshot::bucket_floor(
+                                           threaded_queue::QueueStatsSnapshot::bucket_of(100)));
+
+  std::ostringstream json;
+  recorder.write_chrome_json(json, { "w0", "w1" });
+  REQUIRE(json.str().find(R"("name":"say \"hi\"")") != std::string::npos);
+  REQUIRE(json.str().find(R"("ts":0.090,"dur":0.005)") != std::string::npos);
+  REQUIRE(json.str().find(R"("args":{"name":"w1"})") != std::string::npos);
+}
+
+TEST_CASE("TraceRecorder reads while recording", "[threadpool][trace][threading]")
+{
+  threadpool::TraceRecorder recorder(1, 64);
+  std::atomic<bool> stop{ false };
+  std::vector<std::thread> writers;
+  for (int64_t writer = 0; writer < 2; writer++) {
+    writers.emplace_back([&recorder, &stop, writer] {
+      for (int64_t i = 0; !stop; i++) {
+        recorder.record({ .enqueued = i, .start = 2 * i + writer, .end = 2 * i + writer + 5, .worker = 0 });
+      }
+    });
+  }
+  bool torn = false;
+  for (int round = 0; round < 200; round++) {
+    for (const auto &event : recorder.events()) { torn = torn || event.end - event.start != 5 || event.worker != 0; }
+  }
+  stop = true;
+  for (auto &writer : writers) { writer.join(); }
+  REQUIRE_FALSE(torn);
+  REQUIRE(recorder.events().size() <= 64);
+}
+
+TEST_CASE("ThreadPool tracing", "[threadpool][trace]")
+{
+  auto scheduling = GENERATE(ThreadPool::Scheduling::shared_queue, ThreadPool::Scheduling::work_stealing);
+  ThreadPool pool(ThreadPool::Options{ .threads = 2, .scheduling = scheduling, .name = "traced", .trace = true });
+  std::vector<threadpool::Future<void>> done;
+  {
+    threadpool::TraceLabel label("parse");
+    for (int i = 0; i < 10; i++) { done.push_back(pool.async([] {})); }
+  }
+  for (int i = 0; i < 5; i++) { done.push_back(pool.async([] {})); }
+  for (auto &future : done) { future.get(); }
+
+  // A task records itself after its future is ready.
+  auto traced = [&pool] {
+    uint64_t tasks = 0;
+    for (const auto &worker : pool.trace_stats().workers) { tasks += worker.tasks; }
+    return tasks;
+  };
+  while (traced() < 15) { std::this_thread::yield(); }
+  auto stats = pool.trace_stats();
+  REQUIRE(stats.workers.size() == 3);
+  REQUIRE(stats.workers[2].tasks == 0);// nothing ran outside the workers
+  REQUIRE(stats.workers[0].utilization <= 1.0);
+
+  auto path = std::filesystem::temp_directory_path() / "threadpool_trace_test.json";
+  pool.dump_trace(path.string());
+  std::ifstream file(path);
+  REQUIRE(file);
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  std::string json = buffer.str();
+  std::filesystem::remove(path);
+  auto count = [&json](std::string_view needle) {
+    size_t found = 0;
+    for (size_t at = json.find(needle); at != std::string::npos; at = json.find(needle, at + 1)) { found++; }
+    return found;
+  };
+  REQUIRE(count(R"("name":"parse")") == 10);
+  REQUIRE(count(R"("name":"task")") == 5);
+  REQUIRE(count(R"("args":{"name":"traced-external"})") == 1);
+
+  ThreadPool untraced(1);
+  REQUIRE(untraced.trace_stats().workers.empty());
+  REQUIRE_THROWS_AS(pool.dump_trace("/nonexistent/dir/trace.json"), std::runtime_error);
+}
+
+TEST_CASE("Parallel algorithms", "[threadpool][parallel]")
+{
+  auto scheduling = GENERATE(ThreadPool::Scheduling::shared_queue, ThreadPool::Scheduling::work_stealing);
+  auto grain = GENERATE(size_t{ 0 }, size_t{ 1 }, size_t{ 7 }, size_t{ 100000 });
+  ThreadPool pool(3, {}, scheduling);
+
+  SECTION("parallel_for visits every index once")
+  {
+    std::vector<std::atomic<int>> visits(1000);
+    threadpool::parallel_for(pool, 0, 1000, [&](int i) { visits[static_cast<size_t>(i)].fetch_add(1); }, grain);
+    REQUIRE(std::all_of(visits.begin(), visits.end(), [](auto &n) { return n.load() == 1; }));
+
+    std::vector<int> values(1000, 1);
+    threadpool::parallel_for(pool, values, [](int &v) { v *= 3; }, grain);
+    REQUIRE(std::accumulate(values.begin(), values.end(), 0) == 3000);
+
+    threadpool::parallel_for(pool, 5, 5, [](int) { FAIL("empty range"); }, grain);
+  }
+
+  SECTION("parallel_transform keeps the order")
+  {
+    std::vector<int> input(1000);
+    std::iota(input.begin(), input.end(), 0);
+    std::vector<int64_t> output(input.size());
+    auto end = threadpool::parallel_transform(pool, input, output.begin(), [](int v) { return int64_t{ v } * v; }, grain);
+    REQUIRE(end == output.end());
+    for (size_t i = 0; i < output.size(); i++) { REQUIRE(output[i] == static_cast<int64_t>(i * i)); }
+  }
+
+  SECTION("parallel_reduce combines in order")
+  {
+    std::vector<int> input(1000);
+    std::iota(input.begin(), input.end(), 1);
+    REQUIRE(threadpool::parallel_reduce(pool, input, int64_t{ 0 }, std::plus<>{}, grain) == 500500);
+
+    // Concatenation is associative but not commutative.
+    std::vector<std::string> letters;
+    for (char c = 'a'; c <= 'z'; c++) { letters.emplace_back(1, c); }
+    auto joined = threadpool::parallel_reduce(pool, letters, std::string(">"), std::plus<>{}, grain);
+    REQUIRE(joined == ">abcdefghijklmnopqrstuvwxyz");
+
+    std::vector<int> none;
+    REQUIRE(threadpool::parallel_reduce(pool, none, 42) == 42);
+  }
+
+  SECTION("Exceptions reach the caller")
+  {
+    auto body = [](int i) {
+      if (i == 500) { throw std::runtime_error("bad index"); }
+    };
+    REQUIRE_THROWS_AS(threadpool::parallel_for(pool, 0, 1000, body, grain), std::runtime_error);
+  }
+
+  SECTION("Nested calls from inside workers")
+  {
+    // Every worker blocks in an outer iteration while the inner loops still
+    // need running; the callers run the inner chunks themselves.
+    std::atomic<int> sum{ 0 };
+    threadpool::parallel_for(
+      pool,
+      0,
+      8,
+      [&](int) { threadpool::parallel_for(pool, 0, 100, [&](int j) { sum.fetch_add(j); }, grain); },
+      1);
+    REQUIRE(sum.load() == 8 * 4950);
+  }
+}
+
+namespace {
+threadpool::task<int> Square(ThreadPool &pool, int x)
+{
+  co_await pool.schedule();
+  co_return x * x;
+}
+
+threadpool::task<void> Fail(ThreadPool &pool)
+{
+  co_await pool.schedule();
+  throw std::runtime_error("coroutine failed");
+}
+
+threadpool::task<int> Slow(ThreadPool &pool, std::atomic<bool> &release)
+{
+  co_await pool.schedule();
+  while (!release.load()) { std::this_thread::yield(); }
+  co_return 1;
+}
+
+threadpool::task<uint64_t> Fib(ThreadPool &pool, int n)
+{
+  co_await pool.schedule();
+  if (n < 2) { co_return static_cast<uint64_t>(n); }
+  auto [a, b] = co_await threadpool::when_all(Fib(pool, n - 1), Fib(pool, n - 2));
+  co_return a + b;
+}
+}// namespace
+
+TEST_CASE("Coroutines on ThreadPool", "[threadpool][coroutine]")
+{
+  auto scheduling = GENERATE(ThreadPool::Scheduling::shared_queue, ThreadPool::Scheduling::work_stealing);
+  ThreadPool pool(2, {}, scheduling);
+
+  SECTION("schedule resumes on a worker")
+  {
+    auto caller = std::this_thread::get_id();
+    auto on_worker = [&]() -> threadpool::task<bool> {
+      co_await pool.schedule();
+      co_return std::this_thread::get_id() != caller;
+    };
+    REQUIRE(threadpool::sync_wait(on_worker()));
+    REQUIRE(threadpool::sync_wait(Square(pool, 12)) == 144);
+  }
+
+  SECTION("Exceptions propagate through co_await and sync_wait")
+  {
+    auto outer = [&]() -> threadpool::task<int> {
+      co_await Fail(pool);
+      co_return 1;
+    };
+    REQUIRE_THROWS_AS(threadpool::sync_wait(outer()), std::runtime_error);
+  }
+
+  SECTION("when_all")
+  {
+    std::vector<threadpool::task<int>> squares;
+    for (int i = 0; i < 100; i++) { squares.push_back(Square(pool, i)); }
+    auto results = threadpool::sync_wait(threadpool::when_all(std::move(squares)));
+    REQUIRE(results.size() == 100);
+    for (int i = 0; i < 100; i++) { REQUIRE(results[static_cast<size_t>(i)] == i * i); }
+
+    auto nothing = [&]() -> threadpool::task<void> { co_await pool.schedule(); };
+    auto [square, none] = threadpool::sync_wait(threadpool::when_all(Square(pool, 3), nothing()));
+    REQUIRE(square == 9);
+    STATIC_REQUIRE(std::is_same_v<decltype(none), std::monostate>);
+
+    std::vector<threadpool::task<void>> failing;
+    failing.push_back(Fail(pool));
+    REQUIRE_THROWS_AS(threadpool::sync_wait(threadpool::when_all(std::move(failing))), std::runtime_error);
+  }
+
+  SECTION("Nested fan-out does not tie up workers")
+  {
+    // Far more levels of suspended parents than there are workers.
+    REQUIRE(threadpool::sync_wait(Fib(pool, 16)) == 987);
+  }
+
+}
+
+TEST_CASE("when_any returns the first task to finish", "[threadpool][coroutine]")
+{
+  // The losing task keeps running after when_any returns, so everything it
+  // uses is declared before the pool, whose destructor waits for it.
+  std::atomic<bool> release{ false };
+  ThreadPool pool(2);
+  std::vector<threadpool::task<int>> racers;
+  racers.push_back(Slow(pool, release));
+  racers.push_back(Square(pool, 5));
+  auto [index, value] = threadpool::sync_wait(threadpool::when_any(std::move(racers)));
+  release.store(true);
+  REQUIRE(index == 1);
+  REQUIRE(value == 25);
+}
+
+TEST_CASE("TaskGraph", "[threadpool][graph]")
+{
+  auto scheduling = GENERATE(ThreadPool::Scheduling::shared_queue, ThreadPool::Scheduling::work_stealing);
+  ThreadPool pool(3, {}, scheduling);
+  threadpool::TaskGraph graph;
+
+  SECTION("Nodes run after their predecessors, on every run")
+  {
+    // read -> {parse_a, parse_b} -> merge, plus an unrelated root.
+    std::atomic<int> clock{ 0 };
+    std::array<std::atomic<int>, 5> ran_at{};
+    std::array<std::atomic<int>, 5> runs{};
+    auto stamp = [&](size_t node) {
+      return [&, node] {
+        ran_at[node].store(clock.fetch_add(1));
+        runs[node].fetch_add(1);
+      };
+    };
+    auto read = graph.add(stamp(0), {}, "read");
+    auto parse_a = graph.add(stamp(1), { read });
+    auto parse_b = graph.add(stamp(2), { read });
+    auto merge = graph.add(stamp(3), { parse_a, parse_b }, "merge");
+    graph.add(stamp(4));
+    REQUIRE(graph.size() == 5);
+    REQUIRE(graph.name(merge) == "merge");
+
+    for (int run = 1; run <= 50; run++) {
+      graph.run(pool);
+      REQUIRE(ran_at[0].load() < ran_at[1].load());
+      REQUIRE(ran_at[0].load() < ran_at[2].load());
+      REQUIRE(ran_at[1].load() < ran_at[3].load());
+      REQUIRE(ran_at[2].load() < ran_at[3].load());
+    }
+    REQUIRE(std::all_of(runs.begin(), runs.end(), [](auto &n) { return n.load() == 50; }));
+    REQUIRE(graph.timing(read).end <= graph.timing(merge).start);
+    REQUIRE(graph.timing(merge).duration().count() >= 0);
+    REQUIRE(graph.elapsed() >= graph.timing(merge).end);
+  }
+
+  SECTION("Wide and deep graphs")
+  {
+    std::atomic<int> count{ 0 };
+    auto root = graph.add([] {});
+    auto sink = graph.add([] {});
+    for (int i = 0; i < 500; i++) {
+      auto middle = graph.add([&count] { count.fetch_add(1); }, { root });
+      graph.precede(middle, sink);
+    }
+    auto last = sink;
+    for (int i = 0; i < 500; i++) { last = graph.add([&count] { count.fetch_add(1); }, { last }); }
+    graph.run(pool);
+    graph.run(pool);
+    REQUIRE(count.load() == 2000);
+  }
+
+  SECTION("A task can run a graph on its own pool")
+  {
+    // One worker, two roots: the second root is queued behind the task that
+    // runs the graph, so run() must execute it rather than wait for it.
+    ThreadPool single(1, {}, scheduling);
+    std::atomic<int> count{ 0 };
+    auto left = graph.add([&count] { count.fetch_add(1); });
+    auto right = graph.add([&count] { count.fetch_add(1); });
+    graph.add([&count] { count.fetch_add(1); }, { left, right });
+    single.async([&] { graph.run(single); }).get();
+    REQUIRE(count.load() == 3);
+  }
+
+  SECTION("Invalid graphs are rejected")
+  {
+    auto a = graph.add([] {});
+    auto b = graph.add([] {}, { a });
+    REQUIRE_THROWS_AS(graph.add([] {}, { 7 }), std::invalid_argument);
+    graph.precede(b, a);
+    REQUIRE_THROWS_AS(graph.run(pool), std::invalid_argument);
+  }
+
+  SECTION("A failing node skips what depends on it")
+  {
+    bool downstream_ran = false;
+    auto fail = graph.add([] { throw std::runtime_error("stage failed"); });
+    graph.add([&downstream_ran] { downstream_ran = true; }, { fail });
+    REQUIRE_THROWS_AS(graph.run(pool), std::runtime_error);
+    REQUIRE_FALSE(downstream_ran);
+  }
+}
+
+TEST_CASE("TaskGroup", "[threadpool][group]")
+{
+  auto scheduling = GENERATE(ThreadPool::Scheduling::shared_queue, ThreadPool::Scheduling::work_stealing);
+  ThreadPool pool(2, {}, scheduling);
+
+  SECTION("wait returns once every task has run")
+  {
+    std::atomic<int> ran{ 0 };
+    threadpool::TaskGroup group(pool);
+    for (int i = 0; i < 1000; i++) { group.run([&ran] { ran++; }); }
+    group.wait();
+    REQUIRE(ran == 1000);
+    REQUIRE(group.pending() == 0);
+
+    group.run([&ran] { ran++; }, ThreadPool::Priority::high);
+    group.wait();
+    REQUIRE(ran == 1001);
+  }
+
+  SECTION("Exceptions are collected")
+  {
+    threadpool::TaskGroup group(pool);
+    for (int i = 0; i < 10; i++) {
+      group.run([i] {
+        if (i % 3 == 0) { throw std::runtime_error("task " + std::to_string(i)); }
+      });
+    }
+    REQUIRE(group.join().size() == 4);
+    group.run([] { throw std::invalid_argument("bad"); });
+    REQUIRE_THROWS_AS(group.wait(), std::invalid_argument);
+    REQUIRE(group.join().empty());
+  }
+
+  SECTION("Nested groups wait inside workers without deadlock")
+  {
+    // Every worker ends up waiting on a group of its own; only helping
+    // lets their subtasks run.
+    std::atomic<int> leaves{ 0 };
+    std::function<void(int)> tree = [&](int depth) {
+      if (depth == 0) {
+        leaves++;
+        return;
+      }
+      threadpool::TaskGroup children(pool);
+      for (int i = 0; i < 4; i++) { children.run([&tree, depth] { tree(depth - 1); }); }
+      children.wait();
+    };
+    tree(5);
+    REQUIRE(leaves == 1024);
+  }
+
+  SECTION("The destructor waits")
+  {
+    std::atomic<int> ran{ 0 };
+    {
+      threadpool::TaskGroup group(pool);
+      for (int i = 0; i < 100; i++) { group.run([&ran] { ran++; }); }
+    }
+    REQUIRE(ran == 100);
+  }
+
+  SECTION("A task that cannot be queued is not waited for")
+  {
+    // Moving it into the pool throws, as a failed allocation would.
+    struct Unmovable
+    {
+      Unmovable() = default;
+      Unmovable(Unmovable &&) { throw std::runtime_error("cannot move"); }
+      void operator()() const {}
+    };
+    threadpool::TaskGroup group(pool);
+    group.run([] {});
+    REQUIRE_THROWS_AS(group.run(Unmovable{}), std::runtime_error);
+    REQUIRE(group.join().empty());
+    REQUIRE(group.pending() == 0);
+  }
+}
+
+TEST_CASE("ThreadPool wait_idle", "[threadpool][group]")
+{
+  auto scheduling = GENERATE(ThreadPool::Scheduling::shared_queue, ThreadPool::Scheduling::work_stealing);
+  ThreadPool pool(2, {}, scheduling);
+  pool.wait_idle();
+
+  std::atomic<int> ran{ 0 };
+  for (int i = 0; i < 100; i++) {
+    pool.submit([&pool, &ran] {
+      ran++;
+      pool.submit([&ran] { ran++; });// queued by a task: waited for too
+    });
+  }
+  pool.wait_idle();
+  REQUIRE(ran == 200);
+
+  auto nested = pool.async([&pool] {
+    try {
+      pool.wait_idle();
+    } catch (const std::logic_error &) {
+      return true;
+    }
+    return false;
+  });
+  REQUIRE(nested.get());
+
+  ThreadPool empty(ThreadPool::Options{ .threads = 0 });
+  empty.submit([&ran] { ran++; });
+  REQUIRE(empty.run_pending_task());
+  REQUIRE_FALSE(empty.run_pending_task());
+  empty.submit([&ran] { ran++; });
+  empty.wait_idle();// runs it itself
+  REQUIRE(ran == 202);
+}
@@ -1,9 +1,21 @@
 #include "threadsafequeue/thread_safe_queue.h"
+#include "threadsafequeue/mpmc_queue.h"
+#include "threadsafequeue/spsc_queue.h"
+#include "threadsafequeue/timestamp_queue.h"
+#include "objectpool/concurrent_objectpool.h"
+#include "objectpool/pooled_ptr.h"
 #include <algorithm>
 #include <atomic>
 #include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
 #include <chrono>
+#include <functional>
+#include <span>
+#include <string>
+#include <type_traits>
 #include <thread>
+#include <utility>
+#include <vector>
 
 using namespace threaded_queue;
 
@@ -165,4 +177,711 @@ TEST_CASE("ThreadSafeQueue Template flexibility", "[threadsafequeue][template][b
     REQUIRE(result2.has_value());
     REQUIRE(*result2.value() == "World");
   }
-}
\ No newline at end of file
+}
+
+TEST_CASE("ThreadSafeQueue with pooled messages", "[threadsafequeue][pooled_ptr]")
+{
+  constexpr int count = 10000;
+  memory::ConcurrentObjectPool<Message> pool(256);
+  ThreadSafeQueue<Message, memory::PoolDeleter<Message>> queue;
+  std::atomic<int> consumed{ 0 };
+
+  std::thread consumer_thread([&] {
+    uint64_t expected = 0;
+    while (auto msg = queue.wait_and_pop()) {
+      REQUIRE(msg.value()->timestamp_ns == expected++);
+      consumed.fetch_add(1, std::memory_order_release);
+    }
+  });
+
+  for (int i = 0; i < count; ++i) {
+    // Keep the number of messages in flight well below the pool capacity.
+    while (i - consumed.load(std::memory_order_acquire) >= 64) { std::this_thread::yield(); }
+    queue.push(memory::make_pooled(pool, Message{ static_cast<uint64_t>(i), "pooled", {} }));
+  }
+  queue.push(std::make_unique<Message>(Message{ static_cast<uint64_t>(count), "heap", {} }));
+  while (consumed.load() < count + 1) { std::this_thread::yield(); }
+  queue.shutdown();
+  consumer_thread.join();
+  REQUIRE(consumed.load() == count + 1);
+}
+
+
+TEST_CASE("BoundedMPMCQueue Basic operations", "[threadsafequeue][mpmc][fast]")
+{
+  BoundedMPMCQueue<Message> queue(3);
+  REQUIRE(queue.capacity() == 4);
+  REQUIRE(queue.empty());
+  REQUIRE_FALSE(queue.try_pop().has_value());
+
+  for (uint64_t i = 0; i < 4; ++i) {
+    REQUIRE(queue.push(std::make_unique<Message>(Message{ i, "dummy", {} })));
+  }
+  REQUIRE(queue.size() == 4);
+
+  auto overflow = std::make_unique<Message>(Message{ 4, "dummy", {} });
+  REQUIRE_FALSE(queue.try_push(overflow));
+  REQUIRE(overflow != nullptr);
+
+  for (uint64_t i = 0; i < 4; ++i) {
+    auto msg = queue.try_pop();
+    REQUIRE(msg.has_value());
+    REQUIRE(msg.value()->timestamp_ns == i);
+  }
+  REQUIRE(queue.try_push(overflow));
+  REQUIRE(overflow == nullptr);
+  REQUIRE(queue.wait_and_pop().value()->timestamp_ns == 4);
+
+  queue.shutdown();
+  REQUIRE_FALSE(queue.wait_and_pop().has_value());
+  REQUIRE_THROWS_AS(BoundedMPMCQueue<Message>(0), std::invalid_argument);
+}
+
+TEST_CASE("BoundedMPMCQueue Multiple producers and consumers", "[threadsafequeue][mpmc][threading]")
+{
+  constexpr int producers = 4;
+  constexpr int consumers = 4;
+  constexpr int per_producer = 20000;
+  // Small capacity so producers block on a full queue as well as consumers on an empty one.
+  BoundedMPMCQueue<int> queue(8);
+  std::vector<std::vector<int>> seen(consumers);
+
+  std::vector<std::thread> threads;
+  for (int c = 0; c < consumers; ++c) {
+    threads.emplace_back([&queue, &seen, c] {
+      while (auto item = queue.wait_and_pop()) { seen[static_cast<size_t>(c)].push_back(*item.value()); }
+    });
+  }
+  std::atomic<int> failed_pushes{ 0 };
+  std::vector<std::thread> producer_threads;
+  for (int p = 0; p < producers; ++p) {
+    producer_threads.emplace_back([&queue, &failed_pushes, p] {
+      for (int i = 0; i < per_producer; ++i) {
+        if (!queue.push(std::make_unique<int>(p * per_producer + i))) { failed_pushes.fetch_add(1); }
+      }
+    });
+  }
+  for (auto &thread : producer_threads) { thread.join(); }
+  REQUIRE(failed_pushes.load() == 0);
+  while (!queue.empty()) { std::this_thread::yield(); }
+  queue.shutdown();
+  for (auto &thread : threads) { thread.join(); }
+
+  std::vector<int> all;
+  for (auto &items : seen) {
+    // Items from one producer reach any given consumer in order.
+    std::vector<int> last(producers, -1);
+    for (int item : items) {
+      REQUIRE(item > last[static_cast<size_t>(item / per_producer)]);
+      last[static_cast<size_t>(item / per_producer)] = item;
+    }
+    all.insert(all.end(), items.begin(), items.end());
+  }
+  std::sort(all.begin(), all.end());
+  REQUIRE(all.size() == static_cast<size_t>(producers * per_producer));
+  for (size_t i = 0; i < all.size(); ++i) { REQUIRE(all[i] == static_cast<int>(i)); }
+}
+
+
+TEST_CASE("SPSCQueue Basic operations", "[threadsafequeue][spsc][fast]")
+{
+  SPSCQueue<Message> queue(3);
+  REQUIRE(queue.capacity() == 4);
+  REQUIRE(queue.empty());
+  REQUIRE_FALSE(queue.try_pop().has_value());
+
+  for (uint64_t i = 0; i < 4; ++i) {
+    REQUIRE(queue.push(std::make_unique<Message>(Message{ i, "dummy", {} })));
+  }
+  auto overflow = std::make_unique<Message>(Message{ 4, "dummy", {} });
+  REQUIRE_FALSE(queue.try_push(overflow));
+  REQUIRE(overflow != nullptr);
+  REQUIRE(queue.size() == 4);
+
+  REQUIRE(queue.try_pop().value()->timestamp_ns == 0);
+  REQUIRE(queue.try_push(overflow));
+  for (uint64_t i = 1; i < 5; ++i) { REQUIRE(queue.wait_and_pop().value()->timestamp_ns == i); }
+
+  queue.shutdown();
+  REQUIRE_FALSE(queue.wait_and_pop().has_value());
+  REQUIRE_THROWS_AS(SPSCQueue<Message>(0), std::invalid_argument);
+}
+
+TEST_CASE("SPSCQueue Batch spans", "[threadsafequeue][spsc][fast]")
+{
+  SPSCQueue<int> queue(8);
+
+  // Advance the indices so the next batch wraps around the end of the ring.
+  for (int i = 0; i < 6; ++i) { REQUIRE(queue.push(std::make_unique<int>(i))); }
+  auto read = queue.read_span(16);
+  REQUIRE(read.size() == 6);
+  REQUIRE(*read[5] == 5);
+  queue.commit_read(read.size());
+  REQUIRE(queue.empty());
+
+  auto write = queue.prepare_write(8);
+  REQUIRE(write.size() == 2);// stops at the end of the ring
+  for (size_t i = 0; i < write.size(); ++i) { write[i] = std::make_unique<int>(static_cast<int>(i)); }
+  queue.commit_write(write.size());
+  write = queue.prepare_write(8);
+  REQUIRE(write.size() == 6);
+  for (size_t i = 0; i < write.size(); ++i) { write[i] = std::make_unique<int>(static_cast<int>(i + 2)); }
+  queue.commit_write(write.size());
+  REQUIRE(queue.prepare_write(1).empty());
+  REQUIRE(queue.size() == 8);
+
+  read = queue.read_span(8);
+  REQUIRE(read.size() == 2);
+  auto first = std::move(read[0]);// moved out; the other is destroyed by commit_read
+  queue.commit_read(2);
+  REQUIRE(*first == 0);
+  for (int i = 2; i < 8; ++i) { REQUIRE(*queue.try_pop().value() == i); }
+}
+
+TEST_CASE("SPSCQueue Producer and consumer threads", "[threadsafequeue][spsc][threading]")
+{
+  constexpr int count = 100000;
+  SPSCQueue<int> queue(64);
+  std::atomic<int> failed_pushes{ 0 };
+
+  std::thread producer_thread([&] {
+    int next = 0;
+    while (next < count) {
+      // Alternate single pushes and batch writes.
+      if (next % 2 == 0) {
+        if (!queue.push(std::make_unique<int>(next++))) { failed_pushes.fetch_add(1); }
+        continue;
+      }
+      auto span = queue.prepare_write(static_cast<size_t>(std::min(count - next, 16)));
+      for (auto &cell : span) { cell = std::make_unique<int>(next++); }
+      queue.commit_write(span.size());
+    }
+  });
+
+  std::vector<int> received;
+  received.reserve(count);
+  while (static_cast<int>(received.size()) < count) {
+    auto span = queue.read_span(32);
+    if (span.empty()) {
+      auto item = queue.wait_and_pop();
+      if (item.has_value()) { received.push_back(*item.value()); }
+      continue;
+    }
+    for (auto &cell : span) { received.push_back(*cell); }
+    queue.commit_read(span.size());
+  }
+  producer_thread.join();
+
+  REQUIRE(failed_pushes.load() == 0);
+  REQUIRE(queue.empty());
+  for (int i = 0; i < count; ++i) { REQUIRE(received[static_cast<size_t>(i)] == i); }
+}
+
+
+TEST_CASE("ThreadSafeQueue bulk operations", "[threadsafequeue][bulk]")
+{
+  SECTION("Single thread")
+  {
+    ThreadSafeQueue<int> queue;
+    std::vector<std::unique_ptr<int>> batch;
+    for (int i = 0; i < 10; ++i) { batch.push_back(std::make_unique<int>(i)); }
+    queue.push_bulk(batch);
+    REQUIRE(queue.size() == 10);
+    REQUIRE(batch[0] == nullptr);
+
+    std::vector<std::unique_ptr<int>> out;
+    REQUIRE(queue.pop_bulk(std::back_inserter(out), 3) == 3);
+    REQUIRE(queue.wait_and_pop_bulk(std::back_inserter(out), 100) == 7);
+    REQUIRE(queue.pop_bulk(std::back_inserter(out), 100) == 0);
+    for (size_t i = 0; i < out.size(); ++i) { REQUIRE(*out[i] == static_cast<int>(i)); }
+
+    queue.shutdown();
+    REQUIRE(queue.wait_and_pop_bulk(std::back_inserter(out), 100) == 0);
+  }
+
+  SECTION("Batches across threads")
+  {
+    constexpr int batches = 500;
+    constexpr int batch_size = 32;
+    ThreadSafeQueue<int> queue;
+    std::vector<int> received;
+
+    std::thread consumer_thread([&] {
+      std::vector<std::unique_ptr<int>> out;
+      while (queue.wait_and_pop_bulk(std::back_inserter(out), 50) > 0) {
+        for (auto &item : out) { received.push_back(*item); }
+        out.clear();
+      }
+    });
+    for (int b = 0; b < batches; ++b) {
+      std::vector<std::unique_ptr<int>> batch;
+      for (int i = 0; i < batch_size; ++i) { batch.push_back(std::make_unique<int>(b * batch_size + i)); }
+      queue.push_bulk(batch);
+    }
+    while (!queue.empty()) { std::this_thread::yield(); }
+    queue.shutdown();
+    consumer_thread.join();
+
+    REQUIRE(received.size() == static_cast<size_t>(batches * batch_size));
+    for (size_t i = 0; i < received.size(); ++i) { REQUIRE(received[i] == static_cast<int>(i)); }
+  }
+}
+
+
+TEST_CASE("ThreadSafeQueue bounded capacity", "[threadsafequeue][bounded]")
+{
+  using namespace std::chrono_literals;
+
+  SECTION("Reject")
+  {
+    ThreadSafeQueue<int> queue(2, OverflowPolicy::reject);
+    REQUIRE(queue.capacity() == 2);
+    REQUIRE(queue.push(std::make_unique<int>(1)));
+    REQUIRE(queue.push(std::make_unique<int>(2)));
+    REQUIRE_FALSE(queue.push(std::make_unique<int>(3)));
+    REQUIRE(queue.size() == 2);
+    REQUIRE(*queue.try_pop().value() == 1);
+  }
+
+  SECTION("Drop oldest")
+  {
+    ThreadSafeQueue<int> queue(2, OverflowPolicy::drop_oldest);
+    for (int i = 1; i <= 5; ++i) { REQUIRE(queue.push(std::make_unique<int>(i))); }
+    REQUIRE(queue.size() == 2);
+    REQUIRE(*queue.try_pop().value() == 4);
+    REQUIRE(*queue.try_pop().value() == 5);
+  }
+
+  SECTION("try_push and push_for leave the item on failure")
+  {
+    ThreadSafeQueue<int> queue(1);
+    REQUIRE(queue.push(std::make_unique<int>(1)));
+    auto item = std::make_unique<int>(2);
+    REQUIRE_FALSE(queue.try_push(item));
+    REQUIRE_FALSE(queue.push_for(item, 5ms));
+    REQUIRE(item != nullptr);
+    REQUIRE(*queue.try_pop().value() == 1);
+    REQUIRE(queue.push_for(item, 5ms));
+    REQUIRE(item == nullptr);
+  }
+
+  SECTION("Timed pops")
+  {
+    ThreadSafeQueue<int> queue;
+    auto start = std::chrono::steady_clock::now();
+    REQUIRE_FALSE(queue.pop_for(10ms).has_value());
+    REQUIRE(std::chrono::steady_clock::now() - start >= 10ms);
+    REQUIRE_FALSE(queue.pop_until(std::chrono::steady_clock::now() + 1ms).has_value());
+
+    queue.push(std::make_unique<int>(7));
+    REQUIRE(*queue.pop_for(1s).value() == 7);
+  }
+
+  SECTION("Blocking push waits for a consumer")
+  {
+    ThreadSafeQueue<int> queue(4);
+    constexpr int count = 2000;
+    std::atomic<size_t> max_size{ 0 };
+    std::thread producer_thread([&] {
+      for (int i = 0; i < count; ++i) { queue.push(std::make_unique<int>(i)); }
+    });
+    for (int i = 0; i < count; ++i) {
+      max_size.store(std::max(max_size.load(), queue.size()));
+      auto item = queue.pop_for(1s);
+      REQUIRE(item.has_value());
+      REQUIRE(*item.value() == i);
+    }
+    producer_thread.join();
+    REQUIRE(max_size.load() <= 4);
+  }
+
+  SECTION("Bulk push honours the bound")
+  {
+    ThreadSafeQueue<int> queue(3, OverflowPolicy::reject);
+    std::vector<std::unique_ptr<int>> batch;
+    for (int i = 0; i < 5; ++i) { batch.push_back(std::make_unique<int>(i)); }
+    REQUIRE(queue.push_bulk(batch) == 3);
+    REQUIRE(batch[3] != nullptr);
+
+    // The two rejected items, pushed through a queue with room for one.
+    ThreadSafeQueue<int> blocking(1);
+    size_t pushed = 0;
+    std::thread producer_thread([&] { pushed = blocking.push_bulk(std::span(batch).subspan(3)); });
+    std::vector<std::unique_ptr<int>> out;
+    while (out.size() < 2) { blocking.pop_bulk(std::back_inserter(out), 1); }
+    producer_thread.join();
+    REQUIRE(pushed == 2);
+    REQUIRE(*out[0] == 3);
+    REQUIRE(*out[1] == 4);
+  }
+
+  SECTION("Shutdown releases a blocked producer")
+  {
+    ThreadSafeQueue<int> queue(1);
+    REQUIRE(queue.push(std::make_unique<int>(1)));
+    std::atomic<bool> result{ true };
+    std::thread producer_thread([&] { result = queue.push(std::make_unique<int>(2)); });
+    std::this_thread::sleep_for(5ms);
+    queue.shutdown();
+    producer_thread.join();
+    REQUIRE_FALSE(result.load());
+  }
+
+  REQUIRE_THROWS_AS(ThreadSafeQueue<int>(0), std::invalid_argument);
+}
+
+
+TEST_CASE("SegmentedRing", "[threadsafequeue][segmented_ring]")
+{
+  using Ring = SegmentedRing<std::string>;
+  constexpr size_t segment = Ring::kSegmentSize;
+
+  SECTION("Drained segments are reused")
+  {
+    Ring ring;
+    for (size_t round = 0; round < 10; ++round) {
+      for (size_t i = 0; i < segment; ++i) { ring.push_back(std::to_string(i)); }
+      for (size_t i = 0; i < segment; ++i) {
+        REQUIRE(ring.front() == std::to_string(i));
+        ring.pop_front();
+      }
+    }
+    REQUIRE(ring.empty());
+    REQUIRE(ring.capacity() == segment);
+  }
+
+  SECTION("Growing while wrapped keeps FIFO order")
+  {
+    Ring ring;
+    size_t next_in = 0;
+    size_t next_out = 0;
+    // Fill two segments, then move the front into the middle of the first one
+    // and fill up again, so the back wraps into the front's segment.
+    for (size_t i = 0; i < 2 * segment; ++i) { ring.push_back(std::to_string(next_in++)); }
+    for (size_t i = 0; i < segment / 2; ++i) {
+      REQUIRE(ring.front() == std::to_string(next_out++));
+      ring.pop_front();
+    }
+    while (ring.size() < ring.capacity()) { ring.push_back(std::to_string(next_in++)); }
+    for (size_t i = 0; i < 3 * segment; ++i) { ring.emplace_back(std::to_string(next_in++)); }
+    REQUIRE(ring.capacity() == 8 * segment);
+
+    while (!ring.empty()) {
+      REQUIRE(ring.front() == std::to_string(next_out++));
+      ring.pop_front();
+    }
+    REQUIRE(next_out == next_in);
+  }
+}
+
+
+TEST_CASE("ThreadSafeValueQueue", "[threadsafequeue][value]")
+{
+  SECTION("Values move in and out")
+  {
+    ThreadSafeValueQueue<std::string> queue;
+    queue.push("first");
+    REQUIRE(queue.emplace(size_t{ 3 }, 'x'));
+    REQUIRE(queue.try_pop().value() == "first");
+    REQUIRE(queue.wait_and_pop().value() == "xxx");
+    REQUIRE_FALSE(queue.try_pop().has_value());
+  }
+
+  SECTION("Bounded and bulk")
+  {
+    ThreadSafeValueQueue<int> queue(3, OverflowPolicy::drop_oldest);
+    std::vector<int> batch{ 1, 2, 3, 4, 5 };
+    REQUIRE(queue.push_bulk(batch) == 5);
+    REQUIRE(queue.emplace(6));
+    std::vector<int> out;
+    REQUIRE(queue.pop_bulk(std::back_inserter(out), 10) == 3);
+    REQUIRE(out == std::vector<int>{ 4, 5, 6 });
+  }
+
+  SECTION("Dropped items are destroyed outside the lock")
+  {
+    // The destructor of a dropped item may use the queue it came from.
+    struct Reentrant
+    {
+      ThreadSafeValueQueue<Reentrant> *queue;
+      size_t *seen;
+      Reentrant(ThreadSafeValueQueue<Reentrant> *q, size_t *s) : queue(q), seen(s) {}
+      Reentrant(Reentrant &&other) noexcept : queue(std::exchange(other.queue, nullptr)), seen(other.seen) {}
+      Reentrant &operator=(Reentrant &&other) noexcept
+      {
+        queue = std::exchange(other.queue, nullptr);
+        seen = other.seen;
+        return *this;
+      }
+      ~Reentrant()
+      {
+        if (queue != nullptr) { *seen = queue->size(); }
+      }
+    };
+    ThreadSafeValueQueue<Reentrant> queue(1, OverflowPolicy::drop_oldest);
+    size_t seen = 0;
+    std::vector<Reentrant> batch;
+    batch.emplace_back(&queue, &seen);
+    batch.emplace_back(&queue, &seen);
+    REQUIRE(queue.push_bulk(batch) == 2);
+    REQUIRE(seen == 1);
+    REQUIRE(queue.emplace(&queue, &seen));
+    REQUIRE(seen == 1);
+    REQUIRE(queue.try_pop().has_value());
+    REQUIRE(seen == 0);
+  }
+
+  SECTION("Across threads")
+  {
+    constexpr int count = 20000;
+    ThreadSafeValueQueue<std::function<int()>> queue;
+    std::thread producer_thread([&] {
+      for (int i = 0; i < count; ++i) { queue.push([i] { return i; }); }
+      queue.shutdown();
+    });
+    int expected = 0;
+    bool in_order = true;
+    while (auto task = queue.wait_and_pop()) { in_order = in_order && (*task)() == expected++; }
+    producer_thread.join();
+    REQUIRE(in_order);
+    REQUIRE(expected == count);
+  }
+}
+
+
+TEST_CASE("ThreadSafeValueQueue spin_then_park", "[threadsafequeue][wait_policy]")
+{
+  using namespace std::chrono_literals;
+  auto policy = GENERATE(WaitPolicy::spin_then_park(), WaitPolicy::spin_then_park(0, 0));
+
+  SECTION("Across threads")
+  {
+    constexpr int count = 20000;
+    ThreadSafeValueQueue<int> queue(policy);
+    std::thread producer_thread([&] {
+      for (int i = 0; i < count; ++i) {
+        queue.push(i);
+        if (i % 1000 == 0) { std::this_thread::sleep_for(100us); }// let the consumer park
+      }
+    });
+    int expected = 0;
+    bool in_order = true;
+    while (expected < count) { in_order = in_order && queue.wait_and_pop().value() == expected++; }
+    producer_thread.join();
+    REQUIRE(in_order);
+  }
+
+  SECTION("Bulk wakes parked consumers")
+  {
+    ThreadSafeValueQueue<int> queue(policy);
+    std::atomic<int> popped{ 0 };
+    std::vector<std::thread> consumers;
+    for (int c = 0; c < 3; ++c) {
+      consumers.emplace_back([&] {
+        while (queue.wait_and_pop()) { popped.fetch_add(1); }
+      });
+    }
+    std::this_thread::sleep_for(5ms);
+    std::vector<int> batch{ 1, 2, 3, 4, 5, 6 };
+    queue.push_bulk(batch);
+    while (popped.load() < 6) { std::this_thread::yield(); }
+    queue.shutdown();
+    for (auto &consumer : consumers) { consumer.join(); }
+    REQUIRE(popped.load() == 6);
+  }
+
+  SECTION("Timed pop and shutdown")
+  {
+    ThreadSafeValueQueue<int> queue(4, OverflowPolicy::block, policy);
+    REQUIRE_FALSE(queue.pop_for(5ms).has_value());
+    std::thread producer_thread([&] {
+      std::this_thread::sleep_for(2ms);
+      queue.push(7);
+    });
+    REQUIRE(queue.pop_for(5s).value() == 7);
+    producer_thread.join();
+
+    std::atomic<bool> released{ false };
+    std::thread consumer_thread([&] { released = !queue.wait_and_pop().has_value(); });
+    std::this_thread::sleep_for(5ms);
+    queue.shutdown();
+    consumer_thread.join();
+    REQUIRE(released.load());
+  }
+}
+
+
+TEST_CASE("TimestampHeap orders by timestamp", "[threadsafequeue][timestamp]")
+{
+  SECTION("Earliest first, ties in insertion order")
+  {
+    TimestampHeap<Message> heap;
+    std::vector<uint64_t> stamps{ 50, 10, 40, 10, 30, 20, 70, 60, 0, 90, 80 };
+    for (size_t i = 0; i < stamps.size(); ++i) { heap.push(Message{ stamps[i], std::to_string(i), {} }); }
+    REQUIRE(heap.top_timestamp() == 0);
+
+    std::vector<Message> out;
+    while (auto msg = heap.try_pop()) { out.push_back(std::move(*msg)); }
+    REQUIRE(out.size() == stamps.size());
+    REQUIRE(std::is_sorted(out.begin(), out.end(), [](auto &a, auto &b) { return a.timestamp_ns < b.timestamp_ns; }));
+    REQUIRE(out[1].topic == "1");// the first of the two 10s
+    REQUIRE(out[2].topic == "3");
+  }
+
+  SECTION("Watermark drain through pointers")
+  {
+    TimestampHeap<std::unique_ptr<Message>, MessageTimestamp, 8> heap;
+    for (uint64_t t = 1000; t > 0; --t) { heap.push(std::make_unique<Message>(Message{ (t * 7919) % 1000, "", {} })); }
+    std::vector<std::unique_ptr<Message>> out;
+    REQUIRE(heap.pop_older_than(100, std::back_inserter(out)) == 100);
+    for (size_t i = 0; i < out.size(); ++i) { REQUIRE(out[i]->timestamp_ns == i); }
+    REQUIRE(heap.size() == 900);
+    REQUIRE(heap.top_timestamp() == 100);
+  }
+
+  SECTION("Interleaved pushes and pops, for several arities")
+  {
+    // Sizes cross group boundaries in both directions.
+    auto check = [](auto heap) {
+      std::vector<uint64_t> reference;
+      uint64_t state = 12345;
+      for (int i = 0; i < 3000; ++i) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        if (state >> 62 != 0 || reference.empty()) {
+          uint64_t stamp = (state >> 33) % 500;
+          heap.push(Message{ stamp, "", {} });
+          reference.push_back(stamp);
+        } else {
+          auto earliest = std::min_element(reference.begin(), reference.end());
+          REQUIRE(heap.pop().timestamp_ns == *earliest);
+          reference.erase(earliest);
+        }
+        REQUIRE(heap.size() == reference.size());
+      }
+    };
+    check(TimestampHeap<Message, MessageTimestamp, 2>{});
+    check(TimestampHeap<Message, MessageTimestamp, 3>{});
+    check(TimestampHeap<Message, MessageTimestamp, 4>{});
+  }
+}
+
+
+TEST_CASE("TimestampQueue merges producers", "[threadsafequeue][timestamp][threading]")
+{
+  constexpr int producers = 4;
+  constexpr uint64_t per_producer = 2000;
+  TimestampQueue<Message> queue;
+
+  // Every producer emits increasing timestamps on its own stride, so the
+  // combined stream is out of order while each producer's is not.
+  std::vector<std::thread> threads;
+  std::vector<std::atomic<uint64_t>> progress(producers);
+  for (int p = 0; p < producers; ++p) {
+    threads.emplace_back([&, p] {
+      for (uint64_t i = 0; i < per_producer; ++i) {
+        uint64_t stamp = i * producers + static_cast<uint64_t>(p);
+        queue.push(Message{ stamp, "", {} });
+        progress[static_cast<size_t>(p)].store(stamp + 1);
+      }
+      progress[static_cast<size_t>(p)].store(UINT64_MAX);// finished
+    });
+  }
+
+  std::vector<Message> merged;
+  while (merged.size() < producers * per_producer) {
+    uint64_t watermark = UINT64_MAX;
+    for (auto &done : progress) { watermark = std::min(watermark, done.load()); }
+    queue.pop_older_than(watermark, std::back_inserter(merged));
+    std::this_thread::yield();
+  }
+  for (auto &thread : threads) { thread.join(); }
+
+  REQUIRE(queue.empty());
+  bool sorted = true;
+  for (size_t i = 0; i < merged.size(); ++i) { sorted = sorted && merged[i].timestamp_ns == i; }
+  REQUIRE(sorted);
+
+  queue.push(Message{ 5, "", {} });
+  REQUIRE(queue.top_timestamp() == 5);
+  REQUIRE(queue.wait_and_pop()->timestamp_ns == 5);
+  queue.shutdown();
+  REQUIRE_FALSE(queue.wait_and_pop().has_value());
+}
+
+
+TEST_CASE("Queue statistics", "[threadsafequeue][stats]")
+{
+  SECTION("Log buckets")
+  {
+    for (uint64_t ns : std::vector<uint64_t>{ 0, 3, 4, 7, 8, 1000, 123456789, UINT64_MAX }) {
+      size_t bucket = QueueStatsSnapshot::bucket_of(ns);
+      REQUIRE(bucket < QueueStatsSnapshot::kLatencyBuckets);
+      REQUIRE(QueueStatsSnapshot::bucket_floor(bucket) <= ns);
+      if (bucket + 1 < QueueStatsSnapshot::kLatencyBuckets) {
+        REQUIRE(QueueStatsSnapshot::bucket_floor(bucket + 1) > ns);
+      }
+    }
+  }
+
+  SECTION("Counts, high-water mark and drops")
+  {
+    ThreadSafeValueQueue<int, QueueStats> queue(4, OverflowPolicy::drop_oldest);
+    for (int i = 0; i < 6; ++i) { queue.push(i); }
+    std::vector<int> out;
+    queue.pop_bulk(std::back_inserter(out), 3);
+
+    auto stats = queue.stats();
+    REQUIRE(stats.enqueued == 6);
+    REQUIRE(stats.dropped == 2);
+    REQUIRE(stats.dequeued == 3);
+    REQUIRE(stats.depth() == 1);
+    REQUIRE(stats.high_water == 4);
+    uint64_t latencies = 0;
+    for (uint64_t count : stats.latency_ns) { latencies += count; }
+    REQUIRE(latencies == 3);
+  }
+
+  SECTION("Latency percentiles")
+  {
+    using namespace std::chrono_literals;
+    ThreadSafeValueQueue<int, QueueStats> queue;
+    queue.push(1);
+    std::this_thread::sleep_for(2ms);
+    REQUIRE(queue.try_pop().has_value());
+    auto stats = queue.stats();
+    REQUIRE(stats.latency_percentile_ns(0.5) >= 1'500'000);// 25% bucket width
+  }
+
+  SECTION("Scraped while producers and consumers run")
+  {
+    constexpr int count = 20000;
+    ThreadSafeValueQueue<int, QueueStats> queue;
+    std::thread producer_thread([&] {
+      for (int i = 0; i < count; ++i) { queue.push(i); }
+    });
+    std::thread consumer_thread([&] {
+      for (int i = 0; i < count; ++i) { queue.wait_and_pop(); }
+    });
+    uint64_t last_enqueued = 0;
+    bool monotonic = true;
+    while (true) {
+      auto stats = queue.stats();
+      monotonic = monotonic && stats.enqueued >= last_enqueued;
+      last_enqueued = stats.enqueued;
+      if (stats.dequeued == count) { break; }
+      std::this_thread::yield();
+    }
+    producer_thread.join();
+    consumer_thread.join();
+    REQUIRE(monotonic);
+    REQUIRE(queue.stats().enqueued == count);
+  }
+
+  SECTION("Compiled out")
+  {
+    ThreadSafeValueQueue<int, NoQueueStats> queue;
+    queue.push(1);
+    REQUIRE(queue.stats().enqueued == 0);
+    STATIC_REQUIRE(std::is_empty_v<NoQueueStats::Stamp>);
+  }
+}